@@ -1,19 +1,32 @@
 /*
   exceptions.cpp - c-level exception handlers called from vectors.S
-  handles synchronous exceptions (prints esr/far/elr and panics)
-  and irq dispatch (calls gic::dispatch)
+  handles synchronous exceptions (flushes the uart, prints esr/far/elr and
+  panics)
+  and irq dispatch (calls gic::dispatch, which may nest, runs deferred
+  softirq work with irqs re-enabled when leaving the outermost irq, then
+  lets the scheduler pick the frame to return to). both are charged to
+  cpustat's irq class
 */
 #include "kernel/core/panic.hpp"
 #include "kernel/core/print.hpp"
 #include "kernel/irq/gic.hpp"
+#include "kernel/drivers/uart_pl011.hpp"
+#include "kernel/core/ksyms.hpp"
+#include "kernel/irq/work.hpp"
+#include "kernel/sched/sched.hpp"
+#include "kernel/core/cpustat.hpp"
 #include <stdint.h>
 
 extern "C" void sync_entry(uint64_t esr, uint64_t far, uint64_t elr) {
     uint32_t ec  = (esr >> 26) & 0x3F;
     uint32_t iss = (uint32_t)(esr & 0x00FFFFFFu);
 
+    uart::flush_sync();
     print("\n\n*** KERNEL PANIC: Synchronous Exception ***\n");
-    print("  ELR (faulting PC):   0x"); print_hex(elr); print("\n");
+    print("  ELR (faulting PC):   0x"); print_hex(elr);
+    int sym = ksyms::find(elr);
+    if (sym >= 0) printk("  <%s+%x>", ksyms::name((uint32_t)sym), elr - ksyms::addr((uint32_t)sym));
+    print("\n");
     print("  FAR (faulting addr): 0x"); print_hex(far); print("\n");
     print("  ESR: 0x"); print_hex(esr); print("\n");
     printk("  EC=0x%x (%s)  ISS=0x%x\n", ec,
@@ -29,6 +42,11 @@ extern "C" void sync_entry(uint64_t esr, uint64_t far, uint64_t elr) {
     for (;;) asm volatile("wfe");
 }
 
-extern "C" void irq_entry() {
+extern "C" uint64_t irq_entry(uint64_t sp) {
+    sched::irq_enter();
+    uint8_t cls = cpustat::enter(cpustat::IRQ);
     gic::dispatch();
+    if (sched::irq_depth() == 1) work::run_softirq();
+    cpustat::enter(cls);
+    return sched::irq_exit(sp);
 }
@@ -1,8 +1,10 @@
 /*
   regs.hpp - inline helpers for aarch64 system registers and memory barriers
   SYSREG_READ/SYSREG_WRITE macros, named inlines for commonly used registers
-  (esr, far, elr, spsr, cntfrq, cntpct, cntp_tval, cntp_ctl)
+  (esr, far, elr, spsr, cntfrq, cntpct, cntp_tval, cntp_cval, cntp_ctl,
+  and the virtual timer's cntvct, cntv_cval, cntv_ctl)
   dsb_sy, dmb_ish, isb barriers
+  irq_save/irq_restore for short critical sections that may nest
 */
 #pragma once
 #include <stdint.h>
@@ -23,9 +25,16 @@ static inline uint64_t read_cntfrq_el0()  { return SYSREG_READ(cntfrq_el0);}
 static inline uint64_t read_cntpct_el0()  { return SYSREG_READ(cntpct_el0);}
 
 static inline void write_cntp_tval_el0(uint64_t v) { SYSREG_WRITE(cntp_tval_el0, v); }
+static inline void write_cntp_cval_el0(uint64_t v) { SYSREG_WRITE(cntp_cval_el0, v); }
+static inline uint64_t read_cntp_cval_el0()        { return SYSREG_READ(cntp_cval_el0); }
 static inline void write_cntp_ctl_el0(uint64_t v)  { SYSREG_WRITE(cntp_ctl_el0, v);  }
 static inline uint64_t read_cntp_ctl_el0()         { return SYSREG_READ(cntp_ctl_el0); }
 
+static inline uint64_t read_cntvct_el0()           { return SYSREG_READ(cntvct_el0); }
+static inline void write_cntv_cval_el0(uint64_t v) { SYSREG_WRITE(cntv_cval_el0, v); }
+static inline uint64_t read_cntv_cval_el0()        { return SYSREG_READ(cntv_cval_el0); }
+static inline void write_cntv_ctl_el0(uint64_t v)  { SYSREG_WRITE(cntv_ctl_el0, v);  }
+
 static inline void dsb_sy()  { asm volatile("dsb sy"  ::: "memory"); }
 static inline void dmb_ish() { asm volatile("dmb ish" ::: "memory"); }
 static inline void isb()     { asm volatile("isb"     ::: "memory"); }
@@ -33,6 +42,16 @@ static inline void isb()     { asm volatile("isb"     ::: "memory"); }
 static inline void irq_enable()  { asm volatile("msr daifclr, #2" ::: "memory"); }
 static inline void irq_disable() { asm volatile("msr daifset, #2" ::: "memory"); }
 
+static inline uint64_t irq_save() {
+    uint64_t flags;
+    asm volatile("mrs %0, daif" : "=r"(flags) :: "memory");
+    asm volatile("msr daifset, #2" ::: "memory");
+    return flags;
+}
+static inline void irq_restore(uint64_t flags) {
+    asm volatile("msr daif, %0" :: "r"(flags) : "memory");
+}
+
 static inline void dc_civac_range(const void* p, size_t n) {
     uintptr_t a = (uintptr_t)p & ~(uintptr_t)63;
     uintptr_t e = (uintptr_t)p + n;
@@ -2,9 +2,11 @@
   calc.cpp - 4-function floating-point calculator in a wm window
   has a display area, pending operator row, and a 4x5 button grid
   supports mouse clicks and keyboard input (digits, + - * / enter escape backspace %)
+  keys arrive as wm key events while the window has focus
 */
 #include "kernel/apps/calc.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/gfx/font.hpp"
 #include "kernel/gfx/draw.hpp"
 #include <stdint.h>
@@ -72,6 +74,7 @@ namespace {
 
 static wm::Window* g_win    = nullptr;
 static bool        g_dirty  = true;
+static int         g_task   = -1;
 
 static constexpr uint32_t DISP_MAXLEN = 20u;
 static char   g_display[DISP_MAXLEN + 1] = "0";
@@ -396,17 +399,21 @@ void open() {
     int32_t wx = 360, wy = 120;
     g_win = wm::win_create(wx, wy, CALC_W, CALC_H, "Calculator");
     if (!g_win) return;
+    wm::win_listen(g_win);
 
     g_display[0] = '0'; g_display[1] = '\0';
     g_accum = 0.0; g_op = 0; g_fresh = true; g_error = false;
     g_dirty = true;
     redraw();
+    g_task = dispatch::add("calc", tick, dispatch::SIG_INPUT, g_win);
 }
 
 void close() {
     if (!g_win) return;
     wm::win_destroy(g_win);
     g_win = nullptr;
+    dispatch::remove(g_task);
+    g_task = -1;
 }
 
 bool active() { return g_win != nullptr; }
@@ -452,6 +459,12 @@ void tick(uint64_t ) {
 
     if (g_win->close_requested) { close(); return; }
 
+    wm::Event ev;
+    while (g_win && wm::win_next_event(g_win, ev)) {
+        if (ev.type == wm::EvType::Key) on_key(ev.key);
+    }
+    if (!g_win) return;
+
     if (g_win->client_clicked) {
         g_win->client_clicked = false;
         int32_t cx = g_win->click_cx;
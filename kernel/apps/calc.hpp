@@ -1,6 +1,6 @@
 /*
   calc.hpp - calculator app interface
-  open/close/active/on_key/tick - tick handles mouse clicks and redraws
+  open/close/active/on_key/tick - tick drains focused key events, handles mouse clicks and redraws
 */
 #pragma once
 #include <stdint.h>
@@ -8,6 +8,7 @@
 #include "kernel/gfx/font.hpp"
 #include "kernel/gfx/draw.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/core/print.hpp"
 #include "kernel/fs/blkfs.hpp"
 #include <stdint.h>
@@ -63,6 +64,7 @@ namespace {
 static wm::Window* g_win    = nullptr;
 static bool        g_active = false;
 static bool        g_dirty  = true;
+static int         g_task   = -1;
 
 enum class CPPage { Main, AppSettings };
 static CPPage  g_page         = CPPage::Main;
@@ -365,11 +367,16 @@ void open() {
     if (!g_win) return;
     g_active = true;
     g_dirty  = true;
+    g_task   = dispatch::add("controlpanel", tick,
+                             dispatch::SIG_INPUT | dispatch::SIG_TIMER, g_win);
+    dispatch::wake(g_task);
 }
 
 void close() {
     if (!g_active) return;
     wm::win_destroy(g_win);
+    dispatch::remove(g_task);
+    g_task   = -1;
     g_win    = nullptr;
     g_active = false;
 }
@@ -400,6 +407,8 @@ void tick(uint64_t ticks) {
         draw_full(fb, ticks);
         wm::win_mark_dirty(g_win);
     }
+    if (g_active && g_page == CPPage::Main)
+        dispatch::wake_at(g_task, (cur_sec + 1u) * 100u);
 }
 
 }
@@ -3,9 +3,11 @@
   supports arrow keys, home/end, pgup/pgdn, backspace, delete, enter, tab
   ctrl+s saves, ctrl+q quits without saving, ctrl+x saves and quits
   buffers up to 512 lines of 255 chars each, backed by the vfs
+  keys arrive as wm key events while the editor window has focus
 */
 #include "kernel/apps/editor.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/fs/vfs.hpp"
 #include "kernel/gfx/font.hpp"
 #include "kernel/mm/heap.hpp"
@@ -46,6 +48,7 @@ static char        g_path[64] = {};
 static bool        g_dirty    = true;
 
 static uint64_t g_blink_last = 0;
+static int      g_task       = -1;
 static bool     g_blink_on   = true;
 static constexpr uint64_t BLINK_PERIOD = 50u;
 
@@ -424,6 +427,7 @@ bool open(const char* path) {
     g_win = wm::win_create(60, 50, ED_W, ED_H,
                            g_path[0] ? g_path : "editor");
     if (!g_win) return false;
+    wm::win_listen(g_win);
 
     g_cur_row    = 0;
     g_cur_col    = 0;
@@ -441,12 +445,16 @@ bool open(const char* path) {
 
     g_active = true;
     do_render();
+    g_task = dispatch::add("editor", tick, dispatch::SIG_INPUT | dispatch::SIG_TIMER, g_win);
+    dispatch::wake(g_task);
     return true;
 }
 
 void close() {
     if (!g_active) return;
     if (g_win) { wm::win_destroy(g_win); g_win = nullptr; }
+    dispatch::remove(g_task);
+    g_task     = -1;
     g_active   = false;
     g_modified = false;
 }
@@ -535,11 +543,19 @@ void tick(uint64_t ticks) {
     if (!g_active) return;
 
     if (g_win && g_win->close_requested) { close(); return; }
+
+    wm::Event ev;
+    while (g_active && g_win && wm::win_next_event(g_win, ev)) {
+        if (ev.type == wm::EvType::Key) on_key(ev.key);
+    }
+    if (!g_active) return;
+
     if (ticks - g_blink_last >= BLINK_PERIOD) {
         g_blink_last = ticks;
         g_blink_on   = !g_blink_on;
         g_dirty      = true;
     }
+    dispatch::wake_at(g_task, g_blink_last + BLINK_PERIOD);
     if (g_dirty) do_render();
 }
 
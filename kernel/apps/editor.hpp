@@ -1,6 +1,7 @@
 /*
   editor.hpp - text editor interface
-  open(path) opens a file, on_key() feeds input, tick() handles cursor blink and redraws
+  open(path) opens a file, on_key() feeds input, tick() drains focused key events,
+  handles cursor blink and redraws
 */
 #pragma once
 #include <stdint.h>
@@ -3,12 +3,17 @@
   shows all files and directories in the current vfs path
   single-click selects, double-click opens files in the editor or navigates into dirs
   right-click shows a context menu with open/delete/new options
+  rescans the listing whenever the dispatcher reports a filesystem change
+  scans run as coroutines; while the disk is still loading the scan waits
+  for it in the background and the window shows a loading status
 */
 #include "kernel/apps/fileexplorer.hpp"
 #include "kernel/apps/editor.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/fs/vfs.hpp"
-#include "kernel/fs/ramfs.hpp"
+#include "kernel/fs/blkfs.hpp"
+#include "kernel/core/co.hpp"
 #include "kernel/gfx/font.hpp"
 #include "kernel/gfx/draw.hpp"
 #include "kernel/irq/timer.hpp"
@@ -87,6 +92,7 @@ static int32_t  g_last_click_row  = -1;
 static uint64_t g_last_click_tick = 0u;
 
 static wm::Window* g_win   = nullptr;
+static int         g_task  = -1;
 static bool        g_dirty = true;
 
 static uint32_t g_new_file_ctr = 0;
@@ -132,7 +138,13 @@ static void ls_cb(const char* name, size_t size, bool is_dir) {
     e.is_dotdot = false;
 }
 
-static void scan_dir() {
+static bool g_scan_pending = false;
+static bool g_scan_keep    = false;
+
+static void list_dir(bool keep_view) {
+    int32_t  sel    = g_selected;
+    uint32_t scroll = g_scroll;
+
     g_nentries = 0;
     g_scroll   = 0;
     g_selected = -1;
@@ -146,9 +158,38 @@ static void scan_dir() {
         dd.is_dotdot = true;
     }
     vfs::ls_in(g_cur_path, ls_cb);
+
+    if (keep_view) {
+        if (sel < (int32_t)g_nentries) g_selected = sel;
+        if (scroll < g_nentries)       g_scroll   = scroll;
+    }
     g_dirty = true;
 }
 
+static co::Task<void> scan_task() {
+    if (!blkfs::loaded()) {
+        g_dirty = true;
+        co_await blkfs::load_event();
+        if (g_win) {
+            list_dir(g_scan_keep);
+            dispatch::wake(g_task);
+        }
+    } else {
+        list_dir(g_scan_keep);
+    }
+    g_scan_pending = false;
+}
+
+static void scan_dir(bool keep_view = false) {
+    if (g_scan_pending) {
+        g_scan_keep = g_scan_keep && keep_view;
+        return;
+    }
+    g_scan_pending = true;
+    g_scan_keep    = keep_view;
+    co::spawn(scan_task());
+}
+
 static void navigate_into(const char* child_name) {
     uint32_t plen = 0;
     while (g_cur_path[plen]) ++plen;
@@ -345,7 +386,7 @@ static void redraw() {
         tmp[n]='\0';
         for (int i=0;tmp[i];++i) if(si<79) stat_buf[si++]=tmp[i];
     }
-    const char* suffix = " items";
+    const char* suffix = g_scan_pending ? " items (loading disk...)" : " items";
     for (;*suffix && si<79;++suffix) stat_buf[si++]=*suffix;
     if (g_selected >= 0 && (uint32_t)g_selected < g_nentries) {
         const char* sep = "   |   ";
@@ -460,7 +501,7 @@ static void exec_ctx_action(uint32_t item_idx) {
         if (row < 0 || (uint32_t)row >= g_nentries) break;
         char full[128];
         make_full_path(full, sizeof(full), g_cur_path, g_entries[row].name);
-        ramfs::remove(full);
+        vfs::remove(full);
         scan_dir();
         break;
     }
@@ -521,12 +562,15 @@ void open() {
     g_cur_path[0] = '\0';
     scan_dir();
     redraw();
+    g_task = dispatch::add("files", tick, dispatch::SIG_INPUT | dispatch::SIG_FS, g_win);
 }
 
 void close() {
     if (!g_win) return;
     wm::win_destroy(g_win);
     g_win = nullptr;
+    dispatch::remove(g_task);
+    g_task = -1;
 }
 
 bool active() { return g_win != nullptr; }
@@ -536,6 +580,10 @@ void tick(uint64_t ticks) {
 
     if (g_win->close_requested) { close(); return; }
 
+    if ((dispatch::reason() & dispatch::SIG_FS) && !g_ctx_open) {
+        scan_dir(true);
+    }
+
     if (g_win->right_clicked) {
         g_win->right_clicked = false;
         int32_t rcx = g_win->right_cx;
@@ -6,6 +6,7 @@
 */
 #include "kernel/apps/paint.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/gfx/font.hpp"
 #include "kernel/gfx/draw.hpp"
 #include <stdint.h>
@@ -57,6 +58,7 @@ namespace {
 
 static wm::Window* g_win     = nullptr;
 static bool        g_active  = false;
+static int         g_task    = -1;
 static uint32_t    g_sel_pal = 0u;
 static uint32_t    g_brush   = 1u;
 static bool        g_dirty     = true;
@@ -229,11 +231,14 @@ void open() {
     }
     wm::win_mark_dirty(g_win);
     g_active = true;
+    g_task   = dispatch::add("paint", tick, dispatch::SIG_INPUT, g_win);
 }
 
 void close() {
     if (!g_active) return;
     wm::win_destroy(g_win);
+    dispatch::remove(g_task);
+    g_task   = -1;
     g_win    = nullptr;
     g_active = false;
 }
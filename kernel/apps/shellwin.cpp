@@ -1,11 +1,12 @@
 /*
   shellwin.cpp - wraps the wm terminal grid in a floating window
   opened when the shell desktop icon is double-clicked
-  every tick it blits the terminal text into the window's client framebuffer
+  whenever the terminal changes it blits the text into the window's client framebuffer
 */
 #include "kernel/apps/shellwin.hpp"
 #include "kernel/apps/controlpanel.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/gfx/font.hpp"
 #include <stdint.h>
 
@@ -19,6 +20,7 @@ namespace {
 
 static wm::Window* g_win    = nullptr;
 static bool        g_active = false;
+static int         g_task   = -1;
 
 }
 
@@ -36,11 +38,15 @@ void open() {
     g_win = wm::win_create(ox, oy, g_sw_w, g_sw_h, "Shell");
     if (!g_win) return;
     g_active = true;
+    g_task   = dispatch::add("shell", tick, dispatch::SIG_INPUT | dispatch::SIG_TERM, g_win);
+    dispatch::wake(g_task);
 }
 
 void close() {
     if (!g_active) return;
     wm::win_destroy(g_win);
+    dispatch::remove(g_task);
+    g_task   = -1;
     g_win    = nullptr;
     g_active = false;
 }
@@ -1,14 +1,30 @@
 /*
   sysmon.cpp - task manager style system monitor app
-  performance tab: rolling cpu chart (frames/sec), memory bar, uptime, fps
-  processes tab: list of open windows with an end-task button
+  performance tab: rolling cpu utilization chart from cpustat, memory bar,
+  uptime, fps and where the last sample's cpu time went by class
+  processes tab: kernel plus open windows with recent and total cpu,
+  redraws, input wakeups, surface and heap bytes from dispatch::stats();
+  click a column header to sort by it, end-task closes the selection
+  interrupts tab: per-line counts, latency and a handler run-time histogram
+  from gic::stats()
+  frames tab: p50/p95/p99 per render phase from framestat, pixels and
+  bytes per frame, and a button for the wm overlay
+  i/o tab: iops, MB/s, average latency and spins per request for each named
+  virtqueue over the last sample, and its latency histogram since boot
+  woken by clicks and by a half-second sample timer
 */
 #include "kernel/apps/sysmon.hpp"
 #include "kernel/wm/wm.hpp"
+#include "kernel/core/dispatch.hpp"
 #include "kernel/gfx/font.hpp"
 #include "kernel/gfx/draw.hpp"
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/rtc.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/core/cpustat.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/drivers/virtio/virtqueue.hpp"
 #include <stdint.h>
 #include <string.h>
 
@@ -37,8 +53,13 @@ static constexpr uint32_t C_BTN_REG  = 0x00C0C0C0u;
 static constexpr uint32_t C_BTN_RED  = 0x008B0000u;
 static constexpr uint32_t C_BTN_REDFG= 0x00FFFFFFu;
 
+static constexpr uint32_t C_CLASS[cpustat::CLASSES] = {
+    0x00808080u, 0x00000000u, 0x00606000u, 0x00C00000u,
+    0x00C000C0u, 0x000000C0u, 0x00008000u, 0x00008080u,
+};
+
 static constexpr uint32_t TAB_H    = 22u;
-static constexpr uint32_t TAB_W    = 120u;
+static constexpr uint32_t TAB_W    = 110u;
 static constexpr uint32_t TAB_Y    = 2u;
 
 static constexpr uint32_t CONTENT_Y = TAB_Y + TAB_H + 2u;
@@ -57,30 +78,84 @@ static constexpr uint32_t MEM_BAR_H   = 20u;
 static constexpr uint32_t MEM_BAR_X   = CONTENT_X + PERF_PAD;
 static constexpr uint32_t MEM_BAR_Y   = CHART_Y + CHART_H + 30u;
 static constexpr uint32_t INFO_Y      = MEM_BAR_Y + MEM_BAR_H + 8u;
+static constexpr uint32_t BRK_SECT_Y  = INFO_Y + 4u * (gfx::FONT_H + 4u) + 4u;
+static constexpr uint32_t BRK_BAR_Y   = BRK_SECT_Y + gfx::FONT_H + 8u;
+static constexpr uint32_t BRK_BAR_H   = 14u;
+static constexpr uint32_t BRK_LEG_Y   = BRK_BAR_Y + BRK_BAR_H + 6u;
+static constexpr uint32_t BRK_LEG_W   = MEM_BAR_W / 2u;
 
 static constexpr uint32_t PROC_LIST_Y  = CONTENT_Y + 20u;
 static constexpr uint32_t PROC_ROW_H   = 18u;
 static constexpr uint32_t PROC_VISIBLE = (CONTENT_H - 20u - 30u) / PROC_ROW_H;
-static constexpr uint32_t PROC_COL1_W  = 260u;
+static constexpr uint32_t PROC_COL1_W  = 140u;
+static constexpr uint32_t PROC_COL_W   = 68u;
+static constexpr uint32_t PROC_COLS    = 7u;
 static constexpr uint32_t PROC_BTN_W   = 100u;
 static constexpr uint32_t PROC_BTN_H   = 22u;
 
+static constexpr uint32_t TAB_COUNT    = 5u;
+static constexpr uint32_t IRQ_LIST_Y   = CONTENT_Y + 20u;
+static constexpr uint32_t IRQ_ROW_H    = 18u;
+static constexpr uint32_t IRQ_VISIBLE  = (CONTENT_H - 20u - 30u) / IRQ_ROW_H;
+static constexpr uint32_t IRQ_COL_W    = 80u;
+static constexpr uint32_t IRQ_HIST_X   = CONTENT_X + 40u + 4u * IRQ_COL_W + 16u;
+static constexpr uint32_t IRQ_BAR_W    = 16u;
+
+static constexpr uint32_t FR_LIST_Y    = CONTENT_Y + 20u;
+static constexpr uint32_t FR_ROW_H     = 18u;
+static constexpr uint32_t FR_COL_W     = 90u;
+static constexpr uint32_t FR_BAR_X     = CONTENT_X + 140u + 3u * FR_COL_W + 8u;
+static constexpr uint32_t FR_BAR_W     = CONTENT_X + CONTENT_W - FR_BAR_X - 8u;
+static constexpr uint32_t FR_BTN_W     = 140u;
+static constexpr uint32_t FR_BTN_H     = 22u;
+
+static constexpr uint32_t IO_LIST_Y    = CONTENT_Y + 20u;
+static constexpr uint32_t IO_ROW_H     = 18u;
+static constexpr uint32_t IO_COL_W     = 66u;
+static constexpr uint32_t IO_HIST_X    = CONTENT_X + 64u + 5u * IO_COL_W + 12u;
+static constexpr uint32_t IO_BAR_W     = 10u;
+
 namespace {
 
 static wm::Window* g_win    = nullptr;
 static bool        g_active = false;
+static int         g_task   = -1;
 
 static int g_tab = 0;
 
 static constexpr uint32_t HISTORY_LEN = CHART_BARS;
 static uint8_t  g_cpu_hist[HISTORY_LEN] = {};
 static uint32_t g_hist_write = 0;
+static uint32_t g_fps        = 0;
+
+static cpustat::Stats g_cpu_prev = {};
+static uint32_t       g_class_pm[cpustat::CLASSES] = {};
 
 static uint32_t g_frame_counter  = 0;
 static uint64_t g_last_sample_t  = 0;
 
-static int g_proc_sel    = -1;
-static int g_proc_scroll =  0;
+static wm::Window* g_proc_sel  = nullptr;
+static int         g_proc_scroll = 0;
+static uint32_t    g_proc_sort   = 1u;
+
+struct AppPrev {
+    uint32_t id;
+    uint64_t cpu_us;
+    uint32_t pm;
+};
+static AppPrev  g_app_prev[dispatch::MAX_TASKS] = {};
+static uint64_t g_app_prev_ns = 0;
+static uint32_t g_kernel_pm   = 0;
+
+struct IoRate {
+    uint32_t iops;
+    uint32_t kbps;
+    uint32_t avg_us;
+    uint32_t spins;
+};
+static virtio::QueueStats g_io_prev[virtio::MAX_QUEUES] = {};
+static IoRate             g_io_rate[virtio::MAX_QUEUES] = {};
+static uint64_t           g_io_prev_ns = 0;
 
 static inline void fb_fill(uint32_t* fb, int32_t x, int32_t y,
                             uint32_t w, uint32_t h, uint32_t col) {
@@ -184,8 +259,8 @@ static void draw_chrome(uint32_t* fb) {
 
     fb_fill(fb, 0, 0, SM_W, SM_CH, C_BG);
 
-    const char* tab_labels[] = { "Performance", "Processes" };
-    for (int t = 0; t < 2; ++t) {
+    const char* tab_labels[] = { "Performance", "Processes", "Interrupts", "Frames", "I/O" };
+    for (int t = 0; t < (int)TAB_COUNT; ++t) {
         uint32_t tx = (uint32_t)t * (TAB_W + 2u) + 4u;
         bool active = (t == g_tab);
         uint32_t fill = active ? C_TAB_ACT : C_TAB_INACT;
@@ -306,54 +381,198 @@ static void draw_performance(uint32_t* fb, uint64_t ticks_100hz) {
     iy += gfx::FONT_H + 4u;
 
     fb_text(fb, (int32_t)col1, (int32_t)iy, "Render FPS:", C_TEXT, C_BG);
-
-    uint32_t fps_idx = g_hist_write == 0 ? HISTORY_LEN - 1u : g_hist_write - 1u;
-    uint32_t fps_val = g_cpu_hist[fps_idx];
-    uint_to_str(fps_val, buf);
+    uint_to_str(g_fps, buf);
     fb_text(fb, (int32_t)col2, (int32_t)iy, buf, C_TEXT, C_BG);
     iy += gfx::FONT_H + 4u;
 
     fb_text(fb, (int32_t)col1, (int32_t)iy, "Heap Free:", C_TEXT, C_BG);
     fmt_mib(buf, (uint32_t)kheap::free_bytes());
     fb_text(fb, (int32_t)col2, (int32_t)iy, buf, C_TEXT, C_BG);
+
+    fb_fill(fb, (int32_t)CONTENT_X, (int32_t)BRK_SECT_Y, CONTENT_W, gfx::FONT_H + 4u, C_SECT);
+    fb_text(fb, (int32_t)(CONTENT_X + 4u), (int32_t)(BRK_SECT_Y + 2u),
+            "  CPU Time Breakdown", C_SECT_FG, C_SECT);
+
+    uint32_t bx = MEM_BAR_X;
+    fb_fill(fb, (int32_t)MEM_BAR_X, (int32_t)BRK_BAR_Y, MEM_BAR_W, BRK_BAR_H, C_CHART_BG);
+    for (uint32_t c = 0; c < cpustat::CLASSES; ++c) {
+        uint32_t w = g_class_pm[c] * MEM_BAR_W / 1000u;
+        if (bx + w > MEM_BAR_X + MEM_BAR_W) w = MEM_BAR_X + MEM_BAR_W - bx;
+        fb_fill(fb, (int32_t)bx, (int32_t)BRK_BAR_Y, w, BRK_BAR_H, C_CLASS[c]);
+        bx += w;
+    }
+
+    for (uint32_t c = 0; c < cpustat::CLASSES; ++c) {
+        uint32_t lx = MEM_BAR_X + (c & 1u) * BRK_LEG_W;
+        uint32_t ly = BRK_LEG_Y + (c / 2u) * (gfx::FONT_H + 2u);
+        fb_fill(fb, (int32_t)lx, (int32_t)(ly + 3u), 10u, gfx::FONT_H - 6u, C_CLASS[c]);
+        fb_text(fb, (int32_t)(lx + 16u), (int32_t)ly, cpustat::name((cpustat::Class)c), C_TEXT, C_BG);
+
+        uint32_t pm = g_class_pm[c];
+        uint32_t i  = 0;
+        char num[8];
+        uint_to_str(pm / 10u, num);
+        for (const char* p = num; *p; ++p) buf[i++] = *p;
+        buf[i++] = '.';
+        buf[i++] = (char)('0' + pm % 10u);
+        buf[i++] = '%';
+        buf[i]   = '\0';
+        fb_text_right(fb, (int32_t)(lx + 120u), (int32_t)ly, 80u, buf, C_TEXT, C_BG);
+    }
 }
 
 static constexpr int MAX_PROCS = wm::MAX_WINDOWS + 1;
 
 struct ProcEntry {
-    char     name[36];
-    bool     is_kernel;
+    char        name[36];
+    bool        is_kernel;
     wm::Window* win;
+    uint64_t    col[PROC_COLS];
+};
+
+static const char* const k_proc_cols[PROC_COLS] = {
+    "Name", "CPU%", "CPU ms", "Draws", "Input", "Surf K", "Heap K",
 };
 
+static void sample_apps() {
+    dispatch::AppStats st[dispatch::MAX_TASKS];
+    int n = dispatch::stats(st, dispatch::MAX_TASKS);
+    uint64_t now  = timer::now_ns();
+    uint64_t span = (now - g_app_prev_ns) / 1000u;
+    for (int i = 0; i < n; ++i) {
+        AppPrev& pv = g_app_prev[st[i].id & 0xFFu];
+        uint64_t d  = (pv.id == st[i].id && st[i].cpu_us >= pv.cpu_us) ? st[i].cpu_us - pv.cpu_us : 0;
+        pv.pm     = (g_app_prev_ns && span) ? (uint32_t)(d * 1000u / span) : 0u;
+        pv.id     = st[i].id;
+        pv.cpu_us = st[i].cpu_us;
+    }
+    g_app_prev_ns = now;
+
+    uint32_t pm = 0;
+    for (uint32_t c = 0; c < cpustat::CLASSES; ++c)
+        if (c != cpustat::IDLE && c != cpustat::DISK_WAIT && c != cpustat::APPS)
+            pm += g_class_pm[c];
+    g_kernel_pm = pm;
+}
+
+static void sample_io() {
+    uint64_t now = timer::now_ns();
+    uint64_t ms  = (now - g_io_prev_ns) / 1000000u;
+    for (uint32_t i = 0; i < virtio::queue_count(); ++i) {
+        virtio::QueueStats st;
+        virtio::queue(i)->snapshot(st);
+        const virtio::QueueStats& pv = g_io_prev[i];
+        uint64_t ios = st.completions - pv.completions;
+        IoRate& r = g_io_rate[i];
+        bool ok = g_io_prev_ns && ms && st.completions >= pv.completions;
+        r.iops   = ok ? (uint32_t)(ios * 1000u / ms) : 0u;
+        r.kbps   = ok ? (uint32_t)((st.bytes - pv.bytes) * 1000u / 1024u / ms) : 0u;
+        r.avg_us = ok && ios ? (uint32_t)((st.lat_sum_ns - pv.lat_sum_ns) / ios / 1000u) : 0u;
+        r.spins  = ok && ios ? (uint32_t)((st.spins - pv.spins) / ios) : 0u;
+        g_io_prev[i] = st;
+    }
+    g_io_prev_ns = now;
+}
+
+static bool proc_before(const ProcEntry& a, const ProcEntry& b) {
+    if (g_proc_sort == 0u) {
+        for (uint32_t i = 0; ; ++i) {
+            if (a.name[i] != b.name[i] || !a.name[i])
+                return (uint8_t)a.name[i] < (uint8_t)b.name[i];
+        }
+    }
+    return a.col[g_proc_sort] > b.col[g_proc_sort];
+}
+
 static int build_proc_list(ProcEntry* out) {
     int n = 0;
 
+    cpustat::Stats cs;
+    cpustat::snapshot(cs);
+    uint64_t khz = read_cntfrq_el0() / 1000u;
+    uint64_t kernel_ticks = cs.total - cs.ticks[cpustat::IDLE]
+                          - cs.ticks[cpustat::DISK_WAIT] - cs.ticks[cpustat::APPS];
+
+    dispatch::AppStats st[dispatch::MAX_TASKS];
+    int nst = dispatch::stats(st, dispatch::MAX_TASKS);
+
     out[n].is_kernel = true;
     out[n].win       = nullptr;
     static const char k_kernel[] = "Kernel";
     for (int i = 0; i < 7; ++i) out[n].name[i] = k_kernel[i];
+    out[n].col[0] = 0;
+    out[n].col[1] = g_kernel_pm;
+    out[n].col[2] = khz ? kernel_ticks / khz : 0;
+    out[n].col[3] = 0;
+    out[n].col[4] = 0;
+    out[n].col[5] = 0;
+    out[n].col[6] = kheap::owner_bytes(0) / 1024u;
     ++n;
 
+    int first = n;
     int wc = wm::win_count();
     for (int i = 0; i < wc && n < MAX_PROCS; ++i) {
         wm::Window* w = wm::win_get(i);
         if (!w) continue;
-        out[n].is_kernel = false;
-        out[n].win       = w;
+        ProcEntry& pe = out[n];
+        pe.is_kernel = false;
+        pe.win       = w;
         uint32_t l = 0;
-        while (w->title[l] && l < 35u) { out[n].name[l] = w->title[l]; ++l; }
-        out[n].name[l] = '\0';
+        while (w->title[l] && l < 35u) { pe.name[l] = w->title[l]; ++l; }
+        pe.name[l] = '\0';
+        for (uint32_t c = 0; c < PROC_COLS; ++c) pe.col[c] = 0;
+        pe.col[3] = w->redraws;
+        pe.col[5] = (uint64_t)w->fb_w * w->fb_client_h * 4u / 1024u;
+        for (int j = 0; j < nst; ++j) {
+            if (st[j].win != w) continue;
+            const AppPrev& pv = g_app_prev[st[j].id & 0xFFu];
+            pe.col[1] = pv.id == st[j].id ? pv.pm : 0u;
+            pe.col[2] = st[j].cpu_us / 1000u;
+            pe.col[4] = st[j].inputs;
+            pe.col[6] = st[j].heap_bytes / 1024u;
+            break;
+        }
         ++n;
     }
+
+    for (int i = first + 1; i < n; ++i) {
+        ProcEntry pe = out[i];
+        int j = i;
+        for (; j > first && proc_before(pe, out[j - 1]); --j) out[j] = out[j - 1];
+        out[j] = pe;
+    }
     return n;
 }
 
+static void fmt_pm(char* buf, uint64_t pm) {
+    char num[12];
+    uint_to_str((uint32_t)(pm / 10u), num);
+    uint32_t i = 0;
+    for (const char* p = num; *p; ++p) buf[i++] = *p;
+    buf[i++] = '.';
+    buf[i++] = (char)('0' + pm % 10u);
+    buf[i]   = '\0';
+}
+
+static uint32_t proc_col_x(uint32_t c) {
+    return c == 0u ? CONTENT_X + 4u : CONTENT_X + PROC_COL1_W + (c - 1u) * PROC_COL_W;
+}
+
 static void draw_processes(uint32_t* fb) {
 
     fb_fill(fb, (int32_t)CONTENT_X, (int32_t)CONTENT_Y, CONTENT_W, gfx::FONT_H + 4u, C_SECT);
-    fb_text(fb, (int32_t)(CONTENT_X + 4u),   (int32_t)(CONTENT_Y + 2u), "Name",   C_SECT_FG, C_SECT);
-    fb_text(fb, (int32_t)(CONTENT_X + PROC_COL1_W), (int32_t)(CONTENT_Y + 2u), "Status", C_SECT_FG, C_SECT);
+    char buf[24];
+    for (uint32_t c = 0; c < PROC_COLS; ++c) {
+        uint32_t i = 0;
+        for (const char* p = k_proc_cols[c]; *p; ++p) buf[i++] = *p;
+        if (c == g_proc_sort) { buf[i++] = ' '; buf[i++] = 'v'; }
+        buf[i] = '\0';
+        if (c == 0u)
+            fb_text(fb, (int32_t)proc_col_x(c), (int32_t)(CONTENT_Y + 2u), buf, C_SECT_FG, C_SECT);
+        else
+            fb_text_right(fb, (int32_t)proc_col_x(c), (int32_t)(CONTENT_Y + 2u),
+                          PROC_COL_W - 4u, buf, C_SECT_FG, C_SECT);
+    }
 
     ProcEntry procs[MAX_PROCS];
     int nprocs = build_proc_list(procs);
@@ -362,26 +581,41 @@ static void draw_processes(uint32_t* fb) {
     if (max_scroll < 0) max_scroll = 0;
     if (g_proc_scroll > max_scroll) g_proc_scroll = max_scroll;
 
+    bool sel_found = false;
     for (uint32_t row = 0; row < PROC_VISIBLE; ++row) {
         int idx = (int)row + g_proc_scroll;
         uint32_t ry = PROC_LIST_Y + row * PROC_ROW_H;
         if (ry + PROC_ROW_H > SM_CH) break;
 
-        uint32_t row_bg = (idx == g_proc_sel) ? C_LIST_SEL
-                        : (row & 1u)           ? C_LIST_ALT
-                                               : C_BG;
-        uint32_t row_fg = (idx == g_proc_sel) ? C_WHITE : C_TEXT;
+        bool sel = idx < nprocs && g_proc_sel && procs[idx].win == g_proc_sel;
+        if (sel) sel_found = true;
+        uint32_t row_bg = sel         ? C_LIST_SEL
+                        : (row & 1u)  ? C_LIST_ALT
+                                      : C_BG;
+        uint32_t row_fg = sel ? C_WHITE : C_TEXT;
 
         fb_fill(fb, (int32_t)CONTENT_X, (int32_t)ry, CONTENT_W, PROC_ROW_H, row_bg);
 
         if (idx < nprocs) {
             const ProcEntry& pe = procs[idx];
-            fb_text(fb, (int32_t)(CONTENT_X + 4u), (int32_t)(ry + 1u),
-                    pe.name, row_fg, row_bg);
-            fb_text(fb, (int32_t)(CONTENT_X + PROC_COL1_W), (int32_t)(ry + 1u),
-                    pe.is_kernel ? "System" : "Running", row_fg, row_bg);
+            char name[18];
+            uint32_t l = 0;
+            while (pe.name[l] && l < 16u) { name[l] = pe.name[l]; ++l; }
+            name[l] = '\0';
+            fb_text(fb, (int32_t)proc_col_x(0), (int32_t)(ry + 1u), name, row_fg, row_bg);
+            for (uint32_t c = 1; c < PROC_COLS; ++c) {
+                if (c == 1u) fmt_pm(buf, pe.col[c]);
+                else         uint_to_str((uint32_t)pe.col[c], buf);
+                fb_text_right(fb, (int32_t)proc_col_x(c), (int32_t)(ry + 1u),
+                              PROC_COL_W - 4u, buf, row_fg, row_bg);
+            }
         }
     }
+    if (!sel_found) {
+        bool live = false;
+        for (int i = 0; i < nprocs; ++i) live |= (g_proc_sel && procs[i].win == g_proc_sel);
+        if (!live) g_proc_sel = nullptr;
+    }
 
     uint32_t sb_x = CONTENT_X + CONTENT_W - 12u;
     uint32_t sb_y = PROC_LIST_Y;
@@ -401,16 +635,203 @@ static void draw_processes(uint32_t* fb) {
 
     uint32_t btn_x = CONTENT_X + CONTENT_W - PROC_BTN_W - 4u;
     uint32_t btn_y = SM_CH - PROC_BTN_H - 6u;
-    bool can_end = (g_proc_sel > 0);
+    bool can_end = (g_proc_sel != nullptr);
     fb_button(fb, (int32_t)btn_x, (int32_t)btn_y, PROC_BTN_W, PROC_BTN_H,
               "End Task",
               can_end ? C_BTN_RED : C_BTN_REG,
               can_end ? C_BTN_REDFG : C_SHADOW);
 }
 
+static void fmt_us(char* buf, uint64_t ns) {
+    uint_to_str((uint32_t)(ns / 1000u), buf);
+}
+
+static void draw_interrupts(uint32_t* fb) {
+
+    int32_t hy = (int32_t)(CONTENT_Y + 2u);
+    fb_fill(fb, (int32_t)CONTENT_X, (int32_t)CONTENT_Y, CONTENT_W, gfx::FONT_H + 4u, C_SECT);
+    fb_text(fb, (int32_t)(CONTENT_X + 4u), hy, "IRQ", C_SECT_FG, C_SECT);
+    static const char* const k_cols[4] = { "Count", "Avg lat", "Max lat", "Max run" };
+    for (uint32_t c = 0; c < 4u; ++c)
+        fb_text_right(fb, (int32_t)(CONTENT_X + 40u + c * IRQ_COL_W), hy,
+                      IRQ_COL_W, k_cols[c], C_SECT_FG, C_SECT);
+    fb_text(fb, (int32_t)IRQ_HIST_X, hy, "<1us  run time  4ms+", C_SECT_FG, C_SECT);
+
+    char buf[16];
+    uint32_t row = 0;
+    for (uint32_t irq = 0; irq < 256u && row < IRQ_VISIBLE; ++irq) {
+        gic::IrqStats st;
+        if (!gic::stats(irq, st)) continue;
+
+        uint32_t ry = IRQ_LIST_Y + row * IRQ_ROW_H;
+        uint32_t row_bg = (row & 1u) ? C_LIST_ALT : C_BG;
+        fb_fill(fb, (int32_t)CONTENT_X, (int32_t)ry, CONTENT_W, IRQ_ROW_H, row_bg);
+
+        int32_t ty = (int32_t)(ry + 1u);
+        uint_to_str(irq, buf);
+        fb_text(fb, (int32_t)(CONTENT_X + 4u), ty, buf, C_TEXT, row_bg);
+        uint_to_str(st.count, buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 40u), ty, IRQ_COL_W, buf, C_TEXT, row_bg);
+        if (st.lat_samples) fmt_us(buf, st.lat_sum_ns / st.lat_samples);
+        else                { buf[0] = '-'; buf[1] = '\0'; }
+        fb_text_right(fb, (int32_t)(CONTENT_X + 40u + IRQ_COL_W), ty, IRQ_COL_W, buf, C_TEXT, row_bg);
+        if (st.lat_samples) fmt_us(buf, st.max_lat_ns);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 40u + 2u * IRQ_COL_W), ty, IRQ_COL_W, buf, C_TEXT, row_bg);
+        fmt_us(buf, st.max_run_ns);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 40u + 3u * IRQ_COL_W), ty, IRQ_COL_W, buf, C_TEXT, row_bg);
+
+        uint32_t peak = 0;
+        for (uint32_t b = 0; b < gic::HIST_BUCKETS; ++b)
+            if (st.hist[b] > peak) peak = st.hist[b];
+        uint32_t bar_max = IRQ_ROW_H - 4u;
+        for (uint32_t b = 0; b < gic::HIST_BUCKETS; ++b) {
+            uint32_t bx = IRQ_HIST_X + b * (IRQ_BAR_W + 4u);
+            fb_fill(fb, (int32_t)bx, (int32_t)(ry + 2u), IRQ_BAR_W, bar_max, C_CHART_BG);
+            if (!peak || !st.hist[b]) continue;
+            uint32_t bh = (uint32_t)((uint64_t)st.hist[b] * bar_max / peak);
+            if (bh == 0) bh = 1u;
+            fb_fill(fb, (int32_t)bx, (int32_t)(ry + 2u + bar_max - bh), IRQ_BAR_W, bh, C_CHART_FG);
+        }
+        ++row;
+    }
+
+    uint32_t iy = SM_CH - gfx::FONT_H - 10u;
+    uint32_t col1 = CONTENT_X + PERF_PAD;
+    fb_text(fb, (int32_t)col1, (int32_t)iy, "Spurious:", C_TEXT, C_BG);
+    uint_to_str(gic::spurious(), buf);
+    fb_text(fb, (int32_t)(col1 + 80u), (int32_t)iy, buf, C_TEXT, C_BG);
+    fb_text(fb, (int32_t)(col1 + 180u), (int32_t)iy, "Max nesting:", C_TEXT, C_BG);
+    uint_to_str(gic::max_nesting(), buf);
+    fb_text(fb, (int32_t)(col1 + 290u), (int32_t)iy, buf, C_TEXT, C_BG);
+}
+
+static void draw_frames(uint32_t* fb) {
+
+    int32_t hy = (int32_t)(CONTENT_Y + 2u);
+    fb_fill(fb, (int32_t)CONTENT_X, (int32_t)CONTENT_Y, CONTENT_W, gfx::FONT_H + 4u, C_SECT);
+    fb_text(fb, (int32_t)(CONTENT_X + 4u), hy, "Phase (us)", C_SECT_FG, C_SECT);
+    static const char* const k_cols[3] = { "p50", "p95", "p99" };
+    for (uint32_t c = 0; c < 3u; ++c)
+        fb_text_right(fb, (int32_t)(CONTENT_X + 140u + c * FR_COL_W), hy,
+                      FR_COL_W, k_cols[c], C_SECT_FG, C_SECT);
+
+    framestat::Summary st;
+    framestat::summary(st);
+
+    uint32_t peak = st.p99_us[framestat::TOTAL];
+    char buf[24];
+    for (uint32_t p = 0; p < framestat::PHASES; ++p) {
+        uint32_t ry = FR_LIST_Y + p * FR_ROW_H;
+        uint32_t row_bg = (p & 1u) ? C_LIST_ALT : C_BG;
+        fb_fill(fb, (int32_t)CONTENT_X, (int32_t)ry, CONTENT_W, FR_ROW_H, row_bg);
+
+        int32_t ty = (int32_t)(ry + 1u);
+        fb_text(fb, (int32_t)(CONTENT_X + 4u), ty, framestat::name((framestat::Phase)p), C_TEXT, row_bg);
+        uint_to_str(st.p50_us[p], buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 140u), ty, FR_COL_W, buf, C_TEXT, row_bg);
+        uint_to_str(st.p95_us[p], buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 140u + FR_COL_W), ty, FR_COL_W, buf, C_TEXT, row_bg);
+        uint_to_str(st.p99_us[p], buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 140u + 2u * FR_COL_W), ty, FR_COL_W, buf, C_TEXT, row_bg);
+
+        fb_fill(fb, (int32_t)FR_BAR_X, (int32_t)(ry + 3u), FR_BAR_W, FR_ROW_H - 6u, C_CHART_BG);
+        if (peak && st.p95_us[p]) {
+            uint32_t bw = (uint32_t)((uint64_t)st.p95_us[p] * FR_BAR_W / peak);
+            if (bw == 0) bw = 1u;
+            if (bw > FR_BAR_W) bw = FR_BAR_W;
+            fb_fill(fb, (int32_t)FR_BAR_X, (int32_t)(ry + 3u), bw, FR_ROW_H - 6u, C_CHART_FG);
+        }
+    }
+
+    uint32_t iy   = FR_LIST_Y + framestat::PHASES * FR_ROW_H + 12u;
+    uint32_t col1 = CONTENT_X + PERF_PAD;
+    uint32_t col2 = col1 + 180u;
+
+    fb_text(fb, (int32_t)col1, (int32_t)iy, "Pixels / frame:", C_TEXT, C_BG);
+    uint_to_str((uint32_t)st.pixels, buf);
+    fb_text(fb, (int32_t)col2, (int32_t)iy, buf, C_TEXT, C_BG);
+    iy += gfx::FONT_H + 4u;
+
+    fb_text(fb, (int32_t)col1, (int32_t)iy, "KiB sent / frame:", C_TEXT, C_BG);
+    uint_to_str((uint32_t)(st.bytes / 1024u), buf);
+    fb_text(fb, (int32_t)col2, (int32_t)iy, buf, C_TEXT, C_BG);
+    iy += gfx::FONT_H + 4u;
+
+    fb_text(fb, (int32_t)col1, (int32_t)iy, "Frames:", C_TEXT, C_BG);
+    uint_to_str((uint32_t)st.total_frames, buf);
+    fb_text(fb, (int32_t)col2, (int32_t)iy, buf, C_TEXT, C_BG);
+
+    uint32_t btn_x = CONTENT_X + CONTENT_W - FR_BTN_W - 4u;
+    uint32_t btn_y = SM_CH - FR_BTN_H - 6u;
+    fb_button(fb, (int32_t)btn_x, (int32_t)btn_y, FR_BTN_W, FR_BTN_H,
+              wm::overlay() ? "Hide Overlay" : "Show Overlay", C_BTN_REG, C_TEXT);
+}
+
+static void draw_io(uint32_t* fb) {
+
+    int32_t hy = (int32_t)(CONTENT_Y + 2u);
+    fb_fill(fb, (int32_t)CONTENT_X, (int32_t)CONTENT_Y, CONTENT_W, gfx::FONT_H + 4u, C_SECT);
+    fb_text(fb, (int32_t)(CONTENT_X + 4u), hy, "Device", C_SECT_FG, C_SECT);
+    static const char* const k_cols[5] = { "IOPS", "MB/s", "Avg us", "Max us", "Spins" };
+    for (uint32_t c = 0; c < 5u; ++c)
+        fb_text_right(fb, (int32_t)(CONTENT_X + 64u + c * IO_COL_W), hy,
+                      IO_COL_W, k_cols[c], C_SECT_FG, C_SECT);
+    fb_text(fb, (int32_t)IO_HIST_X, hy, "<1us lat 4ms+", C_SECT_FG, C_SECT);
+
+    char buf[16];
+    uint32_t n = virtio::queue_count();
+    for (uint32_t i = 0; i < n; ++i) {
+        virtio::QueueStats st;
+        virtio::queue(i)->snapshot(st);
+        const IoRate& r = g_io_rate[i];
+
+        uint32_t ry = IO_LIST_Y + i * IO_ROW_H;
+        uint32_t row_bg = (i & 1u) ? C_LIST_ALT : C_BG;
+        fb_fill(fb, (int32_t)CONTENT_X, (int32_t)ry, CONTENT_W, IO_ROW_H, row_bg);
+
+        int32_t ty = (int32_t)(ry + 1u);
+        fb_text(fb, (int32_t)(CONTENT_X + 4u), ty, virtio::queue(i)->name(), C_TEXT, row_bg);
+        uint_to_str(r.iops, buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 64u), ty, IO_COL_W, buf, C_TEXT, row_bg);
+        uint32_t cs = r.kbps * 100u / 1024u;
+        uint_to_str(cs / 100u, buf);
+        uint32_t l = 0;
+        while (buf[l]) ++l;
+        buf[l++] = '.';
+        buf[l++] = (char)('0' + cs % 100u / 10u);
+        buf[l++] = (char)('0' + cs % 10u);
+        buf[l]   = '\0';
+        fb_text_right(fb, (int32_t)(CONTENT_X + 64u + IO_COL_W), ty, IO_COL_W, buf, C_TEXT, row_bg);
+        bool timed = virtio::queue(i)->timed();
+        if (timed) uint_to_str(r.avg_us, buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 64u + 2u * IO_COL_W), ty, IO_COL_W,
+                      timed ? buf : "-", C_TEXT, row_bg);
+        if (timed) fmt_us(buf, st.max_lat_ns);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 64u + 3u * IO_COL_W), ty, IO_COL_W,
+                      timed ? buf : "-", C_TEXT, row_bg);
+        uint_to_str(r.spins, buf);
+        fb_text_right(fb, (int32_t)(CONTENT_X + 64u + 4u * IO_COL_W), ty, IO_COL_W, buf, C_TEXT, row_bg);
+
+        uint32_t peak = 0;
+        for (uint32_t b = 0; b < virtio::LAT_BUCKETS; ++b)
+            if (st.hist[b] > peak) peak = st.hist[b];
+        uint32_t bar_max = IO_ROW_H - 4u;
+        for (uint32_t b = 0; b < virtio::LAT_BUCKETS; ++b) {
+            uint32_t bx = IO_HIST_X + b * (IO_BAR_W + 3u);
+            fb_fill(fb, (int32_t)bx, (int32_t)(ry + 2u), IO_BAR_W, bar_max, C_CHART_BG);
+            if (!peak || !st.hist[b]) continue;
+            uint32_t bh = (uint32_t)((uint64_t)st.hist[b] * bar_max / peak);
+            if (bh == 0) bh = 1u;
+            fb_fill(fb, (int32_t)bx, (int32_t)(ry + 2u + bar_max - bh), IO_BAR_W, bh, C_CHART_FG);
+        }
+    }
+    if (n == 0)
+        fb_text(fb, (int32_t)(CONTENT_X + 4u), (int32_t)(IO_LIST_Y + 1u), "no virtio queues", C_TEXT, C_BG);
+}
+
 static void handle_click(int32_t cx, int32_t cy) {
 
-    for (int t = 0; t < 2; ++t) {
+    for (int t = 0; t < (int)TAB_COUNT; ++t) {
         uint32_t tx = (uint32_t)t * (TAB_W + 2u) + 4u;
         if (cx >= (int32_t)tx && cx < (int32_t)(tx + TAB_W) &&
             cy >= (int32_t)TAB_Y && cy < (int32_t)(TAB_Y + TAB_H)) {
@@ -419,8 +840,27 @@ static void handle_click(int32_t cx, int32_t cy) {
         }
     }
 
-    if (g_tab == 0) {
+    if (g_tab == 3) {
+        uint32_t btn_x = CONTENT_X + CONTENT_W - FR_BTN_W - 4u;
+        uint32_t btn_y = SM_CH - FR_BTN_H - 6u;
+        if (cx >= (int32_t)btn_x && cx < (int32_t)(btn_x + FR_BTN_W) &&
+            cy >= (int32_t)btn_y && cy < (int32_t)(btn_y + FR_BTN_H))
+            wm::set_overlay(!wm::overlay());
+        return;
+    }
 
+    if (g_tab != 1) {
+
+        return;
+    }
+
+    if (cy >= (int32_t)CONTENT_Y && cy < (int32_t)(CONTENT_Y + gfx::FONT_H + 4u)) {
+        for (uint32_t c = PROC_COLS; c-- > 0; ) {
+            if (cx >= (int32_t)proc_col_x(c)) {
+                g_proc_sort = c;
+                break;
+            }
+        }
         return;
     }
 
@@ -433,7 +873,7 @@ static void handle_click(int32_t cx, int32_t cy) {
             int idx = (int)row + g_proc_scroll;
             ProcEntry procs[MAX_PROCS];
             int n = build_proc_list(procs);
-            if (idx < n) g_proc_sel = idx;
+            if (idx < n) g_proc_sel = procs[idx].win;
         }
         return;
     }
@@ -442,14 +882,13 @@ static void handle_click(int32_t cx, int32_t cy) {
     uint32_t btn_y = SM_CH - PROC_BTN_H - 6u;
     if (cx >= (int32_t)btn_x && cx < (int32_t)(btn_x + PROC_BTN_W) &&
         cy >= (int32_t)btn_y && cy < (int32_t)(btn_y + PROC_BTN_H)) {
-        if (g_proc_sel > 0) {
+        if (g_proc_sel) {
 
             ProcEntry procs[MAX_PROCS];
             int n = build_proc_list(procs);
-            if (g_proc_sel < n && procs[g_proc_sel].win) {
-                procs[g_proc_sel].win->close_requested = true;
-            }
-            g_proc_sel = -1;
+            for (int i = 0; i < n; ++i)
+                if (procs[i].win == g_proc_sel) procs[i].win->close_requested = true;
+            g_proc_sel = nullptr;
         }
     }
 }
@@ -467,16 +906,23 @@ void open() {
     if (!g_win) return;
     g_active      = true;
     g_tab         = 0;
-    g_proc_sel    = -1;
+    g_proc_sel    = nullptr;
     g_proc_scroll = 0;
+    g_app_prev_ns = 0;
+    g_io_prev_ns  = 0;
     g_frame_counter = 0;
     g_last_sample_t = 0;
+    cpustat::snapshot(g_cpu_prev);
     wm::win_mark_dirty(g_win);
+    g_task = dispatch::add("sysmon", tick, dispatch::SIG_INPUT | dispatch::SIG_TIMER, g_win);
+    dispatch::wake(g_task);
 }
 
 void close() {
     if (!g_active) return;
     if (g_win) { wm::win_destroy(g_win); g_win = nullptr; }
+    dispatch::remove(g_task);
+    g_task   = -1;
     g_active = false;
 }
 
@@ -498,10 +944,18 @@ void tick(uint64_t ticks_100hz) {
     if (g_last_sample_t == 0) g_last_sample_t = ticks_100hz;
     if (ticks_100hz - g_last_sample_t >= 50u) {
 
-        uint32_t val = g_frame_counter * 100u / 20u;
-        if (val > 100u) val = 100u;
-        g_cpu_hist[g_hist_write] = (uint8_t)val;
+        g_fps = g_frame_counter * 2u;
+
+        cpustat::Stats now;
+        cpustat::snapshot(now);
+        uint64_t span = now.total - g_cpu_prev.total;
+        for (uint32_t c = 0; c < cpustat::CLASSES; ++c)
+            g_class_pm[c] = span ? (uint32_t)((now.ticks[c] - g_cpu_prev.ticks[c]) * 1000u / span) : 0u;
+        g_cpu_hist[g_hist_write] = (uint8_t)(cpustat::busy_permille(g_cpu_prev, now) / 10u);
         g_hist_write = (g_hist_write + 1u) % HISTORY_LEN;
+        g_cpu_prev = now;
+        sample_apps();
+        sample_io();
         g_frame_counter = 0;
         g_last_sample_t = ticks_100hz;
     }
@@ -515,9 +969,16 @@ void tick(uint64_t ticks_100hz) {
     draw_chrome(fb);
     if (g_tab == 0)
         draw_performance(fb, ticks_100hz);
-    else
+    else if (g_tab == 1)
         draw_processes(fb);
+    else if (g_tab == 2)
+        draw_interrupts(fb);
+    else if (g_tab == 3)
+        draw_frames(fb);
+    else
+        draw_io(fb);
     wm::win_mark_dirty(g_win);
+    dispatch::wake_at(g_task, g_last_sample_t + 50u);
 }
 
 }
@@ -0,0 +1,252 @@
+/*
+  bench.cpp - headless benchmark suites, json on serial
+  every case is timed with cntpct around a fixed number of ops and reported
+  as total ns, ns per op and, where bytes move, MB/s
+  heap   alloc/free of mixed sizes, freed out of order
+  mem    memcpy at 64 B .. 1 MiB
+  gfx    fill_rect, blit and draw_text into the framebuffer
+  blk    sequential and random 4 KiB reads, sequential writes into the last
+         MiB of the disk (make bench gives it a scratch image)
+  fs     ramfs create/read/remove
+  wm     full composite of the desktop plus flush to the host
+*/
+#include "kernel/core/bench.hpp"
+#include "kernel/core/print.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/gfx/draw.hpp"
+#include "kernel/gfx/font.hpp"
+#include "kernel/drivers/virtio/blk.hpp"
+#include "kernel/drivers/virtio/gpu.hpp"
+#include "kernel/fs/ramfs.hpp"
+#include "kernel/wm/wm.hpp"
+#include "kernel/sched/smp.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <string.h>
+#include <stdint.h>
+
+namespace {
+
+static bool     g_first = true;
+static uint64_t g_freq  = 1;
+
+static uint64_t ticks_to_ns(uint64_t t) {
+    return t * 1000000000ull / g_freq;
+}
+
+static void result(const char* name, uint64_t ops, uint64_t ticks, uint64_t bytes = 0) {
+    uint64_t ns = ticks_to_ns(ticks);
+    print(g_first ? "\n    " : ",\n    ");
+    g_first = false;
+    print("{\"name\": \""); print(name);
+    print("\", \"ops\": "); print_dec(ops);
+    print(", \"ns\": ");    print_dec(ns);
+    print(", \"ns_per_op\": "); print_dec(ops ? ns / ops : 0);
+    if (bytes) {
+        print(", \"mb_s\": ");
+        print_dec(ns ? bytes * 1000ull / ns : 0);
+    }
+    print("}");
+}
+
+static bool wants(const char* suite, const char* name) {
+    if (strcmp(suite, "all") == 0) return true;
+    size_t n = strlen(name);
+    for (const char* p = suite; *p; ) {
+        const char* e = p;
+        while (*e && *e != ',') ++e;
+        if ((size_t)(e - p) == n && strncmp(p, name, n) == 0) return true;
+        p = *e ? e + 1 : e;
+    }
+    return false;
+}
+
+static void bench_heap() {
+    static constexpr uint32_t BATCH  = 64;
+    static constexpr uint32_t ROUNDS = 200;
+    static const size_t k_sizes[] = { 16, 48, 128, 512, 2048, 8192 };
+    void* ptrs[BATCH];
+
+    uint64_t t0 = read_cntpct_el0();
+    for (uint32_t r = 0; r < ROUNDS; ++r) {
+        for (uint32_t i = 0; i < BATCH; ++i)
+            ptrs[i] = kheap::alloc(k_sizes[(i + r) % 6]);
+        for (uint32_t i = 0; i < BATCH; i += 2) kheap::free(ptrs[i]);
+        for (uint32_t i = 1; i < BATCH; i += 2) kheap::free(ptrs[i]);
+    }
+    result("heap.alloc_free_mix", (uint64_t)BATCH * ROUNDS * 2, read_cntpct_el0() - t0);
+
+    t0 = read_cntpct_el0();
+    for (uint32_t r = 0; r < ROUNDS * BATCH; ++r)
+        kheap::free(kheap::alloc(64));
+    result("heap.alloc_free_64", (uint64_t)ROUNDS * BATCH * 2, read_cntpct_el0() - t0);
+}
+
+static void bench_mem() {
+    static constexpr size_t MAX = 1u << 20;
+    uint8_t* src = static_cast<uint8_t*>(kheap::alloc(MAX, 64));
+    uint8_t* dst = static_cast<uint8_t*>(kheap::alloc(MAX, 64));
+    if (!src || !dst) {
+        kheap::free(src);
+        kheap::free(dst);
+        return;
+    }
+    memset(src, 0x5A, MAX);
+
+    static const struct { const char* name; size_t size; } k_cases[] = {
+        { "mem.memcpy_64",  64 },
+        { "mem.memcpy_1k",  1024 },
+        { "mem.memcpy_64k", 64 * 1024 },
+        { "mem.memcpy_1m",  MAX },
+    };
+    for (const auto& c : k_cases) {
+        uint32_t iters = (uint32_t)((16u * MAX) / c.size);
+        if (iters > 100000) iters = 100000;
+        uint64_t t0 = read_cntpct_el0();
+        for (uint32_t i = 0; i < iters; ++i)
+            memcpy(dst, src, c.size);
+        result(c.name, iters, read_cntpct_el0() - t0, (uint64_t)iters * c.size);
+    }
+
+    uint64_t t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < 16; ++i)
+        memset(dst, 0, MAX);
+    result("mem.memset_zero_1m", 16, read_cntpct_el0() - t0, 16ull * MAX);
+
+    kheap::free(src);
+    kheap::free(dst);
+}
+
+static void bench_gfx() {
+    if (!vgpu::ready()) return;
+    uint32_t w = vgpu::width(), h = vgpu::height();
+
+    uint64_t t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < 50; ++i)
+        gfx::fill_rect(0, 0, w, h, gfx::rgb((uint8_t)i, 0x40, 0x80));
+    result("gfx.fill_rect_full", 50, read_cntpct_el0() - t0, 50ull * w * h * 4);
+
+    static constexpr uint32_t BW = 256, BH = 256;
+    uint32_t* img = w > BW && h > BH ? static_cast<uint32_t*>(kheap::alloc(BW * BH * 4)) : nullptr;
+    if (img) {
+        for (uint32_t i = 0; i < BW * BH; ++i) img[i] = i * 2654435761u;
+        t0 = read_cntpct_el0();
+        for (uint32_t i = 0; i < 200; ++i)
+            gfx::blit(img, (i * 37) % (w - BW), (i * 23) % (h - BH), BW, BH);
+        result("gfx.blit_256", 200, read_cntpct_el0() - t0, 200ull * BW * BH * 4);
+        kheap::free(img);
+    }
+
+    static const char k_line[] = "The quick brown fox jumps over the lazy dog 0123456789";
+    uint32_t rows = h / gfx::FONT_H;
+    t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < 1000; ++i)
+        gfx::draw_text(0, (i % rows) * gfx::FONT_H, k_line);
+    result("gfx.draw_text_54", 1000, read_cntpct_el0() - t0);
+}
+
+static void bench_blk() {
+    if (!vblk::ready()) return;
+    static constexpr uint32_t IO_SECS = 8;
+    static constexpr uint32_t OPS     = 256;
+
+    uint64_t total = vblk::sector_count();
+    if (total < 4096) return;
+    void* buf = kheap::alloc(IO_SECS * 512u, 512);
+    if (!buf) return;
+    memset(buf, 0xA5, IO_SECS * 512u);
+
+    uint64_t span = total - 2048 - IO_SECS;
+    uint64_t t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < OPS; ++i)
+        vblk::read_sectors((i * IO_SECS) % span, IO_SECS, buf);
+    result("blk.seq_read_4k", OPS, read_cntpct_el0() - t0, (uint64_t)OPS * IO_SECS * 512u);
+
+    uint32_t x = 0x1234567u;
+    t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < OPS; ++i) {
+        x = x * 1664525u + 1013904223u;
+        vblk::read_sectors((x % span) & ~(uint64_t)(IO_SECS - 1), IO_SECS, buf);
+    }
+    result("blk.rand_read_4k", OPS, read_cntpct_el0() - t0, (uint64_t)OPS * IO_SECS * 512u);
+
+    uint64_t wbase = total - 2048;
+    t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < OPS; ++i)
+        vblk::write_sectors(wbase + (i * IO_SECS) % 2048, IO_SECS, buf);
+    result("blk.seq_write_4k", OPS, read_cntpct_el0() - t0, (uint64_t)OPS * IO_SECS * 512u);
+
+    kheap::free(buf);
+}
+
+static void bench_fs() {
+    static constexpr uint32_t OPS = 500;
+    static char data[1024];
+    char     rbuf[1024];
+    char     name[] = "bench0.tmp";
+    memset(data, 'x', sizeof(data));
+
+    uint64_t t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < OPS; ++i) {
+        name[5] = (char)('0' + i % 8);
+        ramfs::create(name, data, sizeof(data));
+    }
+    result("fs.create_1k", OPS, read_cntpct_el0() - t0, (uint64_t)OPS * sizeof(data));
+
+    t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < OPS; ++i) {
+        name[5] = (char)('0' + i % 8);
+        ramfs::read(name, rbuf, sizeof(rbuf));
+    }
+    result("fs.read_1k", OPS, read_cntpct_el0() - t0, (uint64_t)OPS * sizeof(data));
+
+    t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < 8; ++i) {
+        name[5] = (char)('0' + i);
+        ramfs::remove(name);
+    }
+    result("fs.remove", 8, read_cntpct_el0() - t0);
+}
+
+static void bench_wm() {
+    if (!vgpu::ready()) return;
+    static constexpr uint32_t FRAMES = 30;
+    uint64_t t0 = read_cntpct_el0();
+    for (uint32_t i = 0; i < FRAMES; ++i)
+        wm::render();
+    result("wm.composite_flush", FRAMES, read_cntpct_el0() - t0,
+           (uint64_t)FRAMES * vgpu::width() * vgpu::height() * 4);
+}
+
+}
+
+namespace bench {
+
+bool run(const char* suite) {
+    static const struct { const char* name; void (*fn)(); } k_suites[] = {
+        { "heap", bench_heap },
+        { "mem",  bench_mem  },
+        { "gfx",  bench_gfx  },
+        { "blk",  bench_blk  },
+        { "fs",   bench_fs   },
+        { "wm",   bench_wm   },
+    };
+
+    bool any = false;
+    for (const auto& s : k_suites) any |= wants(suite, s.name);
+    if (!any) {
+        printk("bench: unknown suite '%s'\n", suite);
+        return false;
+    }
+
+    g_freq  = read_cntfrq_el0();
+    g_first = true;
+    print("BENCH-JSON-BEGIN\n{\"suite\": \""); print(suite);
+    print("\", \"cpus\": "); print_dec(smp::online());
+    print(", \"results\": [");
+    for (const auto& s : k_suites)
+        if (wants(suite, s.name)) s.fn();
+    print("\n]}\nBENCH-JSON-END\n");
+    return true;
+}
+
+}
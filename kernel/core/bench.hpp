@@ -0,0 +1,14 @@
+/*
+  bench.hpp - headless benchmark suites
+  run() is used instead of the gui loop when the kernel is booted with
+  bench=<suite> in bootargs. suite is "all" or a comma list of heap, mem,
+  gfx, blk, fs and wm; results go to serial as one json object so runs can
+  be compared over time. returns false if no known suite was named
+*/
+#pragma once
+
+namespace bench {
+
+bool run(const char* suite);
+
+}
@@ -0,0 +1,75 @@
+/*
+  bootlog.cpp - boot timeline recorded from cntpct_el0
+  marks are taken on the boot cpu only, in order, so no locking. a mark
+  made from a coroutine or thread after boot (the blkfs table, the first
+  frame) still lands in the same list; desktop() only counts once
+*/
+#include "kernel/core/bootlog.hpp"
+#include "kernel/core/print.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+extern "C" uint64_t boot_t0;
+
+uint64_t boot_t0;
+
+namespace {
+
+static const char* g_name[bootlog::MAX_PHASES];
+static uint64_t    g_at[bootlog::MAX_PHASES];
+static uint32_t    g_count   = 0;
+static uint64_t    g_desktop = 0;
+
+static uint64_t to_us(uint64_t ticks) {
+    uint64_t f = read_cntfrq_el0();
+    return f ? ticks * 1000000ull / f : 0;
+}
+
+}
+
+namespace bootlog {
+
+void mark(const char* name) {
+    uint64_t now   = read_cntpct_el0();
+    uint64_t flags = irq_save();
+    if (g_count < MAX_PHASES) {
+        g_name[g_count] = name;
+        g_at[g_count]   = now;
+        ++g_count;
+    }
+    irq_restore(flags);
+}
+
+void desktop() {
+    if (g_desktop) return;
+    mark("first frame");
+    g_desktop = read_cntpct_el0();
+}
+
+uint32_t count() { return g_count; }
+
+bool phase(uint32_t i, Phase& out) {
+    if (i >= g_count) return false;
+    uint64_t prev = i ? g_at[i - 1] : boot_t0;
+    out.name     = g_name[i];
+    out.start_us = to_us(prev - boot_t0);
+    out.us       = to_us(g_at[i] - prev);
+    return true;
+}
+
+uint64_t desktop_us() {
+    return g_desktop ? to_us(g_desktop - boot_t0) : 0;
+}
+
+void print() {
+    ::print("boot: timeline (us)\n");
+    for (uint32_t i = 0; i < g_count; ++i) {
+        Phase ph;
+        phase(i, ph);
+        printk("  %u  +%u  %s\n", (unsigned)ph.start_us, (unsigned)ph.us, ph.name);
+    }
+    if (g_desktop)
+        printk("boot: time to desktop %u us\n", (unsigned)desktop_us());
+}
+
+}
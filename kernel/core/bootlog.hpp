@@ -0,0 +1,33 @@
+/*
+  bootlog.hpp - boot timeline
+  every phase of kernel_main ends with mark(name); times are cntpct deltas
+  from the first instruction of _start, which boot.S saves in boot_t0.
+  desktop() marks the first finished frame and fixes time-to-desktop
+  print() writes the timeline to serial, phase()/count() feed the shell
+*/
+#pragma once
+#include <stdint.h>
+
+namespace bootlog {
+
+static constexpr uint32_t MAX_PHASES = 32;
+
+struct Phase {
+    const char* name;
+    uint64_t    start_us;
+    uint64_t    us;
+};
+
+void mark(const char* name);
+
+void desktop();
+
+uint32_t count();
+
+bool phase(uint32_t i, Phase& out);
+
+uint64_t desktop_us();
+
+void print();
+
+}
@@ -0,0 +1,244 @@
+/*
+  co.cpp - coroutine runtime
+  the ready queue is a ring of coroutine handles filled from irqs (event
+  set, timer expiry) and threads, drained by the "co" thread in batches;
+  anything posted during a batch waits for the next one, after the thread
+  has yielded so a coroutine spinning on yield() cannot starve the kernel
+  lock. frames are
+  carved from one arena into power-of-two size classes with a free list
+  per class; a 16 byte header remembers the class. frames larger than the
+  biggest class, or any allocation once the arena is used up, fall back to
+  the kernel heap and are counted
+*/
+#include "kernel/core/co.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/core/panic.hpp"
+#include "kernel/core/print.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+static constexpr uint32_t READY_SIZE  = 256;
+static constexpr size_t   ARENA_BYTES = 128u * 1024u;
+static constexpr size_t   HDR_BYTES   = 16u;
+static constexpr uint32_t NCLASSES    = 6;
+static constexpr size_t   MIN_CLASS   = 128u;
+static constexpr uint8_t  CLASS_HEAP  = 0xFFu;
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+static void*            g_ready[READY_SIZE];
+static uint32_t         g_ready_head = 0;
+static uint32_t         g_ready_tail = 0;
+static sched::WaitQueue g_runner_wq;
+static sched::Thread*   g_runner = nullptr;
+
+static uint8_t*   g_arena     = nullptr;
+static size_t     g_arena_off = 0;
+static FreeFrame* g_free[NCLASSES];
+static uint32_t   g_live      = 0;
+static uint32_t   g_peak      = 0;
+static uint32_t   g_fallbacks = 0;
+
+static co::Event g_input;
+
+static co::SleepAwaiter* g_parked      = nullptr;
+static uint32_t          g_parked_warn = 0;
+
+static int size_class(size_t n) {
+    size_t sz = MIN_CLASS;
+    for (uint32_t c = 0; c < NCLASSES; ++c, sz <<= 1)
+        if (n <= sz) return (int)c;
+    return -1;
+}
+
+static bool ready_pop(void*& addr) {
+    uint64_t flags = irq_save();
+    bool got = g_ready_head != g_ready_tail;
+    if (got) {
+        addr = g_ready[g_ready_head % READY_SIZE];
+        ++g_ready_head;
+    }
+    irq_restore(flags);
+    return got;
+}
+
+static void on_sleep_timer(void* arg) {
+    co::post(std::coroutine_handle<>::from_address(arg));
+}
+
+static bool arm_sleep(co::SleepAwaiter* a) {
+    if (timer::now_ns() >= a->deadline_ns) {
+        co::post(a->h);
+        return true;
+    }
+    return timer::add(a->deadline_ns, on_sleep_timer, a->h.address()) >= 0;
+}
+
+static void rearm_parked() {
+    uint64_t flags = irq_save();
+    co::SleepAwaiter* list = g_parked;
+    g_parked = nullptr;
+    while (list) {
+        co::SleepAwaiter* a = list;
+        list = a->next;
+        if (!arm_sleep(a)) {
+            a->next  = g_parked;
+            g_parked = a;
+        }
+    }
+    irq_restore(flags);
+}
+
+static void runner_main(void*) {
+    sched::lock_kernel();
+    for (;;) {
+        uint32_t batch = g_ready_tail - g_ready_head;
+        void*    addr;
+        while (batch-- && ready_pop(addr))
+            std::coroutine_handle<>::from_address(addr).resume();
+
+        uint64_t flags = irq_save();
+        if (g_ready_head == g_ready_tail) sched::wait(g_runner_wq);
+        else                              sched::yield();
+        irq_restore(flags);
+    }
+}
+
+}
+
+namespace co {
+
+void init() {
+    g_arena = static_cast<uint8_t*>(kheap::alloc(ARENA_BYTES, 16));
+    if (!g_arena) panic("co: frame arena alloc failed");
+    g_runner = sched::spawn("co", runner_main, nullptr, sched::PRIO_APP);
+    if (!g_runner) panic("co: runner thread spawn failed");
+    timer::set_free_hook(rearm_parked);
+    printk("co: runtime up, %u KiB frame pool\n", (unsigned)(ARENA_BYTES / 1024u));
+}
+
+void* frame_alloc(size_t n) {
+    uint64_t flags = irq_save();
+    int      c     = size_class(n + HDR_BYTES);
+    uint8_t* p     = nullptr;
+
+    if (c >= 0 && g_free[c]) {
+        p = reinterpret_cast<uint8_t*>(g_free[c]);
+        g_free[c] = g_free[c]->next;
+    } else if (c >= 0 && g_arena && g_arena_off + (MIN_CLASS << c) <= ARENA_BYTES) {
+        p = g_arena + g_arena_off;
+        g_arena_off += MIN_CLASS << c;
+    }
+
+    if (!p) {
+        p = static_cast<uint8_t*>(kheap::alloc(n + HDR_BYTES, 16));
+        if (!p) panic("co: out of memory for a coroutine frame");
+        c = CLASS_HEAP;
+        ++g_fallbacks;
+    }
+    p[0] = (uint8_t)c;
+    if (++g_live > g_peak) g_peak = g_live;
+    irq_restore(flags);
+    return p + HDR_BYTES;
+}
+
+void frame_free(void* ptr) {
+    if (!ptr) return;
+    uint8_t* p = static_cast<uint8_t*>(ptr) - HDR_BYTES;
+    uint64_t flags = irq_save();
+    --g_live;
+    if (p[0] == CLASS_HEAP) {
+        kheap::free(p);
+    } else {
+        FreeFrame* f = reinterpret_cast<FreeFrame*>(p);
+        f->next      = g_free[p[0]];
+        g_free[p[0]] = f;
+    }
+    irq_restore(flags);
+}
+
+void post(std::coroutine_handle<> h) {
+    uint64_t flags = irq_save();
+    if (g_ready_tail - g_ready_head >= READY_SIZE) panic("co: ready queue overflow");
+    g_ready[g_ready_tail % READY_SIZE] = h.address();
+    ++g_ready_tail;
+    irq_restore(flags);
+    sched::wake_all(g_runner_wq);
+}
+
+bool in_runner() { return g_runner && sched::current() == g_runner; }
+
+uint32_t frames_live() { return g_live; }
+uint32_t frames_peak() { return g_peak; }
+uint32_t frames_fallback() { return g_fallbacks; }
+
+void spawn(Task<void> t) {
+    Task<void>::Handle h = t.release();
+    if (!h) return;
+    h.promise().detached = true;
+    h.resume();
+}
+
+bool Event::Awaiter::await_suspend(std::coroutine_handle<> caller) noexcept {
+    uint64_t flags = irq_save();
+    if (ev._set) {
+        irq_restore(flags);
+        return false;
+    }
+    h          = caller;
+    next       = ev._waiters;
+    ev._waiters = this;
+    irq_restore(flags);
+    return true;
+}
+
+void Event::set() {
+    uint64_t flags = irq_save();
+    _set = true;
+    Awaiter* w = _waiters;
+    _waiters = nullptr;
+    irq_restore(flags);
+
+    while (w) {
+        Awaiter* nx = w->next;
+        post(w->h);
+        w = nx;
+    }
+}
+
+void Event::reset() { _set = false; }
+
+bool SleepAwaiter::await_ready() const noexcept {
+    return timer::now_ns() >= deadline_ns;
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept {
+    uint64_t flags = irq_save();
+    h = handle;
+    if (!arm_sleep(this)) {
+        if (g_parked_warn++ == 0) print("co: timer pool full, parking sleepers\n");
+        next     = g_parked;
+        g_parked = this;
+    }
+    irq_restore(flags);
+}
+
+SleepAwaiter sleep_ms(uint32_t ms) {
+    return SleepAwaiter{ timer::now_ns() + (uint64_t)ms * 1000000ull };
+}
+
+Event& input_event() { return g_input; }
+
+void wait_done(volatile bool& done, sched::WaitQueue& wq) {
+    if (in_runner()) panic("co: block_on from inside a coroutine");
+    uint64_t flags = irq_save();
+    while (!done) sched::wait(wq);
+    irq_restore(flags);
+}
+
+}
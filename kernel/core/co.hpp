@@ -0,0 +1,224 @@
+/*
+  co.hpp - stackless c++20 coroutines for kernel work
+  Task<T> is a lazily started coroutine; co_await on a Task runs it and
+  resumes the caller when it finishes, by symmetric transfer so a loop of
+  tasks that finish at once does not grow the native stack. spawn()
+  detaches a Task<void> and runs it on the calling thread up to its first
+  suspension, everything after that is resumed by the "co" kernel thread,
+  one coroutine at a time, under the kernel lock
+  awaitables: Event (set from an irq or a thread), sleep_until/sleep_ms and
+  yield(). block_on() lets an ordinary thread wait for a Task. a sleep that
+  finds the timer pool full is parked and re-armed from the timer irq once
+  timers have been released
+  frames come from a dedicated size-class pool, not the general heap
+*/
+#pragma once
+#include <coroutine>
+#include <stdint.h>
+#include <stddef.h>
+#include "kernel/sched/sched.hpp"
+
+namespace co {
+
+void init();
+
+void* frame_alloc(size_t n);
+void  frame_free(void* p);
+
+void post(std::coroutine_handle<> h);
+bool in_runner();
+
+uint32_t frames_live();
+uint32_t frames_peak();
+uint32_t frames_fallback();
+
+template <typename T> class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> cont;
+    bool detached = false;
+
+    static void* operator new(size_t n) { return frame_alloc(n); }
+    static void  operator delete(void* p) { frame_free(p); }
+
+    struct Final {
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            PromiseBase& p = h.promise();
+            if (p.detached) {
+                h.destroy();
+                return std::noop_coroutine();
+            }
+            if (p.cont) return p.cont;
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    Final final_suspend() noexcept { return {}; }
+    void unhandled_exception() {}
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    T value{};
+
+    Task<T> get_return_object();
+    void return_value(T v) { value = v; }
+    T result() { return value; }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() {}
+};
+
+}
+
+template <typename T = void>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle       = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(Handle h) : _h(h) {}
+    Task(Task&& o) : _h(o._h) { o._h = nullptr; }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    Task& operator=(Task&& o) {
+        if (this != &o) {
+            if (_h) _h.destroy();
+            _h   = o._h;
+            o._h = nullptr;
+        }
+        return *this;
+    }
+
+    ~Task() { if (_h) _h.destroy(); }
+
+    bool await_ready() const noexcept { return !_h; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        _h.promise().cont = caller;
+        return _h;
+    }
+
+    T await_resume() { return _h.promise().result(); }
+
+    Handle release() {
+        Handle h = _h;
+        _h = nullptr;
+        return h;
+    }
+
+private:
+    Handle _h;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}
+
+void spawn(Task<void> t);
+
+class Event {
+public:
+    struct Awaiter {
+        Event&                  ev;
+        std::coroutine_handle<> h;
+        Awaiter*                next;
+
+        bool await_ready() const noexcept { return ev.is_set(); }
+        bool await_suspend(std::coroutine_handle<> caller) noexcept;
+        void await_resume() const noexcept {}
+    };
+
+    bool is_set() const { return _set; }
+    void set();
+    void reset();
+
+    Awaiter operator co_await() { return Awaiter{ *this, nullptr, nullptr }; }
+
+private:
+    volatile bool _set     = false;
+    Awaiter*      _waiters = nullptr;
+};
+
+struct SleepAwaiter {
+    uint64_t                deadline_ns;
+    std::coroutine_handle<> h    = nullptr;
+    SleepAwaiter*           next = nullptr;
+
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> h) noexcept;
+    void await_resume() const noexcept {}
+};
+
+struct YieldAwaiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { post(h); }
+    void await_resume() const noexcept {}
+};
+
+inline SleepAwaiter sleep_until(uint64_t deadline_ns) { return SleepAwaiter{ deadline_ns }; }
+SleepAwaiter sleep_ms(uint32_t ms);
+inline YieldAwaiter yield() { return {}; }
+
+Event& input_event();
+
+void wait_done(volatile bool& done, sched::WaitQueue& wq);
+
+namespace detail {
+
+template <typename T>
+Task<void> complete(Task<T> t, T* out, volatile bool* done, sched::WaitQueue* wq) {
+    *out  = co_await t;
+    *done = true;
+    sched::wake_all(*wq);
+}
+
+inline Task<void> complete(Task<void> t, volatile bool* done, sched::WaitQueue* wq) {
+    co_await t;
+    *done = true;
+    sched::wake_all(*wq);
+}
+
+}
+
+template <typename T>
+T block_on(Task<T> t) {
+    T                out{};
+    volatile bool    done = false;
+    sched::WaitQueue wq;
+    spawn(detail::complete(static_cast<Task<T>&&>(t), &out, &done, &wq));
+    wait_done(done, wq);
+    return out;
+}
+
+inline void block_on(Task<void> t) {
+    volatile bool    done = false;
+    sched::WaitQueue wq;
+    spawn(detail::complete(static_cast<Task<void>&&>(t), &done, &wq));
+    wait_done(done, wq);
+}
+
+}
@@ -0,0 +1,102 @@
+/*
+  cpustat.cpp - per-class tick accumulators for cpu 0
+  enter() closes the running class at the current cntpct and opens the
+  next one. g_cur keeps the class the caller passed; idle time is turned
+  into disk wait only when it is charged, and io_begin/io_end close the
+  running interval when the first request starts or the last one ends.
+  all callers run on cpu 0 with irqs masked or from irq context, apart
+  from classify() and Scope, which mask irqs themselves
+*/
+#include "kernel/core/cpustat.hpp"
+#include "kernel/sched/sched.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+static uint64_t g_ticks[cpustat::CLASSES];
+static uint8_t  g_cur   = cpustat::OTHER;
+static uint64_t g_since = 0;
+static uint32_t g_io    = 0;
+
+static const char* const k_names[cpustat::CLASSES] = {
+    "other", "idle", "disk wait", "irq", "input", "apps", "compositor", "gpu wait",
+};
+
+static void charge(uint64_t now) {
+    uint8_t cls = (g_cur == cpustat::IDLE && g_io) ? (uint8_t)cpustat::DISK_WAIT : g_cur;
+    if (g_since) g_ticks[cls] += now - g_since;
+    g_since = now;
+}
+
+}
+
+namespace cpustat {
+
+uint8_t enter(uint8_t cls) {
+    uint8_t prev = g_cur;
+    charge(read_cntpct_el0());
+    g_cur = cls < CLASSES ? cls : (uint8_t)OTHER;
+    return prev;
+}
+
+void classify(Class cls) {
+    uint64_t flags = irq_save();
+    if (sched::Thread* t = sched::current()) t->acct = cls;
+    enter(cls);
+    irq_restore(flags);
+}
+
+void io_begin() {
+    uint64_t flags = irq_save();
+    if (!g_io) charge(read_cntpct_el0());
+    ++g_io;
+    irq_restore(flags);
+}
+
+void io_end() {
+    uint64_t flags = irq_save();
+    if (g_io == 1) charge(read_cntpct_el0());
+    if (g_io) --g_io;
+    irq_restore(flags);
+}
+
+Scope::Scope(Class cls) {
+    uint64_t flags = irq_save();
+    sched::Thread* t = sched::current();
+    _saved = t ? t->acct : g_cur;
+    if (t) t->acct = cls;
+    enter(cls);
+    irq_restore(flags);
+}
+
+Scope::~Scope() {
+    uint64_t flags = irq_save();
+    if (sched::Thread* t = sched::current()) t->acct = _saved;
+    enter(_saved);
+    irq_restore(flags);
+}
+
+void snapshot(Stats& out) {
+    uint64_t flags = irq_save();
+    charge(read_cntpct_el0());
+    out.total = 0;
+    for (uint32_t c = 0; c < CLASSES; ++c) {
+        out.ticks[c] = g_ticks[c];
+        out.total   += g_ticks[c];
+    }
+    irq_restore(flags);
+}
+
+uint32_t busy_permille(const Stats& a, const Stats& b) {
+    uint64_t total = b.total - a.total;
+    if (!total) return 0;
+    uint64_t idle = (b.ticks[IDLE] - a.ticks[IDLE]) + (b.ticks[DISK_WAIT] - a.ticks[DISK_WAIT]);
+    return (uint32_t)((total - idle) * 1000u / total);
+}
+
+const char* name(Class cls) {
+    return cls < CLASSES ? k_names[cls] : "?";
+}
+
+}
@@ -0,0 +1,48 @@
+/*
+  cpustat.hpp - where cpu 0's time goes
+  every cntpct tick since boot is charged to exactly one class. the
+  scheduler switches class with the thread it runs (Thread::acct, set once
+  by classify() at the top of a thread), irq_entry charges irq and softirq
+  time, and Scope lends the current thread another class for a stretch,
+  like vgpu spinning on the control queue. the idle thread, which sits in
+  wfi, counts as disk wait while a vblk request is in flight and as idle
+  otherwise, so busy is everything except those two
+  secondaries only run pool jobs and are not counted here
+*/
+#pragma once
+#include <stdint.h>
+
+namespace cpustat {
+
+enum Class : uint8_t {
+    OTHER, IDLE, DISK_WAIT, IRQ, INPUT, APPS, COMPOSITOR, GPU_WAIT, CLASSES
+};
+
+struct Stats {
+    uint64_t ticks[CLASSES];
+    uint64_t total;
+};
+
+uint8_t enter(uint8_t cls);
+
+void classify(Class cls);
+
+void io_begin();
+void io_end();
+
+class Scope {
+public:
+    explicit Scope(Class cls);
+    ~Scope();
+
+private:
+    uint8_t _saved;
+};
+
+void snapshot(Stats& out);
+
+uint32_t busy_permille(const Stats& a, const Stats& b);
+
+const char* name(Class cls);
+
+}
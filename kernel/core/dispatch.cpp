@@ -0,0 +1,216 @@
+/*
+  dispatch.cpp - app dispatcher
+  a small fixed task table, one kernel thread per task. the thread takes the
+  kernel lock and sleeps on the task's wait queue until a signal is pending,
+  then runs the handler. wake_at() arms a one-shot timer whose callback sets
+  SIG_TIMER from the irq. a removed slot bumps its generation, so a task
+  thread that wakes into a reused slot just exits
+  a task thread allocates under heap owner slot + 1; heap_base is what that
+  tag already held when the slot was taken
+*/
+#include "kernel/core/dispatch.hpp"
+#include "kernel/sched/sched.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/wm/wm.hpp"
+#include "kernel/core/trace.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/core/cpustat.hpp"
+#include "kernel/mm/heap.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+struct Task {
+    const char*       name;
+    dispatch::Handler fn;
+    wm::Window*       win;
+    uint32_t          interest;
+    uint32_t          pending;
+    uint32_t          reason;
+    int               timer;
+    uint16_t          gen;
+    bool              used;
+    sched::Thread*    thread;
+    sched::WaitQueue  wq;
+    uint32_t          runs;
+    uint32_t          inputs;
+    size_t            heap_base;
+};
+
+static Task             g_tasks[dispatch::MAX_TASKS];
+static bool             g_redraw = false;
+static sched::WaitQueue g_redraw_wq;
+
+static uintptr_t handle(int id) {
+    return ((uintptr_t)g_tasks[id].gen << 8) | (uintptr_t)id;
+}
+
+static Task* lookup(uintptr_t h) {
+    int      id  = (int)(h & 0xFFu);
+    uint16_t gen = (uint16_t)(h >> 8);
+    if (id >= dispatch::MAX_TASKS) return nullptr;
+    Task& t = g_tasks[id];
+    return (t.used && t.gen == gen) ? &t : nullptr;
+}
+
+static void signal(Task& t, uint32_t sig) {
+    uint64_t flags = irq_save();
+    t.pending |= sig;
+    irq_restore(flags);
+    sched::wake_one(t.wq);
+}
+
+static void on_timer(void* arg) {
+    Task* t = lookup((uintptr_t)arg);
+    if (!t) return;
+    t->timer = -1;
+    signal(*t, dispatch::SIG_TIMER);
+}
+
+static void task_main(void* arg) {
+    uintptr_t h = (uintptr_t)arg;
+    cpustat::classify(cpustat::APPS);
+    sched::current()->heap_owner = (uint8_t)((h & 0xFFu) + 1u);
+    sched::lock_kernel();
+    for (;;) {
+        Task* t = lookup(h);
+        if (!t) break;
+
+        uint64_t flags = irq_save();
+        uint32_t why = t->pending;
+        t->pending = 0;
+        irq_restore(flags);
+        if ((t->interest & dispatch::SIG_INPUT) && wm::win_has_input(t->win))
+            why |= dispatch::SIG_INPUT;
+
+        if (!why) {
+            flags = irq_save();
+            if (!t->pending) sched::wait(t->wq);
+            irq_restore(flags);
+            continue;
+        }
+
+        t->reason = why;
+        ++t->runs;
+        if (why & dispatch::SIG_INPUT) ++t->inputs;
+        {
+            TRACE_SCOPE(trace::APP_TICK, (uint64_t)(uintptr_t)t->name);
+            framestat::Scope fs(framestat::APPS);
+            t->fn(timer::ticks());
+        }
+        if ((t = lookup(h))) t->reason = 0;
+    }
+    sched::unlock_kernel();
+}
+
+}
+
+namespace dispatch {
+
+int add(const char* name, Handler h, uint32_t interest, wm::Window* win) {
+    for (int i = 0; i < MAX_TASKS; ++i) {
+        Task& t = g_tasks[i];
+        if (t.used) continue;
+        t.name     = name;
+        t.fn       = h;
+        t.win      = win;
+        t.interest = interest;
+        t.pending  = 0;
+        t.reason   = 0;
+        t.timer    = -1;
+        t.runs     = 0;
+        t.inputs   = 0;
+        t.heap_base = kheap::owner_bytes((uint32_t)i + 1u);
+        t.used     = true;
+        t.thread   = sched::spawn(name, task_main, (void*)handle(i), sched::PRIO_APP);
+        if (!t.thread) {
+            t.used = false;
+            return -1;
+        }
+        return i;
+    }
+    return -1;
+}
+
+void remove(int id) {
+    if (id < 0 || id >= MAX_TASKS || !g_tasks[id].used) return;
+    Task& t = g_tasks[id];
+    timer::cancel(t.timer);
+    t.timer  = -1;
+    t.used   = false;
+    t.gen    = (uint16_t)(t.gen + 1u);
+    t.thread = nullptr;
+    sched::wake_all(t.wq);
+}
+
+void wake(int id) {
+    if (id < 0 || id >= MAX_TASKS || !g_tasks[id].used) return;
+    signal(g_tasks[id], SIG_WAKE);
+}
+
+void wake_at(int id, uint64_t tick) {
+    if (id < 0 || id >= MAX_TASKS || !g_tasks[id].used) return;
+    Task& t = g_tasks[id];
+    timer::cancel(t.timer);
+    t.timer = timer::add(timer::tick_to_ns(tick), on_timer, (void*)handle(id));
+}
+
+void notify(uint32_t sig) {
+    for (int i = 0; i < MAX_TASKS; ++i) {
+        Task& t = g_tasks[i];
+        if (t.used && (t.interest & sig)) signal(t, t.interest & sig);
+    }
+}
+
+void poll_input() {
+    for (int i = 0; i < MAX_TASKS; ++i) {
+        Task& t = g_tasks[i];
+        if (t.used && (t.interest & SIG_INPUT) && wm::win_has_input(t.win))
+            signal(t, SIG_INPUT);
+    }
+}
+
+uint32_t reason() {
+    sched::Thread* cur = sched::current();
+    for (int i = 0; i < MAX_TASKS; ++i)
+        if (g_tasks[i].used && g_tasks[i].thread == cur) return g_tasks[i].reason;
+    return 0;
+}
+
+void redraw() {
+    g_redraw = true;
+    sched::wake_all(g_redraw_wq);
+}
+
+bool take_redraw() {
+    bool r = g_redraw;
+    g_redraw = false;
+    return r;
+}
+
+bool wait_redraw(uint64_t deadline_ns) {
+    if (!g_redraw) sched::wait_until(g_redraw_wq, deadline_ns);
+    return take_redraw();
+}
+
+int stats(AppStats* out, int max) {
+    uint64_t khz = read_cntfrq_el0() / 1000u;
+    int n = 0;
+    for (int i = 0; i < MAX_TASKS && n < max; ++i) {
+        const Task& t = g_tasks[i];
+        if (!t.used) continue;
+        AppStats& s = out[n++];
+        size_t heap = kheap::owner_bytes((uint32_t)i + 1u);
+        s.id         = (uint32_t)handle(i);
+        s.name       = t.name;
+        s.win        = t.win;
+        s.cpu_us     = (t.thread && khz) ? t.thread->cpu_ticks * 1000u / khz : 0;
+        s.runs       = t.runs;
+        s.inputs     = t.inputs;
+        s.heap_bytes = heap > t.heap_base ? heap - t.heap_base : 0;
+    }
+    return n;
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+  dispatch.hpp - event and timer driven app dispatcher
+  apps add() a handler with the signals they care about; each one gets its
+  own kernel thread that sleeps until a signal fires: input on its window
+  (poll_input), a wake_at() deadline, an explicit wake(), or a notify() of
+  fs/terminal changes. handlers run under the big kernel lock
+  handlers ask for a frame with redraw(); the compositor sleeps in
+  wait_redraw() until one is requested
+  stats() reports each task's thread cpu time, handler runs, runs woken by
+  input, and the heap its thread has allocated since add()
+*/
+#pragma once
+#include <stdint.h>
+
+namespace wm { struct Window; }
+
+namespace dispatch {
+
+using Handler = void (*)(uint64_t ticks);
+
+static constexpr uint32_t SIG_WAKE  = 1u << 0;
+static constexpr uint32_t SIG_INPUT = 1u << 1;
+static constexpr uint32_t SIG_TIMER = 1u << 2;
+static constexpr uint32_t SIG_FS    = 1u << 3;
+static constexpr uint32_t SIG_TERM  = 1u << 4;
+
+static constexpr int MAX_TASKS = 16;
+
+struct AppStats {
+    uint32_t    id;
+    const char* name;
+    wm::Window* win;
+    uint64_t    cpu_us;
+    uint32_t    runs;
+    uint32_t    inputs;
+    uint64_t    heap_bytes;
+};
+
+int  add(const char* name, Handler h, uint32_t interest, wm::Window* win = nullptr);
+void remove(int id);
+
+void wake(int id);
+void wake_at(int id, uint64_t tick);
+void notify(uint32_t sig);
+
+void poll_input();
+
+uint32_t reason();
+
+void redraw();
+bool take_redraw();
+bool wait_redraw(uint64_t deadline_ns);
+
+int stats(AppStats* out, int max);
+
+}
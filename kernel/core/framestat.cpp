@@ -0,0 +1,131 @@
+/*
+  framestat.cpp - frame phase accumulators and the rolling window
+  everything is charged from cpu 0 threads (the compositor, app threads,
+  vgpu::send callers) except composite, which the wm charges once around
+  the whole parallel band render, so plain adds under irq_save suffice
+  summary() copies each phase's window out with irqs masked and sorts the
+  copy outside, callers hold the kernel lock which covers its scratch buffer
+*/
+#include "kernel/core/framestat.hpp"
+#include <stdint.h>
+
+namespace {
+
+static uint64_t g_acc[framestat::PHASES];
+static uint64_t g_pixels = 0;
+static uint64_t g_bytes  = 0;
+static uint64_t g_t0     = 0;
+
+static uint32_t g_ring[framestat::PHASES][framestat::WINDOW];
+static uint64_t g_ring_px[framestat::WINDOW];
+static uint64_t g_ring_bytes[framestat::WINDOW];
+static uint32_t g_head  = 0;
+static uint32_t g_count = 0;
+static uint64_t g_total = 0;
+
+static const char* const k_names[framestat::PHASES] = {
+    "apps", "composite", "cursor", "transfer", "flush", "total",
+};
+
+static uint32_t to_ns(uint64_t ticks) {
+    uint64_t f = read_cntfrq_el0();
+    uint64_t ns = f ? ticks * 1000000000ull / f : 0;
+    return ns > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)ns;
+}
+
+static uint32_t pct(uint32_t* v, uint32_t n, uint32_t p) {
+    return n ? v[(n - 1) * p / 100u] / 1000u : 0;
+}
+
+}
+
+namespace framestat {
+
+void begin() {
+    uint64_t flags = irq_save();
+    for (uint32_t p = COMPOSITE; p < PHASES; ++p) g_acc[p] = 0;
+    g_pixels = 0;
+    g_bytes  = 0;
+    g_t0     = read_cntpct_el0();
+    irq_restore(flags);
+}
+
+void end() {
+    uint64_t flags = irq_save();
+    g_acc[TOTAL] = g_acc[APPS] + (read_cntpct_el0() - g_t0);
+    for (uint32_t p = 0; p < PHASES; ++p) {
+        g_ring[p][g_head] = to_ns(g_acc[p]);
+        g_acc[p] = 0;
+    }
+    g_ring_px[g_head]    = g_pixels;
+    g_ring_bytes[g_head] = g_bytes;
+    g_head = (g_head + 1u) % WINDOW;
+    if (g_count < WINDOW) ++g_count;
+    ++g_total;
+    irq_restore(flags);
+}
+
+void add(Phase p, uint64_t ticks) {
+    uint64_t flags = irq_save();
+    g_acc[p] += ticks;
+    irq_restore(flags);
+}
+
+void add_pixels(uint64_t n) {
+    uint64_t flags = irq_save();
+    g_pixels += n;
+    irq_restore(flags);
+}
+
+void add_bytes(uint64_t n) {
+    uint64_t flags = irq_save();
+    g_bytes += n;
+    irq_restore(flags);
+}
+
+void summary(Summary& out) {
+    static uint32_t s_tmp[WINDOW];
+
+    uint64_t flags = irq_save();
+    uint32_t n = g_count;
+    out.frames       = n;
+    out.total_frames = g_total;
+    uint64_t px = 0, bytes = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        px    += g_ring_px[i];
+        bytes += g_ring_bytes[i];
+    }
+    irq_restore(flags);
+    out.pixels = n ? px / n : 0;
+    out.bytes  = n ? bytes / n : 0;
+
+    for (uint32_t p = 0; p < PHASES; ++p) {
+        flags = irq_save();
+        for (uint32_t i = 0; i < n; ++i) s_tmp[i] = g_ring[p][i];
+        irq_restore(flags);
+
+        for (uint32_t i = 1; i < n; ++i) {
+            uint32_t v = s_tmp[i];
+            uint32_t j = i;
+            for (; j > 0 && s_tmp[j - 1] > v; --j) s_tmp[j] = s_tmp[j - 1];
+            s_tmp[j] = v;
+        }
+        out.p50_us[p] = pct(s_tmp, n, 50);
+        out.p95_us[p] = pct(s_tmp, n, 95);
+        out.p99_us[p] = pct(s_tmp, n, 99);
+    }
+}
+
+void reset() {
+    uint64_t flags = irq_save();
+    g_head  = 0;
+    g_count = 0;
+    g_total = 0;
+    irq_restore(flags);
+}
+
+const char* name(Phase p) {
+    return p < PHASES ? k_names[p] : "?";
+}
+
+}
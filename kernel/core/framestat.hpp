@@ -0,0 +1,54 @@
+/*
+  framestat.hpp - per-frame cost breakdown
+  the compositor brackets each render_dirty() with begin()/end(); inside,
+  Scope (or add()) charges cntpct ticks to a phase: composite and cursor in
+  the wm, transfer and flush in vgpu. app ticks run on their own threads
+  between frames and are charged to the next frame. total is apps plus the
+  wall time of the render
+  the last WINDOW frames are kept per phase for p50/p95/p99, along with the
+  pixels composited and bytes sent to the host in each
+*/
+#pragma once
+#include <stdint.h>
+#include "arch/aarch64/regs.hpp"
+
+namespace framestat {
+
+enum Phase : uint32_t { APPS, COMPOSITE, CURSOR, TRANSFER, FLUSH, TOTAL, PHASES };
+
+static constexpr uint32_t WINDOW = 128;
+
+struct Summary {
+    uint32_t frames;
+    uint64_t total_frames;
+    uint32_t p50_us[PHASES];
+    uint32_t p95_us[PHASES];
+    uint32_t p99_us[PHASES];
+    uint64_t pixels;
+    uint64_t bytes;
+};
+
+void begin();
+void end();
+
+void add(Phase p, uint64_t ticks);
+void add_pixels(uint64_t n);
+void add_bytes(uint64_t n);
+
+class Scope {
+public:
+    explicit Scope(Phase p) : _t0(read_cntpct_el0()), _p(p) {}
+    ~Scope() { add(_p, read_cntpct_el0() - _t0); }
+
+private:
+    uint64_t _t0;
+    Phase    _p;
+};
+
+void summary(Summary& out);
+
+void reset();
+
+const char* name(Phase p);
+
+}
@@ -0,0 +1,205 @@
+/*
+  inputrec.cpp - input event recorder and replayer
+  events are kept in one heap buffer of MAX_EVENTS; recording stops adding
+  once it is full
+  the input thread records and replays and the shell starts and stops, all
+  under the kernel lock, so there is no other locking
+  the keys of the shell line that stopped a recording are dropped from it,
+  otherwise a replay would type the stop command back in. note_shell_key
+  tells which recorded keys reached the shell, so editor typing and
+  pointer events in between are kept
+  file layout: u32 magic 'IREC', u32 version, u32 count, u32 pad, then
+  count Events
+*/
+#include "kernel/core/inputrec.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/fs/vfs.hpp"
+#include "kernel/core/print.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <string.h>
+#include <stdint.h>
+
+namespace {
+
+static constexpr uint32_t MAGIC   = 0x43455249u;
+static constexpr uint32_t VERSION = 1u;
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t pad;
+};
+
+static_assert(sizeof(inputrec::Event) == 24, "record layout is part of the file format");
+
+static inputrec::Event* g_buf       = nullptr;
+static uint32_t         g_count     = 0;
+static uint32_t         g_pos       = 0;
+static bool             g_recording = false;
+static bool             g_replaying = false;
+static bool             g_fast      = false;
+static uint64_t         g_t0_ticks  = 0;
+static uint64_t         g_start_ns  = 0;
+static constexpr uint32_t LINE_KEYS = 256;
+
+static uint32_t         g_last_key  = UINT32_MAX;
+static uint32_t         g_line_keys[LINE_KEYS];
+static uint32_t         g_nline     = 0;
+static bool             g_line_done = false;
+
+static uint64_t ticks_to_ns(uint64_t t) {
+    uint64_t f = read_cntfrq_el0();
+    return f ? t * 1000000000ull / f : 0;
+}
+
+static void release() {
+    kheap::free(g_buf);
+    g_buf       = nullptr;
+    g_count     = 0;
+    g_pos       = 0;
+    g_recording = false;
+    g_replaying = false;
+}
+
+static inputrec::Event* append(uint64_t ts) {
+    if (!g_recording || g_count >= inputrec::MAX_EVENTS) return nullptr;
+    if (g_count == 0) g_t0_ticks = ts;
+    inputrec::Event& e = g_buf[g_count++];
+    memset(&e, 0, sizeof(e));
+    e.t_ns = ts > g_t0_ticks ? ticks_to_ns(ts - g_t0_ticks) : 0;
+    return &e;
+}
+
+}
+
+namespace inputrec {
+
+bool start_record() {
+    release();
+    g_buf = static_cast<Event*>(kheap::alloc(MAX_EVENTS * sizeof(Event), 8));
+    if (!g_buf) return false;
+    g_last_key  = UINT32_MAX;
+    g_nline     = 0;
+    g_line_done = false;
+    g_recording = true;
+    return true;
+}
+
+int stop_record(const char* path) {
+    if (!g_recording) return -1;
+    g_recording = false;
+
+    uint32_t n = g_count;
+    if (g_line_done) {
+        n = 0;
+        uint32_t k = 0;
+        for (uint32_t i = 0; i < g_count; ++i) {
+            if (k < g_nline && g_line_keys[k] == i) { ++k; continue; }
+            g_buf[n++] = g_buf[i];
+        }
+    }
+    size_t bytes = sizeof(Header) + (size_t)n * sizeof(Event);
+    uint8_t* out = static_cast<uint8_t*>(kheap::alloc(bytes, 8));
+    if (!out) { release(); return -1; }
+
+    Header h{ MAGIC, VERSION, n, 0 };
+    memcpy(out, &h, sizeof(h));
+    memcpy(out + sizeof(h), g_buf, (size_t)n * sizeof(Event));
+    int r = vfs::write(path, out, bytes);
+    kheap::free(out);
+    release();
+    return r < 0 ? -1 : (int)n;
+}
+
+bool recording() { return g_recording; }
+
+void record_key(const kbd::KeyEvent& ev, Kind kind) {
+    Event* e = append(ev.ts);
+    if (!e) return;
+    e->kind = kind;
+    e->ch   = ev.ch;
+    g_last_key = g_count - 1;
+}
+
+void note_shell_key(char ch) {
+    if (!g_recording) return;
+    if (g_line_done) {
+        g_nline     = 0;
+        g_line_done = false;
+    }
+    if (g_last_key != UINT32_MAX && g_nline < LINE_KEYS)
+        g_line_keys[g_nline++] = g_last_key;
+    g_last_key = UINT32_MAX;
+    if (ch == '\r' || ch == '\n') g_line_done = true;
+}
+
+void record_pointer(const tablet::PointerEvent& ev) {
+    Event* e = append(ev.ts);
+    if (!e) return;
+    e->kind  = Kind::Pointer;
+    e->x     = ev.x;
+    e->y     = ev.y;
+    e->left  = ev.left;
+    e->right = ev.right;
+}
+
+int start_replay(const char* path, bool fast) {
+    release();
+
+    Header h;
+    if (vfs::read(path, &h, sizeof(h)) != (int)sizeof(h) ||
+        h.magic != MAGIC || h.version != VERSION || h.count > MAX_EVENTS)
+        return -1;
+
+    size_t bytes = sizeof(Header) + (size_t)h.count * sizeof(Event);
+    uint8_t* in = static_cast<uint8_t*>(kheap::alloc(bytes, 8));
+    if (!in) return -1;
+    if (vfs::read(path, in, bytes) != (int)bytes) { kheap::free(in); return -1; }
+
+    g_buf = static_cast<Event*>(kheap::alloc(h.count ? h.count * sizeof(Event) : sizeof(Event), 8));
+    if (!g_buf) { kheap::free(in); return -1; }
+    memcpy(g_buf, in + sizeof(Header), (size_t)h.count * sizeof(Event));
+    kheap::free(in);
+
+    g_count     = h.count;
+    g_pos       = 0;
+    g_fast      = fast;
+    g_start_ns  = timer::now_ns();
+    g_replaying = true;
+    return (int)g_count;
+}
+
+void stop_replay() {
+    if (g_replaying) release();
+}
+
+bool replaying() { return g_replaying; }
+
+bool peek(Event& ev) {
+    if (!g_replaying) return false;
+    if (g_pos >= g_count) {
+        printk("input: replay done, %u events in %u ms\n",
+               g_count, (unsigned)((timer::now_ns() - g_start_ns) / 1000000ull));
+        release();
+        return false;
+    }
+    if (timer::now_ns() < next_due_ns()) return false;
+    ev = g_buf[g_pos];
+    return true;
+}
+
+void pop() {
+    if (g_replaying && g_pos < g_count) ++g_pos;
+}
+
+uint64_t next_due_ns() {
+    if (!g_replaying || g_pos >= g_count || g_fast) return 0;
+    return g_start_ns + g_buf[g_pos].t_ns;
+}
+
+uint32_t count()    { return g_count; }
+uint32_t position() { return g_pos; }
+
+}
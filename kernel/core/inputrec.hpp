@@ -0,0 +1,60 @@
+/*
+  inputrec.hpp - input record and replay
+  while recording, the input thread hands every keyboard, serial and tablet
+  event to record_key()/record_pointer() and says which keys reached the
+  shell with note_shell_key(); stop_record() writes them to a file as
+  a header plus fixed-size records with times relative to the first event
+  replay loads such a file and peek()/pop() hand the events back to the
+  input thread when they are due, at the recorded pace or, with fast, all
+  at once. live input is ignored while a replay runs
+*/
+#pragma once
+#include <stdint.h>
+#include "kernel/drivers/virtio/input.hpp"
+#include "kernel/drivers/virtio/tablet.hpp"
+
+namespace inputrec {
+
+static constexpr uint32_t MAX_EVENTS = 16384;
+
+enum class Kind : uint8_t { Key, Pointer, Serial };
+
+struct Event {
+    uint64_t t_ns;
+    Kind     kind;
+    char     ch;
+    bool     left;
+    bool     right;
+    int32_t  x;
+    int32_t  y;
+};
+
+bool start_record();
+
+int  stop_record(const char* path);
+
+bool recording();
+
+void record_key(const kbd::KeyEvent& ev, Kind kind = Kind::Key);
+
+void note_shell_key(char ch);
+
+void record_pointer(const tablet::PointerEvent& ev);
+
+int  start_replay(const char* path, bool fast);
+
+void stop_replay();
+
+bool replaying();
+
+bool peek(Event& ev);
+
+void pop();
+
+uint64_t next_due_ns();
+
+uint32_t count();
+
+uint32_t position();
+
+}
@@ -0,0 +1,73 @@
+/*
+  ksyms.cpp - lookups in the symbol table embedded by tools/ksyms.py
+  the table is read through the linker symbols rather than a c++ array so
+  the compiler cannot fold the empty placeholder the linker emits
+  find() is a binary search over the address column and is safe in irqs
+*/
+#include "kernel/core/ksyms.hpp"
+#include <stdint.h>
+
+extern "C" const uint8_t __ksyms_start[];
+
+namespace {
+
+static constexpr uint32_t MAGIC = 0x4D59534Bu;
+
+struct Header {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t text_base;
+    uint32_t text_size;
+    uint32_t names_off;
+};
+
+static const Header& hdr() {
+    return *reinterpret_cast<const Header*>(__ksyms_start);
+}
+
+static const uint32_t* addrs() {
+    return reinterpret_cast<const uint32_t*>(__ksyms_start + sizeof(Header));
+}
+
+static const uint32_t* names() {
+    return addrs() + hdr().count;
+}
+
+}
+
+namespace ksyms {
+
+bool ready() {
+    return hdr().magic == MAGIC && hdr().count > 0;
+}
+
+uint32_t count() {
+    return ready() ? hdr().count : 0;
+}
+
+int find(uint64_t pc) {
+    if (!ready()) return -1;
+    const Header& h = hdr();
+    if (pc < h.text_base || pc - h.text_base >= h.text_size) return -1;
+
+    uint32_t off = (uint32_t)(pc - h.text_base);
+    const uint32_t* a = addrs();
+    uint32_t lo = 0, hi = h.count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (a[mid] <= off) lo = mid;
+        else               hi = mid;
+    }
+    return a[lo] <= off ? (int)lo : -1;
+}
+
+const char* name(uint32_t i) {
+    if (i >= count()) return "?";
+    return reinterpret_cast<const char*>(__ksyms_start + names()[i]);
+}
+
+uint64_t addr(uint32_t i) {
+    return i < count() ? hdr().text_base + addrs()[i] : 0;
+}
+
+}
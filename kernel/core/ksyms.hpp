@@ -0,0 +1,22 @@
+/*
+  ksyms.hpp - kernel function symbol table
+  tools/ksyms.py fills the .ksyms section after linking with every function
+  in .text, sorted by address. find() maps a pc to the function containing
+  it; ready() is false for an image that was linked without that step
+*/
+#pragma once
+#include <stdint.h>
+
+namespace ksyms {
+
+bool ready();
+
+uint32_t count();
+
+int find(uint64_t pc);
+
+const char* name(uint32_t i);
+
+uint64_t addr(uint32_t i);
+
+}
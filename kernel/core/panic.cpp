@@ -1,14 +1,17 @@
 /*
   panic.cpp - drops into a permanent halt with an error message
-  masks all interrupts so nothing can interrupt the death print
+  masks all interrupts so nothing can interrupt the death print, then
+  flushes whatever the uart still had queued and prints synchronously
   also used by KASSERT. once called there is no recovery
 */
 #include "kernel/core/panic.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/drivers/uart_pl011.hpp"
 
 [[noreturn]] void panic(const char* msg, unsigned long long val) {
 
     asm volatile("msr daifset, #0xF" ::: "memory");
+    uart::flush_sync();
 
     print("\n\n*** KERNEL PANIC ***\n");
     print("    ");
@@ -0,0 +1,148 @@
+/*
+  pmu.cpp - pmuv3 setup and counter reads
+  pmcr.n says how many event counters the core has; the a57 has six and
+  only the first four are used. pmccfiltr/pmevtyper are left at 0, which
+  counts at el1 (the kernel) as well as el0. the cycle counter is 64-bit
+  (pmcr.lc), the event counters are 32-bit and a difference of two reads
+  is taken mod 2^32, so one span is good for about 4g events. qemu's tcg
+  pmu counts cycles and instructions but reports 0 for events it does not
+  model, such as the cache refills
+  counter totals are updated with atomics because gfx and heap scopes run
+  on the pool cores too; a counter joins the list the first time it counts
+*/
+#include "kernel/core/pmu.hpp"
+#include "kernel/core/print.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace pmu {
+
+bool g_collect = false;
+
+}
+
+namespace {
+
+static constexpr uint64_t PMCR_E  = 1u << 0;
+static constexpr uint64_t PMCR_P  = 1u << 1;
+static constexpr uint64_t PMCR_C  = 1u << 2;
+static constexpr uint64_t PMCR_LC = 1u << 6;
+
+static constexpr uint32_t USED_COUNTERS = 4;
+static constexpr uint32_t CYCLE_BIT     = 1u << 31;
+
+static constexpr uint32_t k_events[USED_COUNTERS] = {
+    pmu::INST_RETIRED, pmu::L1D_CACHE_REFILL, pmu::L2D_CACHE_REFILL, pmu::BR_MIS_PRED,
+};
+
+static bool          g_ready    = false;
+static uint32_t      g_n        = 0;
+static pmu::Counter* g_counters = nullptr;
+static uint32_t      g_list_lock = 0;
+
+static uint64_t pmcr_n() {
+    return (SYSREG_READ(pmcr_el0) >> 11) & 0x1F;
+}
+
+static void link(pmu::Counter* c) {
+    uint64_t flags = irq_save();
+    while (__atomic_exchange_n(&g_list_lock, 1u, __ATOMIC_ACQUIRE)) {}
+    if (!c->linked) {
+        c->next     = g_counters;
+        g_counters  = c;
+        c->linked   = true;
+    }
+    __atomic_store_n(&g_list_lock, 0u, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+}
+
+namespace pmu {
+
+Sample operator-(const Sample& a, const Sample& b) {
+    return Sample{ a.cycles - b.cycles,
+                   (uint32_t)(a.instructions - b.instructions),
+                   (uint32_t)(a.l1d_refill   - b.l1d_refill),
+                   (uint32_t)(a.l2d_refill   - b.l2d_refill),
+                   (uint32_t)(a.br_mispred   - b.br_mispred) };
+}
+
+void Counter::add(const Sample& d) {
+    if (!__atomic_load_n(&linked, __ATOMIC_ACQUIRE)) link(this);
+    __atomic_fetch_add(&calls,              1u,             __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total.cycles,       d.cycles,       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total.instructions, d.instructions, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total.l1d_refill,   d.l1d_refill,   __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total.l2d_refill,   d.l2d_refill,   __ATOMIC_RELAXED);
+    __atomic_fetch_add(&total.br_mispred,   d.br_mispred,   __ATOMIC_RELAXED);
+}
+
+void init_cpu() {
+    uint32_t n = (uint32_t)pmcr_n();
+    if (n > USED_COUNTERS) n = USED_COUNTERS;
+
+    SYSREG_WRITE(pmcntenclr_el0, 0xFFFFFFFFu);
+    SYSREG_WRITE(pmintenclr_el1, 0xFFFFFFFFu);
+    SYSREG_WRITE(pmovsclr_el0,   0xFFFFFFFFu);
+    SYSREG_WRITE(pmccfiltr_el0,  0);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        SYSREG_WRITE(pmselr_el0, i);
+        isb();
+        SYSREG_WRITE(pmxevtyper_el0, k_events[i]);
+    }
+
+    SYSREG_WRITE(pmcr_el0, PMCR_E | PMCR_P | PMCR_C | PMCR_LC);
+    isb();
+    SYSREG_WRITE(pmcntenset_el0, CYCLE_BIT | ((1u << n) - 1u));
+    isb();
+}
+
+bool init() {
+    uint64_t dfr = SYSREG_READ(id_aa64dfr0_el1);
+    uint32_t ver = (uint32_t)((dfr >> 8) & 0xF);
+    if (ver == 0 || ver == 0xF) {
+        print("pmu: not implemented\n");
+        return false;
+    }
+
+    uint32_t n = (uint32_t)pmcr_n();
+    g_n = n < USED_COUNTERS ? n : USED_COUNTERS;
+    init_cpu();
+    g_ready = true;
+    printk("pmu: pmuv3 with %u event counters, using %u + cycles\n",
+           (unsigned)n, (unsigned)g_n);
+    return true;
+}
+
+bool ready() { return g_ready; }
+
+uint32_t event_counters() { return g_n; }
+
+Sample read() {
+    Sample s{};
+    if (!g_ready) return s;
+    isb();
+    s.cycles = SYSREG_READ(pmccntr_el0);
+    if (g_n > 0) s.instructions = (uint32_t)SYSREG_READ(pmevcntr0_el0);
+    if (g_n > 1) s.l1d_refill   = (uint32_t)SYSREG_READ(pmevcntr1_el0);
+    if (g_n > 2) s.l2d_refill   = (uint32_t)SYSREG_READ(pmevcntr2_el0);
+    if (g_n > 3) s.br_mispred   = (uint32_t)SYSREG_READ(pmevcntr3_el0);
+    return s;
+}
+
+void set_collecting(bool on) {
+    __atomic_store_n(&g_collect, on && g_ready, __ATOMIC_RELAXED);
+}
+
+Counter* counters() { return g_counters; }
+
+void reset_counters() {
+    for (Counter* c = g_counters; c; c = c->next) {
+        c->calls = 0;
+        c->total = Sample{};
+    }
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+  pmu.hpp - cortex-a57 performance monitor counters
+  init() turns the pmu on for the calling core: the cycle counter plus four
+  event counters for instructions retired, l1d refills, l2d refills and
+  branch mispredicts, all counting at el1. each core has its own counters,
+  so a Sample only covers the core that read it
+  Counter is a named accumulator, Scope adds the counts of a block to one:
+      static pmu::Counter c_blit("gfx::blit");
+      pmu::Scope s(c_blit);
+  scopes only read the counters while collecting() is on (perfstat turns it
+  on around a command), otherwise they cost a load and a branch
+*/
+#pragma once
+#include <stdint.h>
+
+namespace pmu {
+
+enum Event : uint32_t {
+    INST_RETIRED     = 0x08,
+    L1D_CACHE_REFILL = 0x03,
+    L2D_CACHE_REFILL = 0x17,
+    BR_MIS_PRED      = 0x10,
+};
+
+struct Sample {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t l1d_refill;
+    uint64_t l2d_refill;
+    uint64_t br_mispred;
+};
+
+Sample operator-(const Sample& a, const Sample& b);
+
+struct Counter {
+    constexpr explicit Counter(const char* n) : name(n) {}
+
+    const char* name;
+    uint64_t    calls  = 0;
+    Sample      total  = {};
+    Counter*    next   = nullptr;
+    bool        linked = false;
+
+    void add(const Sample& d);
+};
+
+bool init();
+
+void init_cpu();
+
+bool ready();
+
+uint32_t event_counters();
+
+Sample read();
+
+extern bool g_collect;
+
+static inline bool collecting() {
+    return __builtin_expect(__atomic_load_n(&g_collect, __ATOMIC_RELAXED), 0);
+}
+
+void set_collecting(bool on);
+
+Counter* counters();
+
+void reset_counters();
+
+class Scope {
+public:
+    explicit Scope(Counter& c) : _c(collecting() ? &c : nullptr) {
+        if (_c) _start = read();
+    }
+    ~Scope() {
+        if (_c) _c->add(read() - _start);
+    }
+
+private:
+    Counter* _c;
+    Sample   _start;
+};
+
+}
@@ -0,0 +1,122 @@
+/*
+  prof.cpp - virtual-timer sampling profiler
+  the virtual timer (ppi 27) is left to the profiler so its rate is
+  independent of the tickless physical timer. it runs at the highest gic
+  priority, so no other handler can nest inside it and elr_el1 still holds
+  the pc the sample interrupted, even when that pc is in another handler.
+  code that runs with irqs masked is charged to wherever irqs come back on
+  each sample is one binary search in ksyms and one counter increment; the
+  last slot counts pcs outside any known function
+*/
+#include "kernel/core/prof.hpp"
+#include "kernel/core/ksyms.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/mm/heap.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+static constexpr uint32_t PROF_IRQ = 27;
+
+static constexpr uint64_t CTL_ENABLE = (1u << 0);
+static constexpr uint64_t CTL_IMASK  = (1u << 1);
+
+static uint32_t*     g_hits    = nullptr;
+static uint32_t      g_slots   = 0;
+static uint64_t      g_period  = 0;
+static uint32_t      g_hz      = 0;
+static uint32_t      g_samples = 0;
+static volatile bool g_running = false;
+static bool          g_irq_set = false;
+
+static void on_irq() {
+    uint64_t pc = read_elr_el1();
+
+    if (!g_running) {
+        write_cntv_ctl_el0(CTL_IMASK);
+        isb();
+        return;
+    }
+
+    uint64_t next = read_cntv_cval_el0() + g_period;
+    uint64_t now  = read_cntvct_el0();
+    if (next <= now) next = now + g_period;
+    write_cntv_cval_el0(next);
+    isb();
+
+    int i = ksyms::find(pc);
+    ++g_hits[i < 0 ? g_slots - 1 : (uint32_t)i];
+    ++g_samples;
+}
+
+}
+
+namespace prof {
+
+bool start(uint32_t rate) {
+    if (!ksyms::ready()) return false;
+    if (rate == 0)      rate = DEFAULT_HZ;
+    if (rate > MAX_HZ)  rate = MAX_HZ;
+    stop();
+
+    if (!g_hits) {
+        g_slots = ksyms::count() + 1u;
+        g_hits  = static_cast<uint32_t*>(kheap::alloc(g_slots * sizeof(uint32_t), 16));
+        if (!g_hits) return false;
+    }
+    memset(g_hits, 0, g_slots * sizeof(uint32_t));
+    g_samples = 0;
+    g_hz      = rate;
+    g_period  = read_cntfrq_el0() / rate;
+    if (!g_period) g_period = 1;
+
+    if (!g_irq_set) {
+        gic::register_handler(PROF_IRQ, on_irq);
+        gic::set_priority(PROF_IRQ, gic::PRIO_PROF);
+        gic::enable_irq(PROF_IRQ);
+        g_irq_set = true;
+    }
+
+    uint64_t flags = irq_save();
+    g_running = true;
+    write_cntv_cval_el0(read_cntvct_el0() + g_period);
+    write_cntv_ctl_el0(CTL_ENABLE);
+    isb();
+    irq_restore(flags);
+    return true;
+}
+
+void stop() {
+    uint64_t flags = irq_save();
+    g_running = false;
+    write_cntv_ctl_el0(CTL_IMASK);
+    isb();
+    irq_restore(flags);
+}
+
+bool running() { return g_running; }
+
+uint32_t hz() { return g_hz; }
+
+uint32_t samples() { return g_samples; }
+
+uint32_t top(Entry* out, uint32_t max) {
+    if (!g_hits || !max) return 0;
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < g_slots; ++i) {
+        uint32_t h = g_hits[i];
+        if (!h) continue;
+        if (n == max && h <= out[n - 1].hits) continue;
+
+        uint32_t j = n < max ? n++ : n - 1;
+        while (j > 0 && out[j - 1].hits < h) { out[j] = out[j - 1]; --j; }
+        out[j].name = i + 1u == g_slots ? "(unknown)" : ksyms::name(i);
+        out[j].hits = h;
+    }
+    return n;
+}
+
+}
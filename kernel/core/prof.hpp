@@ -0,0 +1,32 @@
+/*
+  prof.hpp - statistical profiler
+  start(hz) samples cpu 0 at hz from the virtual timer and charges each
+  sample to the function containing the interrupted pc (see ksyms.hpp);
+  stop() freezes the counts, top() returns the hottest functions first
+*/
+#pragma once
+#include <stdint.h>
+
+namespace prof {
+
+static constexpr uint32_t DEFAULT_HZ = 4000;
+static constexpr uint32_t MAX_HZ     = 50000;
+
+struct Entry {
+    const char* name;
+    uint32_t    hits;
+};
+
+bool start(uint32_t hz = DEFAULT_HZ);
+
+void stop();
+
+bool running();
+
+uint32_t hz();
+
+uint32_t samples();
+
+uint32_t top(Entry* out, uint32_t max);
+
+}
@@ -0,0 +1,51 @@
+/*
+  spsc.hpp - lock-free single-producer single-consumer ring
+  the producer owns head and the consumer owns tail, each published with
+  release/acquire so an irq handler can push while the main loop pops
+  without masking interrupts. N must be a power of two
+*/
+#pragma once
+#include <stdint.h>
+
+template <typename T, uint32_t N>
+class SpscRing {
+    static_assert(N && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+
+    bool push(const T& v) {
+        uint32_t h = _head;
+        uint32_t t = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        if (h - t == N) { ++_dropped; return false; }
+        _buf[h & (N - 1u)] = v;
+        __atomic_store_n(&_head, h + 1u, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool pop(T& out) {
+        uint32_t t = _tail;
+        uint32_t h = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+        if (h == t) return false;
+        out = _buf[t & (N - 1u)];
+        __atomic_store_n(&_tail, t + 1u, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool empty() const {
+        return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) ==
+               __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    }
+
+    uint32_t size() const {
+        return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) -
+               __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    }
+
+    uint32_t dropped() const { return _dropped; }
+
+private:
+    T        _buf[N];
+    uint32_t _head    = 0;
+    uint32_t _tail    = 0;
+    uint32_t _dropped = 0;
+};
@@ -0,0 +1,200 @@
+/*
+  trace.cpp - tracepoint descriptors, the record ring and the json export
+  emit() claims a slot with one atomic add, fills it and publishes it by
+  storing its sequence number last, so writers on any cpu or in any irq
+  never block each other; a reader skips slots whose sequence does not
+  match because they were overwritten or are still being written
+  a record's thread is the scheduler thread on cpu 0, "irq" for anything
+  recorded inside an irq, and the pool worker on the other cores
+  dump_json() pauses recording while it copies the ring out
+*/
+#include "kernel/core/trace.hpp"
+#include "kernel/sched/sched.hpp"
+#include "kernel/sched/smp.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/fs/vfs.hpp"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace trace {
+
+uint32_t g_mask = 0;
+
+}
+
+namespace {
+
+struct Desc {
+    const char* name;
+    const char* cat;
+    const char* a0;
+    const char* a1;
+    bool        a0_is_name;
+};
+
+static constexpr Desc k_desc[] = {
+    { "irq",              "irq", "line",   nullptr,   false },
+    { "wm::render",       "gfx", "bands",  nullptr,   false },
+    { "wm::render_dirty", "gfx", nullptr,  nullptr,   false },
+    { "vgpu::send",       "gpu", "cmd",    nullptr,   false },
+    { "vblk read",        "blk", "sector", "sectors", false },
+    { "vblk write",       "blk", "sector", "sectors", false },
+    { "app tick",         "app", nullptr,  nullptr,   true  },
+};
+
+static_assert(sizeof(k_desc) / sizeof(k_desc[0]) == trace::COUNT,
+              "every trace::Id needs a descriptor");
+
+static constexpr uint32_t RING_SIZE = 4096;
+
+static trace::Record g_ring[RING_SIZE] __attribute__((aligned(64)));
+static uint32_t      g_head = 0;
+
+static uint16_t cur_tid() {
+    if (smp::cpu_id() != 0 || sched::irq_depth()) return 0;
+    sched::Thread* t = sched::current();
+    return t ? (uint16_t)(t->id + 1u) : 0;
+}
+
+struct Json {
+    char*    buf;
+    size_t   len;
+    size_t   cap;
+    uint32_t written;
+
+    void put(const char* s) {
+        while (*s && len < cap) buf[len++] = *s++;
+    }
+
+    void str(const char* s) {
+        put("\"");
+        for (; *s && len + 1 < cap; ++s) {
+            if (*s == '"' || *s == '\\') buf[len++] = '\\';
+            buf[len++] = (uint8_t)*s < 0x20 ? ' ' : *s;
+        }
+        put("\"");
+    }
+
+    void dec(uint64_t v) {
+        char tmp[21]; int n = 0;
+        do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+        while (n && len < cap) buf[len++] = tmp[--n];
+    }
+
+    void us(uint64_t ticks, uint64_t freq) {
+        uint64_t ns = (ticks / freq) * 1000000000ull + (ticks % freq) * 1000000000ull / freq;
+        dec(ns / 1000u);
+        put(".");
+        uint32_t frac = (uint32_t)(ns % 1000u);
+        char f[4] = { (char)('0' + frac / 100), (char)('0' + frac / 10 % 10),
+                      (char)('0' + frac % 10), '\0' };
+        put(f);
+    }
+
+    void meta(const char* kind, uint32_t pid, uint32_t tid, const char* name) {
+        if (written++) put(",\n");
+        put("{\"ph\":\"M\",\"name\":"); str(kind);
+        put(",\"pid\":"); dec(pid);
+        put(",\"tid\":"); dec(tid);
+        put(",\"args\":{\"name\":"); str(name); put("}}");
+    }
+};
+
+}
+
+namespace trace {
+
+void emit(Id id, uint64_t t0, uint64_t a0, uint32_t a1) {
+    uint64_t dur = read_cntpct_el0() - t0;
+    uint32_t idx = __atomic_fetch_add(&g_head, 1u, __ATOMIC_RELAXED);
+    Record&  r   = g_ring[idx & (RING_SIZE - 1)];
+
+    __atomic_store_n(&r.seq, 0u, __ATOMIC_RELAXED);
+    r.ts  = t0;
+    r.dur = dur > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)dur;
+    r.a0  = a0;
+    r.a1  = a1;
+    r.id  = id;
+    r.cpu = (uint8_t)smp::cpu_id();
+    r.tid = cur_tid();
+    __atomic_store_n(&r.seq, idx + 1u, __ATOMIC_RELEASE);
+}
+
+void enable(uint32_t m) {
+    __atomic_store_n(&g_mask, m & ALL, __ATOMIC_RELAXED);
+}
+
+uint32_t mask() { return g_mask; }
+
+void clear() {
+    uint32_t m = __atomic_exchange_n(&g_mask, 0u, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < RING_SIZE; ++i)
+        __atomic_store_n(&g_ring[i].seq, 0u, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_head, 0u, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_mask, m, __ATOMIC_RELEASE);
+}
+
+uint32_t recorded() {
+    uint32_t h = __atomic_load_n(&g_head, __ATOMIC_RELAXED);
+    return h < RING_SIZE ? h : RING_SIZE;
+}
+
+uint32_t capacity() { return RING_SIZE; }
+
+const char* name(Id id) {
+    return id < COUNT ? k_desc[id].name : "?";
+}
+
+int dump_json(const char* path) {
+    uint32_t m     = __atomic_exchange_n(&g_mask, 0u, __ATOMIC_ACQ_REL);
+    uint32_t head  = __atomic_load_n(&g_head, __ATOMIC_ACQUIRE);
+    uint32_t n     = head < RING_SIZE ? head : RING_SIZE;
+    uint64_t freq  = read_cntfrq_el0();
+    if (!freq) freq = 1;
+
+    uint32_t threads = 0;
+    for (sched::Thread* t = sched::first(); t; t = t->all_next) ++threads;
+
+    size_t cap = 256u + (size_t)(threads + smp::MAX_CPUS * 2u) * 96u + (size_t)n * 192u;
+    Json j{ static_cast<char*>(kheap::alloc(cap, 1)), 0, cap, 0 };
+    if (!j.buf) { __atomic_store_n(&g_mask, m, __ATOMIC_RELEASE); return -1; }
+
+    j.put("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    char pname[8] = { 'c', 'p', 'u', '0', '\0' };
+    for (uint32_t c = 0; c < smp::online(); ++c) {
+        pname[3] = (char)('0' + c);
+        j.meta("process_name", c, 0, pname);
+        if (c) j.meta("thread_name", c, 0, "pool");
+    }
+    j.meta("thread_name", 0, 0, "irq");
+    for (sched::Thread* t = sched::first(); t; t = t->all_next)
+        j.meta("thread_name", 0, t->id + 1u, t->name ? t->name : "?");
+
+    for (uint32_t i = head - n; i != head; ++i) {
+        const Record& r = g_ring[i & (RING_SIZE - 1)];
+        if (__atomic_load_n(&r.seq, __ATOMIC_ACQUIRE) != i + 1u || r.id >= COUNT) continue;
+        const Desc& d = k_desc[r.id];
+
+        if (j.written++) j.put(",\n");
+        j.put("{\"ph\":\"X\",\"name\":");
+        j.str(d.a0_is_name && r.a0 ? reinterpret_cast<const char*>(r.a0) : d.name);
+        j.put(",\"cat\":"); j.str(d.cat);
+        j.put(",\"pid\":"); j.dec(r.cpu);
+        j.put(",\"tid\":"); j.dec(r.tid);
+        j.put(",\"ts\":");  j.us(r.ts, freq);
+        j.put(",\"dur\":"); j.us(r.dur, freq);
+        j.put(",\"args\":{");
+        if (d.a0 && !d.a0_is_name) { j.str(d.a0); j.put(":"); j.dec(r.a0); }
+        if (d.a1) { j.put(","); j.str(d.a1); j.put(":"); j.dec(r.a1); }
+        j.put("}}");
+    }
+    j.put("\n]}\n");
+
+    int rc = j.len < j.cap ? vfs::write(path, j.buf, j.len) : -1;
+    kheap::free(j.buf);
+    __atomic_store_n(&g_mask, m, __ATOMIC_RELEASE);
+    return rc;
+}
+
+}
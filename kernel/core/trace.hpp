@@ -0,0 +1,92 @@
+/*
+  trace.hpp - kernel tracepoints recorded into a binary flight-recorder ring
+  every tracepoint is an Id below with a static descriptor in trace.cpp;
+  recording one is a mask test when it is off, and compiles away entirely
+  when the kernel is built with TRACE_OFF (make TRACE=0)
+  TRACE_SCOPE(id, a0, a1) records one complete event covering the rest of
+  the block; begin()/end() do the same for spans that are not a block
+  records are fixed 32-byte entries (cntpct start, duration, id, cpu,
+  thread, two args) in a lock-free ring that overwrites the oldest entry
+  dump_json() writes the ring as chrome trace-event json for a trace viewer
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "arch/aarch64/regs.hpp"
+
+namespace trace {
+
+enum Id : uint8_t {
+    IRQ,
+    WM_RENDER,
+    WM_RENDER_DIRTY,
+    VGPU_SEND,
+    VBLK_READ,
+    VBLK_WRITE,
+    APP_TICK,
+    COUNT
+};
+
+static constexpr uint32_t ALL = (1u << COUNT) - 1u;
+
+struct Record {
+    uint64_t ts;
+    uint64_t a0;
+    uint32_t dur;
+    uint32_t seq;
+    uint32_t a1;
+    uint16_t tid;
+    uint8_t  id;
+    uint8_t  cpu;
+};
+
+static_assert(sizeof(Record) == 32, "trace::Record must stay 32 bytes");
+
+extern uint32_t g_mask;
+
+static inline bool on(Id id) {
+#ifdef TRACE_OFF
+    (void)id;
+    return false;
+#else
+    return __builtin_expect((__atomic_load_n(&g_mask, __ATOMIC_RELAXED) >> id) & 1u, 0);
+#endif
+}
+
+static inline uint64_t begin(Id id) {
+    return on(id) ? read_cntpct_el0() : 0;
+}
+
+void emit(Id id, uint64_t t0, uint64_t a0, uint32_t a1);
+
+static inline void end(Id id, uint64_t t0, uint64_t a0 = 0, uint32_t a1 = 0) {
+    if (t0) emit(id, t0, a0, a1);
+}
+
+class Scope {
+public:
+    Scope(Id id, uint64_t a0 = 0, uint32_t a1 = 0)
+        : _t0(begin(id)), _a0(a0), _a1(a1), _id(id) {}
+    ~Scope() { end(_id, _t0, _a0, _a1); }
+
+private:
+    uint64_t _t0;
+    uint64_t _a0;
+    uint32_t _a1;
+    Id       _id;
+};
+
+void     enable(uint32_t mask);
+uint32_t mask();
+void     clear();
+uint32_t recorded();
+uint32_t capacity();
+const char* name(Id id);
+
+int dump_json(const char* path);
+
+}
+
+#define TRACE_CAT2(a, b) a##b
+#define TRACE_CAT(a, b)  TRACE_CAT2(a, b)
+#define TRACE_SCOPE(...) trace::Scope TRACE_CAT(_trace_scope_, __LINE__)(__VA_ARGS__)
@@ -1,14 +1,26 @@
 /*
-  uart_pl011.cpp - pl011 uart driver for the qemu virt board (0x09000000)
-  115200 8n1, polled (no interrupts)
-  putc spins on tx fifo full, getc returns -1 if rx fifo is empty
+  uart_pl011.cpp - pl011 uart driver for the qemu virt board (0x09000000, spi 1)
+  115200 8n1. polled until init_irq(), then interrupt-driven:
+  putc appends to a tx ring and tops up the hardware fifo straight away, so
+  a caller only ever waits when the ring itself is full; the tx interrupt
+  is unmasked only while the ring holds bytes the fifo had no room for,
+  and the handler keeps topping the fifo up. rx and rx-timeout interrupts
+  empty the fifo into an spsc ring that getc pops
+  the tx ring is shared by every cpu and by irq handlers that printk, so it
+  is guarded by a spinlock taken with irqs masked; flush_sync ignores the
+  lock because the cpu that panicked may be holding it
 */
 #include "kernel/drivers/uart_pl011.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/irq/work.hpp"
+#include "kernel/core/spsc.hpp"
+#include "arch/aarch64/regs.hpp"
 #include <stdint.h>
 
 namespace uart {
 
 static constexpr uintptr_t BASE = 0x09000000;
+static constexpr uint32_t  IRQ  = 33;
 
 static constexpr uint32_t DR    = 0x000;
 static constexpr uint32_t FR    = 0x018;
@@ -17,6 +29,7 @@ static constexpr uint32_t FBRD  = 0x028;
 static constexpr uint32_t LCRH  = 0x02C;
 static constexpr uint32_t CR    = 0x030;
 static constexpr uint32_t IMSC  = 0x038;
+static constexpr uint32_t MIS   = 0x040;
 static constexpr uint32_t ICR   = 0x044;
 
 static constexpr uint32_t FR_RXFE = (1u << 4);
@@ -30,10 +43,77 @@ static constexpr uint32_t CR_UARTEN = (1u << 0);
 static constexpr uint32_t CR_TXE    = (1u << 8);
 static constexpr uint32_t CR_RXE    = (1u << 9);
 
+static constexpr uint32_t INT_RX = (1u << 4);
+static constexpr uint32_t INT_TX = (1u << 5);
+static constexpr uint32_t INT_RT = (1u << 6);
+
+static constexpr uint32_t TX_SIZE = 4096;
+
+static char              g_tx[TX_SIZE];
+static uint32_t          g_tx_head = 0;
+static uint32_t          g_tx_tail = 0;
+static uint32_t          g_tx_lock = 0;
+static uint32_t          g_imsc    = 0;
+static bool              g_irq     = false;
+static volatile bool     g_sync    = false;
+static SpscRing<char, 256> g_rx;
+static void (*g_notify)() = nullptr;
+
 static inline volatile uint32_t* reg(uint32_t off) {
     return reinterpret_cast<volatile uint32_t*>(BASE + off);
 }
 
+static inline void poll_putc(char c) {
+    while (*reg(FR) & FR_TXFF) {}
+    *reg(DR) = static_cast<uint32_t>(c);
+}
+
+static uint64_t tx_lock() {
+    uint64_t flags = irq_save();
+    while (__atomic_exchange_n(&g_tx_lock, 1u, __ATOMIC_ACQUIRE)) {}
+    return flags;
+}
+
+static void tx_unlock(uint64_t flags) {
+    __atomic_store_n(&g_tx_lock, 0u, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+static void tx_fill() {
+    while (g_tx_tail != g_tx_head && !(*reg(FR) & FR_TXFF))
+        *reg(DR) = static_cast<uint32_t>(g_tx[g_tx_tail++ & (TX_SIZE - 1)]);
+
+    uint32_t imsc = g_tx_tail != g_tx_head ? (g_imsc | INT_TX) : (g_imsc & ~INT_TX);
+    if (imsc != g_imsc) {
+        g_imsc = imsc;
+        *reg(IMSC) = imsc;
+    }
+}
+
+static void on_work(void*) {
+    if (g_notify && !g_rx.empty()) g_notify();
+}
+
+static work::Item g_work{ on_work, nullptr, work::Level::High };
+
+static void on_irq() {
+    uint32_t mis = *reg(MIS);
+
+    if (mis & (INT_RX | INT_RT)) {
+        while (!(*reg(FR) & FR_RXFE))
+            g_rx.push(static_cast<char>(*reg(DR) & 0xFF));
+        *reg(ICR) = INT_RX | INT_RT;
+        work::queue(g_work);
+    }
+
+    if (mis & INT_TX) {
+        uint64_t flags = tx_lock();
+        *reg(ICR) = INT_TX;
+        tx_fill();
+        tx_unlock(flags);
+    }
+}
+
 void init() {
 
     *reg(CR) = 0;
@@ -54,16 +134,57 @@ void init() {
     *reg(CR) = CR_UARTEN | CR_TXE | CR_RXE;
 }
 
+void init_irq() {
+    gic::register_handler(IRQ, on_irq);
+    gic::set_priority(IRQ, gic::PRIO_INPUT);
+
+    uint64_t flags = irq_save();
+    *reg(ICR)  = 0x7FF;
+    g_imsc     = INT_RX | INT_RT;
+    *reg(IMSC) = g_imsc;
+    g_irq      = true;
+    irq_restore(flags);
+
+    gic::enable_irq(IRQ);
+}
+
 void putc(char c) {
 
-    while (*reg(FR) & FR_TXFF) {}
-    *reg(DR) = static_cast<uint32_t>(c);
+    if (!g_irq || g_sync) { poll_putc(c); return; }
+
+    uint64_t flags = tx_lock();
+    while (g_tx_head - g_tx_tail == TX_SIZE) {
+        while (*reg(FR) & FR_TXFF) {}
+        tx_fill();
+    }
+    g_tx[g_tx_head++ & (TX_SIZE - 1)] = c;
+    tx_fill();
+    tx_unlock(flags);
 }
 
 int getc() {
 
-    if (*reg(FR) & FR_RXFE) return -1;
-    return static_cast<int>(*reg(DR) & 0xFF);
+    if (!g_irq) {
+        if (*reg(FR) & FR_RXFE) return -1;
+        return static_cast<int>(*reg(DR) & 0xFF);
+    }
+    char c;
+    return g_rx.pop(c) ? static_cast<int>(static_cast<uint8_t>(c)) : -1;
+}
+
+bool pending() {
+    return g_irq ? !g_rx.empty() : !(*reg(FR) & FR_RXFE);
+}
+
+void set_notify(void (*fn)()) { g_notify = fn; }
+
+void flush_sync() {
+    g_sync = true;
+    if (!g_irq) return;
+
+    *reg(IMSC) = 0;
+    while (g_tx_tail != g_tx_head)
+        poll_putc(g_tx[g_tx_tail++ & (TX_SIZE - 1)]);
 }
 
 }
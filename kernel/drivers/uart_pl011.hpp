@@ -1,6 +1,12 @@
 /*
   uart_pl011.hpp - pl011 uart interface
-  init() sets up 115200 8n1, putc() sends a char, getc() returns -1 if nothing waiting
+  init() sets up 115200 8n1 polled, which is all early boot needs
+  init_irq() switches to interrupt-driven i/o once the gic and timer are up:
+  putc() queues into a tx ring and returns, getc() pops from an rx ring
+  filled by the irq and returns -1 if nothing is waiting
+  set_notify() installs a callback run from softirq after input arrives
+  flush_sync() is for panic: it drains the tx ring by polling and leaves
+  the uart polled from then on
 */
 #pragma once
 #include <stdint.h>
@@ -9,7 +15,15 @@ namespace uart {
 
   void init();
 
+  void init_irq();
+
   void putc(char c);
 
   int  getc();
+
+  bool pending();
+
+  void set_notify(void (*fn)());
+
+  void flush_sync();
 }
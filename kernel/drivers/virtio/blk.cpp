@@ -1,13 +1,26 @@
 /*
   blk.cpp - virtio-blk block device driver
-  synchronous polling 512-byte sector read and write
-  one request in flight at a time, no interrupt needed
+  512-byte sector read and write, completed from softirq work queued by the
+  virtio irq
+  every request owns a header/status slot indexed by its head descriptor,
+  so several can be in flight at once. read_sectors/write_sectors sleep the
+  calling thread until the irq marks the slot done; read_async/write_async
+  are coroutines that await the slot's event instead
+  a missed interrupt cannot strand a request: threads wait with a timeout
+  and harvest themselves, and while anything is in flight a watchdog timer
+  queues a harvest every WATCHDOG_NS for the coroutine waiters
 */
 #include "kernel/drivers/virtio/blk.hpp"
 #include "kernel/drivers/virtio/virtio_mmio.hpp"
 #include "kernel/drivers/virtio/virtqueue.hpp"
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/sched/sched.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/irq/work.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/core/trace.hpp"
+#include "kernel/core/cpustat.hpp"
 #include "arch/aarch64/regs.hpp"
 #include <string.h>
 #include <stdint.h>
@@ -18,6 +31,8 @@ static constexpr uint32_t BLK_T_OUT = 1;
 static constexpr uint8_t  BLK_S_OK    = 0;
 static constexpr uint8_t  BLK_S_IOERR [[maybe_unused]] = 1;
 
+static constexpr uint64_t WATCHDOG_NS = 50000000ull;
+
 struct BlkReqHdr {
     uint32_t type;
     uint32_t reserved;
@@ -28,11 +43,11 @@ namespace {
 
 static uintptr_t          g_base    = 0;
 static bool               g_ready   = false;
+static bool               g_packed  = false;
 static uint64_t           g_sectors = 0;
 static virtio::VirtQueue  g_queue;
-
-static BlkReqHdr s_hdr    __attribute__((aligned(16)));
-static uint8_t   s_status __attribute__((aligned(4)));
+static uint32_t           g_inflight = 0;
+static int                g_watchdog = -1;
 
 static bool negotiate(uintptr_t base) {
     using namespace virtio;
@@ -54,6 +69,7 @@ static bool negotiate(uintptr_t base) {
 
     write32(base, DeviceFeaturesSel, 1); dsb_sy();
     uint32_t f1 = read32(base, DeviceFeatures);
+    g_packed = (f1 & VIRTIO_F_RING_PACKED) != 0;
     write32(base, DriverFeaturesSel, 1); dsb_sy();
     write32(base, DriverFeatures, f1 | VIRTIO_F_VERSION_1); dsb_sy();
 
@@ -65,8 +81,138 @@ static bool negotiate(uintptr_t base) {
     return true;
 }
 
-static void wait_used() {
-    while (!g_queue.poll_used()) { asm volatile("nop"); }
+struct Request {
+    BlkReqHdr        hdr __attribute__((aligned(16)));
+    uint8_t          status;
+    volatile bool    done;
+    uint16_t         d1;
+    uint16_t         d2;
+    uint32_t         count;
+    uint64_t         trace_t0;
+    sched::WaitQueue wq;
+    co::Event        ev;
+};
+
+static Request g_reqs[virtio::QUEUE_SIZE];
+
+static void harvest() {
+    uint16_t id;
+    uint32_t len;
+    while (g_queue.pop_used(id, len)) {
+        if (id >= virtio::QUEUE_SIZE) continue;
+        Request& r = g_reqs[id];
+        trace::end(r.hdr.type == BLK_T_IN ? trace::VBLK_READ : trace::VBLK_WRITE,
+                   r.trace_t0, r.hdr.sector, r.count);
+        r.done = true;
+        if (g_inflight) --g_inflight;
+        cpustat::io_end();
+        r.ev.set();
+        sched::wake_all(r.wq);
+    }
+}
+
+static void on_work(void*) {
+    uint64_t flags = irq_save();
+    harvest();
+    irq_restore(flags);
+}
+
+static work::Item g_work{ on_work, nullptr, work::Level::Normal };
+
+static void on_irq() {
+    uint32_t isr = virtio::read32(g_base, virtio::InterruptStatus);
+    if (isr) virtio::write32(g_base, virtio::InterruptACK, isr);
+    dsb_sy();
+    work::queue(g_work);
+}
+
+static void arm_watchdog();
+
+static void on_watchdog(void*) {
+    g_watchdog = -1;
+    if (!g_inflight) return;
+    work::queue(g_work);
+    arm_watchdog();
+}
+
+static void arm_watchdog() {
+    if (g_watchdog < 0)
+        g_watchdog = timer::add(timer::now_ns() + WATCHDOG_NS, on_watchdog);
+}
+
+static int submit(uint32_t type, uint64_t lba, uint32_t count, const void* buf) {
+    uint64_t flags = irq_save();
+
+    uint16_t d0 = g_queue.alloc_desc();
+    uint16_t d1 = g_queue.alloc_desc();
+    uint16_t d2 = g_queue.alloc_desc();
+    if (d0 == 0xFFFF || d1 == 0xFFFF || d2 == 0xFFFF) {
+        if (d2 != 0xFFFF) g_queue.free_desc(d2);
+        if (d1 != 0xFFFF) g_queue.free_desc(d1);
+        if (d0 != 0xFFFF) g_queue.free_desc(d0);
+        irq_restore(flags);
+        return -1;
+    }
+
+    Request& r    = g_reqs[d0];
+    r.hdr.type     = type;
+    r.hdr.reserved = 0;
+    r.hdr.sector   = lba;
+    r.status       = 0xFF;
+    r.done         = false;
+    r.d1           = d1;
+    r.d2           = d2;
+    r.count        = count;
+    r.trace_t0     = trace::begin(type == BLK_T_IN ? trace::VBLK_READ : trace::VBLK_WRITE);
+    r.ev.reset();
+    dsb_sy();
+
+    g_queue.fill_desc(d0, virtio::VirtQueue::phys(&r.hdr),    sizeof(BlkReqHdr), false, true,  d1);
+    g_queue.fill_desc(d1, virtio::VirtQueue::phys(buf),       count * 512u,       type == BLK_T_IN, true, d2);
+    g_queue.fill_desc(d2, virtio::VirtQueue::phys(&r.status), 1u,                 true,  false, 0);
+    dsb_sy();
+
+    cpustat::io_begin();
+    g_queue.add_bytes((uint64_t)count * 512u);
+    g_queue.submit(d0, g_base, 0);
+    ++g_inflight;
+    arm_watchdog();
+    irq_restore(flags);
+    return d0;
+}
+
+static bool finish(int head) {
+    Request& r = g_reqs[head];
+    uint64_t flags = irq_save();
+    dsb_sy();
+    uint8_t status = r.status;
+    g_queue.free_desc(r.d2);
+    g_queue.free_desc(r.d1);
+    g_queue.free_desc((uint16_t)head);
+    irq_restore(flags);
+    return status == BLK_S_OK;
+}
+
+static bool transfer(uint32_t type, uint64_t lba, uint32_t count, const void* buf) {
+    int h;
+    while ((h = submit(type, lba, count, buf)) < 0) sched::yield();
+
+    Request& r = g_reqs[h];
+    uint64_t flags = irq_save();
+    while (!r.done) {
+        if (!sched::started() ||
+            !sched::wait_until(r.wq, timer::now_ns() + WATCHDOG_NS))
+            harvest();
+    }
+    irq_restore(flags);
+    return finish(h);
+}
+
+static co::Task<bool> transfer_async(uint32_t type, uint64_t lba, uint32_t count, const void* buf) {
+    int h;
+    while ((h = submit(type, lba, count, buf)) < 0) co_await co::yield();
+    co_await g_reqs[h].ev;
+    co_return finish(h);
 }
 
 }
@@ -85,7 +231,7 @@ bool init(const uintptr_t* bases, int n) {
             continue;
         }
 
-        if (!g_queue.init(base, 0)) {
+        if (!g_queue.init(base, 0, QUEUE_SIZE, g_packed, "blk")) {
             print("vblk: queue 0 init failed\n");
             continue;
         }
@@ -107,9 +253,15 @@ bool init(const uintptr_t* bases, int n) {
         g_base  = base;
         g_ready = true;
 
-        printk("vblk: found at 0x%x  capacity=%u MiB\n",
+        uint32_t irq = irq_for(base);
+        gic::register_handler(irq, on_irq);
+        gic::set_priority(irq, gic::PRIO_BLOCK);
+        gic::enable_irq(irq);
+
+        printk("vblk: found at 0x%x  capacity=%u MiB  ring=%s\n",
                (unsigned)base,
-               (unsigned)(g_sectors / 2048));
+               (unsigned)(g_sectors / 2048),
+               g_packed ? "packed" : "split");
         return true;
     }
     return false;
@@ -117,65 +269,26 @@ bool init(const uintptr_t* bases, int n) {
 
 bool     ready()        { return g_ready;   }
 uint64_t sector_count() { return g_sectors; }
+bool     ring_packed()  { return g_packed;  }
 
 bool read_sectors(uint64_t lba, uint32_t count, void* buf) {
     if (!g_ready || !buf || count == 0) return false;
-
-    s_hdr.type     = BLK_T_IN;
-    s_hdr.reserved = 0;
-    s_hdr.sector   = lba;
-    s_status       = 0xFF;
-    dsb_sy();
-
-    uint16_t d0 = g_queue.alloc_desc();
-    uint16_t d1 = g_queue.alloc_desc();
-    uint16_t d2 = g_queue.alloc_desc();
-    if (d0 == 0xFFFF || d1 == 0xFFFF || d2 == 0xFFFF) return false;
-
-    g_queue.fill_desc(d0, virtio::VirtQueue::phys(&s_hdr),   sizeof(BlkReqHdr), false, true,  d1);
-    g_queue.fill_desc(d1, virtio::VirtQueue::phys(buf),      count * 512u,       true,  true,  d2);
-    g_queue.fill_desc(d2, virtio::VirtQueue::phys(&s_status),1u,                 true,  false, 0);
-    dsb_sy();
-
-    g_queue.submit(d0, g_base, 0);
-    wait_used();
-
-    g_queue.free_desc(d2);
-    g_queue.free_desc(d1);
-    g_queue.free_desc(d0);
-    dsb_sy();
-
-    return (s_status == BLK_S_OK);
+    return transfer(BLK_T_IN, lba, count, buf);
 }
 
 bool write_sectors(uint64_t lba, uint32_t count, const void* buf) {
     if (!g_ready || !buf || count == 0) return false;
+    return transfer(BLK_T_OUT, lba, count, buf);
+}
 
-    s_hdr.type     = BLK_T_OUT;
-    s_hdr.reserved = 0;
-    s_hdr.sector   = lba;
-    s_status       = 0xFF;
-    dsb_sy();
-
-    uint16_t d0 = g_queue.alloc_desc();
-    uint16_t d1 = g_queue.alloc_desc();
-    uint16_t d2 = g_queue.alloc_desc();
-    if (d0 == 0xFFFF || d1 == 0xFFFF || d2 == 0xFFFF) return false;
-
-    g_queue.fill_desc(d0, virtio::VirtQueue::phys(&s_hdr),   sizeof(BlkReqHdr), false, true,  d1);
-    g_queue.fill_desc(d1, virtio::VirtQueue::phys(buf),      count * 512u,       false, true,  d2);
-    g_queue.fill_desc(d2, virtio::VirtQueue::phys(&s_status),1u,                 true,  false, 0);
-    dsb_sy();
-
-    g_queue.submit(d0, g_base, 0);
-    wait_used();
-
-    g_queue.free_desc(d2);
-    g_queue.free_desc(d1);
-    g_queue.free_desc(d0);
-    dsb_sy();
+co::Task<bool> read_async(uint64_t lba, uint32_t count, void* buf) {
+    if (!g_ready || !buf || count == 0) co_return false;
+    co_return co_await transfer_async(BLK_T_IN, lba, count, buf);
+}
 
-    return (s_status == BLK_S_OK);
+co::Task<bool> write_async(uint64_t lba, uint32_t count, const void* buf) {
+    if (!g_ready || !buf || count == 0) co_return false;
+    co_return co_await transfer_async(BLK_T_OUT, lba, count, buf);
 }
 
 }
@@ -1,10 +1,13 @@
 /*
   blk.hpp - virtio-blk driver interface
   init/ready/sector_count/read_sectors/write_sectors
+  ring_packed() reports whether VIRTIO_F_RING_PACKED was negotiated
+  read_async/write_async are the coroutine forms, for use from co::Task code
 */
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
+#include "kernel/core/co.hpp"
 
 namespace vblk {
 
@@ -14,8 +17,14 @@ bool     ready        ();
 
 uint64_t sector_count ();
 
+bool     ring_packed  ();
+
 bool read_sectors (uint64_t lba, uint32_t count, void*       buf);
 
 bool write_sectors(uint64_t lba, uint32_t count, const void* buf);
 
+co::Task<bool> read_async (uint64_t lba, uint32_t count, void*       buf);
+
+co::Task<bool> write_async(uint64_t lba, uint32_t count, const void* buf);
+
 }
@@ -10,6 +10,9 @@
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/panic.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/core/trace.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/core/cpustat.hpp"
 #include "arch/aarch64/regs.hpp"
 #include <string.h>
 #include <stdint.h>
@@ -104,6 +107,7 @@ static uint32_t*         g_fb      = nullptr;
 static uint32_t          g_width   = 0;
 static uint32_t          g_height  = 0;
 static bool              g_ready   = false;
+static bool              g_packed  = false;
 
 static VgpuCtrlHdr          s_cmd_hdr      __attribute__((aligned(16)));
 static VgpuCtrlHdr          s_rsp_hdr      __attribute__((aligned(16)));
@@ -115,15 +119,21 @@ static VgpuTransferToHost2D s_cmd_transfer __attribute__((aligned(16)));
 static VgpuResourceFlush    s_cmd_flush    __attribute__((aligned(16)));
 
 static void wait_used() {
+    cpustat::Scope cs(cpustat::GPU_WAIT);
     for (int i = 0; i < 10'000'000; ++i) {
         dsb_sy();
-        if (g_ctrlq.poll_used()) return;
+        if (g_ctrlq.poll_used()) {
+            g_ctrlq.add_spins((uint64_t)i);
+            return;
+        }
     }
     panic("vgpu: command timeout");
 }
 
 static void send(const void* cmd, uint32_t cmd_len,
                  void*       rsp, uint32_t rsp_len) {
+    TRACE_SCOPE(trace::VGPU_SEND, static_cast<const VgpuCtrlHdr*>(cmd)->type);
+
     uint16_t d0 = g_ctrlq.alloc_desc();
     uint16_t d1 = g_ctrlq.alloc_desc();
     if (d0 == 0xFFFF || d1 == 0xFFFF) panic("vgpu: out of descriptors");
@@ -163,6 +173,7 @@ static bool negotiate(uintptr_t base) {
     write32(base, DeviceFeaturesSel, 1);
     dsb_sy();
     uint32_t feats1 = read32(base, DeviceFeatures);
+    g_packed = (feats1 & VIRTIO_F_RING_PACKED) != 0;
     write32(base, DriverFeaturesSel, 1);
     write32(base, DriverFeatures, feats1 | VIRTIO_F_VERSION_1);
     dsb_sy();
@@ -204,7 +215,7 @@ bool init(const uintptr_t* bases, int n_bases) {
 
     if (!negotiate(base)) return false;
 
-    if (!g_ctrlq.init(base, 0)) {
+    if (!g_ctrlq.init(base, 0, QUEUE_SIZE, g_packed, "gpu")) {
         print("vgpu: controlq init failed\n");
         return false;
     }
@@ -234,7 +245,8 @@ bool init(const uintptr_t* bases, int n_bases) {
             }
         }
         if (!g_width || !g_height) { g_width = 1024; g_height = 768; }
-        printk("vgpu: display %u x %u\n", g_width, g_height);
+        printk("vgpu: display %u x %u  ring=%s\n", g_width, g_height,
+               g_packed ? "packed" : "split");
     }
 
     uint32_t fb_bytes = g_width * g_height * 4u;
@@ -296,11 +308,13 @@ uint32_t* framebuffer() { return g_fb;     }
 uint32_t  width()       { return g_width;  }
 uint32_t  height()      { return g_height; }
 bool      ready()       { return g_ready;  }
+bool      ring_packed() { return g_packed; }
 
 void flush_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
     if (!g_ready) return;
 
     {
+        framestat::Scope fs(framestat::TRANSFER);
         memset(&s_cmd_transfer, 0, sizeof(s_cmd_transfer));
         memset(&s_rsp_hdr,      0, sizeof(s_rsp_hdr));
         s_cmd_transfer.hdr.type    = VCMD_TRANSFER_TO_HOST_2D;
@@ -309,8 +323,11 @@ void flush_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
         s_cmd_transfer.resource_id = 1;
         send(&s_cmd_transfer, sizeof(s_cmd_transfer), &s_rsp_hdr, sizeof(s_rsp_hdr));
     }
+    framestat::add_bytes((uint64_t)w * h * 4u);
+    g_ctrlq.add_bytes((uint64_t)w * h * 4u);
 
     {
+        framestat::Scope fs(framestat::FLUSH);
         memset(&s_cmd_flush, 0, sizeof(s_cmd_flush));
         memset(&s_rsp_hdr,   0, sizeof(s_rsp_hdr));
         s_cmd_flush.hdr.type    = VCMD_RESOURCE_FLUSH;
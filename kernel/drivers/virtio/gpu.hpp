@@ -26,4 +26,6 @@ void flush_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
 
 bool ready();
 
+bool ring_packed();
+
 }
@@ -1,17 +1,21 @@
 /*
   input.cpp - virtio-input keyboard driver
   finds the keyboard device, fills the avail ring with event buffers,
-  harvests key-press events each poll(), decodes them to ascii via scan.hpp,
-  and pushes characters into a small ring buffer
+  acks the virtio irq and harvests key-press events in softirq work, decodes
+  them to ascii via scan.hpp, and pushes timestamped key events into a
+  lock-free spsc queue
+  every harvested buffer is reposted in one batch with a single notify
 */
 #include "kernel/drivers/virtio/input.hpp"
 #include "kernel/drivers/virtio/virtio_mmio.hpp"
 #include "kernel/drivers/virtio/virtqueue.hpp"
 #include "kernel/drivers/virtio/scan.hpp"
 #include "kernel/irq/gic.hpp"
+#include "kernel/irq/work.hpp"
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/panic.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/core/spsc.hpp"
 #include "arch/aarch64/regs.hpp"
 #include <string.h>
 #include <stdint.h>
@@ -26,23 +30,13 @@ static constexpr uint16_t EV_KEY  = 0x01;
 static constexpr uint16_t EV_ABS  = 0x03;
 
 static constexpr uint32_t KBUF_SIZE = 256;
-static char     g_kbuf[KBUF_SIZE];
-static uint32_t g_kbuf_head = 0;
-static uint32_t g_kbuf_tail = 0;
-
-static void kbuf_push(char c) {
-    uint32_t next = (g_kbuf_head + 1) & (KBUF_SIZE - 1);
-    if (next != g_kbuf_tail) {
-        g_kbuf[g_kbuf_head] = c;
-        g_kbuf_head = next;
-    }
-}
+static SpscRing<kbd::KeyEvent, KBUF_SIZE> g_kq;
 
-static char kbuf_pop() {
-    if (g_kbuf_head == g_kbuf_tail) return 0;
-    char c = g_kbuf[g_kbuf_tail];
-    g_kbuf_tail = (g_kbuf_tail + 1) & (KBUF_SIZE - 1);
-    return c;
+static void kq_push(char c) {
+    kbd::KeyEvent ev;
+    ev.ts = read_cntpct_el0();
+    ev.ch = c;
+    g_kq.push(ev);
 }
 
 namespace {
@@ -51,6 +45,7 @@ static uintptr_t          g_base   = 0;
 static virtio::VirtQueue  g_evtq;
 static VirtInputEvent*    g_evbufs = nullptr;
 static bool               g_ready  = false;
+static bool               g_packed = false;
 
 static bool g_shift = false;
 static bool g_caps  = false;
@@ -80,6 +75,7 @@ static bool negotiate_input(uintptr_t base) {
     write32(base, DeviceFeaturesSel, 1);
     dsb_sy();
     uint32_t feats1 = read32(base, DeviceFeatures);
+    g_packed = (feats1 & VIRTIO_F_RING_PACKED) != 0;
     write32(base, DriverFeaturesSel, 1);
     write32(base, DriverFeatures, feats1 | VIRTIO_F_VERSION_1);
     dsb_sy();
@@ -98,23 +94,88 @@ static void prefill_evtq() {
     uint16_t n = g_evtq._num;
 
     g_evbufs = static_cast<VirtInputEvent*>(
-        kheap::alloc(sizeof(VirtInputEvent) * n, 16));
+        kheap::alloc(sizeof(VirtInputEvent) * n, 64));
     if (!g_evbufs) panic("kbd: evbuf alloc failed");
     memset(g_evbufs, 0, sizeof(VirtInputEvent) * n);
+    dc_civac_range(g_evbufs, sizeof(VirtInputEvent) * n);
 
     for (uint16_t i = 0; i < n; ++i) {
-        g_evtq.desc[i].addr  = VirtQueue::phys(&g_evbufs[i]);
-        g_evtq.desc[i].len   = sizeof(VirtInputEvent);
-        g_evtq.desc[i].flags = VRING_DESC_F_WRITE;
-        g_evtq.desc[i].next  = 0;
+        g_evtq.fill_desc(i, VirtQueue::phys(&g_evbufs[i]),
+                         sizeof(VirtInputEvent), true, false);
+        g_evtq.post(i);
+    }
+    g_evtq._free_head = 0xFFFF;
+    if (!g_evtq.is_packed())
+        dc_civac_range(g_evtq.desc, sizeof(VirtqDesc) * n);
+    g_evtq.kick(g_base, 0);
+}
+
+static void decode(const VirtInputEvent& ev) {
+    if (ev.type != EV_KEY) return;
+
+    uint16_t code = ev.code;
+    uint32_t val  = ev.value;
+
+    if (scan::is_shift(code)) {
+        g_shift = (val != 0);
+    } else if (scan::is_ctrl(code)) {
+        g_ctrl = (val != 0);
+    } else if (code == scan::KEY_CAPSLOCK && val == 1) {
+        g_caps = !g_caps;
+    } else if (val == 1 || val == 2) {
+
+        if      (code == scan::KEY_UP)       kq_push((char)0x80);
+        else if (code == scan::KEY_DOWN)     kq_push((char)0x81);
+        else if (code == scan::KEY_LEFT)     kq_push((char)0x82);
+        else if (code == scan::KEY_RIGHT)    kq_push((char)0x83);
+        else if (code == scan::KEY_HOME)     kq_push((char)0x84);
+        else if (code == scan::KEY_END)      kq_push((char)0x85);
+        else if (code == scan::KEY_PAGEUP)   kq_push((char)0x86);
+        else if (code == scan::KEY_PAGEDOWN) kq_push((char)0x87);
+        else if (code == scan::KEY_DELETE)   kq_push((char)0x88);
+        else {
+            char c = scan::to_ascii(code, g_shift, g_caps);
+            if (c) {
+
+                if (g_ctrl) {
+                    if      (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 1);
+                    else if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 1);
+                }
+                kq_push(c);
+            }
+        }
+    }
+}
 
-        g_evtq.avail->ring[i] = i;
+static void harvest() {
+    uint16_t id;
+    uint32_t len;
+    uint32_t reposted = 0;
+    while (g_evtq.pop_used(id, len)) {
+        if (id >= g_evtq._num) continue;
+        dc_ivac_range(&g_evbufs[id], sizeof(VirtInputEvent));
+        decode(g_evbufs[id]);
+        g_evtq.add_bytes(len);
+        g_evtq.post(id);
+        ++reposted;
     }
-    g_evtq.avail->idx = n;
-    dsb_sy();
+    if (reposted) g_evtq.kick(g_base, 0);
+}
+
+static void (*g_notify)() = nullptr;
+
+static void on_work(void*) {
+    harvest();
+    if (g_notify && !g_kq.empty()) g_notify();
+}
+
+static work::Item g_work{ on_work, nullptr, work::Level::High };
 
-    write32(g_base, virtio::QueueNotify, 0);
+static void on_irq() {
+    uint32_t isr = virtio::read32(g_base, virtio::InterruptStatus);
+    if (isr) virtio::write32(g_base, virtio::InterruptACK, isr);
     dsb_sy();
+    work::queue(g_work);
 }
 
 }
@@ -164,10 +225,11 @@ bool init(const uintptr_t* bases, int n_bases) {
         return false;
     }
 
-    if (!g_evtq.init(base, 0)) {
+    if (!g_evtq.init(base, 0, QUEUE_SIZE, g_packed, "kbd")) {
         print("kbd: eventq init failed\n");
         return false;
     }
+    g_evtq.set_timed(false);
 
     write32(base, Status,
             STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK | STATUS_DRIVER_OK);
@@ -180,15 +242,9 @@ bool init(const uintptr_t* bases, int n_bases) {
 
     prefill_evtq();
 
-    uint32_t slot = (uint32_t)((base - 0x0a000000u) / 0x200u);
-    uint32_t irq  = 32u + slot;
-    gic::register_handler(irq, [](){
-
-        uint32_t isr = read32(g_base, virtio::InterruptStatus);
-        if (isr) write32(g_base, virtio::InterruptACK, isr);
-        dsb_sy();
-
-    });
+    uint32_t irq = irq_for(base);
+    gic::register_handler(irq, on_irq);
+    gic::set_priority(irq, gic::PRIO_INPUT);
     gic::enable_irq(irq);
 
     g_ready = true;
@@ -199,74 +255,35 @@ bool init(const uintptr_t* bases, int n_bases) {
 void poll() {
     if (!g_ready) return;
 
-    dsb_sy();
-    uint32_t isr = read32(g_base, virtio::InterruptStatus);
-    if (isr) write32(g_base, virtio::InterruptACK, isr);
-    dsb_sy();
+    uint64_t flags = irq_save();
+    harvest();
+    irq_restore(flags);
+}
 
-    uint16_t used_idx = g_evtq.used->idx;
-    uint16_t last     = g_evtq._last_used;
-
-    while (last != used_idx) {
-        uint32_t desc_id = g_evtq.used->ring[last & (g_evtq._num - 1u)].id;
-        last++;
-
-        const VirtInputEvent& ev = g_evbufs[desc_id];
-
-        if (ev.type == EV_KEY) {
-            uint16_t code = ev.code;
-            uint32_t val  = ev.value;
-
-            if (scan::is_shift(code)) {
-                g_shift = (val != 0);
-            } else if (scan::is_ctrl(code)) {
-                g_ctrl = (val != 0);
-            } else if (code == scan::KEY_CAPSLOCK && val == 1) {
-                g_caps = !g_caps;
-            } else if (val == 1 || val == 2) {
-
-                if      (code == scan::KEY_UP)       kbuf_push((char)0x80);
-                else if (code == scan::KEY_DOWN)     kbuf_push((char)0x81);
-                else if (code == scan::KEY_LEFT)     kbuf_push((char)0x82);
-                else if (code == scan::KEY_RIGHT)    kbuf_push((char)0x83);
-                else if (code == scan::KEY_HOME)     kbuf_push((char)0x84);
-                else if (code == scan::KEY_END)      kbuf_push((char)0x85);
-                else if (code == scan::KEY_PAGEUP)   kbuf_push((char)0x86);
-                else if (code == scan::KEY_PAGEDOWN) kbuf_push((char)0x87);
-                else if (code == scan::KEY_DELETE)   kbuf_push((char)0x88);
-                else {
-                    char c = scan::to_ascii(code, g_shift, g_caps);
-                    if (c) {
-
-                        if (g_ctrl) {
-                            if      (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 1);
-                            else if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 1);
-                        }
-                        kbuf_push(c);
-                    }
-                }
-            }
-        }
+void set_notify(void (*fn)()) { g_notify = fn; }
 
-        uint16_t slot = g_evtq.avail->idx & (g_evtq._num - 1u);
-        g_evtq.avail->ring[slot] = (uint16_t)desc_id;
-        dsb_sy();
-        g_evtq.avail->idx++;
-        dsb_sy();
-        write32(g_base, virtio::QueueNotify, 0);
-    }
-    g_evtq._last_used = last;
+bool pending() {
+    return !g_kq.empty();
+}
+
+bool next_event(KeyEvent& ev) {
+    return g_kq.pop(ev);
 }
 
 char getc_nb() {
-    poll();
-    return kbuf_pop();
+    KeyEvent ev;
+    return g_kq.pop(ev) ? ev.ch : 0;
 }
 
 char getc() {
-    char c;
-    while (!(c = kbuf_pop())) poll();
-    return c;
+    KeyEvent ev;
+    while (!g_kq.pop(ev)) {
+        poll();
+        irq_disable();
+        if (g_kq.empty()) asm volatile("wfi");
+        irq_enable();
+    }
+    return ev.ch;
 }
 
 bool ready() { return g_ready; }
@@ -1,17 +1,31 @@
 /*
   input.hpp - virtio-input keyboard driver interface
   init/poll/getc_nb/getc/ready
-  also exposes special key byte constants (arrow keys, home/end etc)
+  keys are harvested in the virtio irq into a timestamped spsc queue;
+  next_event() pops one with its cntpct timestamp, pending() checks without popping
+  poll() harvests synchronously and is only needed when irqs are masked
+  set_notify() installs a callback run from the irq after keys are queued
 */
 #pragma once
 #include <stdint.h>
 
 namespace kbd {
 
+struct KeyEvent {
+    uint64_t ts;
+    char     ch;
+};
+
 bool init(const uintptr_t* bases, int n_bases);
 
 void poll();
 
+void set_notify(void (*fn)());
+
+bool pending();
+
+bool next_event(KeyEvent& ev);
+
 char getc_nb();
 
 char getc();
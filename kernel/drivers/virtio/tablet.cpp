@@ -2,14 +2,20 @@
   tablet.cpp - virtio-input tablet/mouse driver (absolute coordinates)
   probes ev_abs support to distinguish from keyboard device
   raw coordinates are in 0-0x7fff range, scaled to screen pixels
+  the virtio irq only acks, events are harvested in softirq work;
+  consecutive moves within a batch are coalesced into one pointer event,
+  flushed early only when a button changes, and pushed into a timestamped
+  spsc queue for the main loop
 */
 #include "kernel/drivers/virtio/tablet.hpp"
 #include "kernel/drivers/virtio/virtio_mmio.hpp"
 #include "kernel/drivers/virtio/virtqueue.hpp"
 #include "kernel/irq/gic.hpp"
+#include "kernel/irq/work.hpp"
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/panic.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/core/spsc.hpp"
 #include "arch/aarch64/regs.hpp"
 #include <string.h>
 #include <stdint.h>
@@ -35,18 +41,26 @@ static uintptr_t         g_base    = 0;
 static virtio::VirtQueue g_evtq;
 static TabInputEvent*    g_evbufs  = nullptr;
 static bool              g_ready   = false;
+static bool              g_packed  = false;
 
 static uint32_t g_scr_w = 1280;
 static uint32_t g_scr_h = 800;
 
-static int32_t g_raw_x  = 0;
-static int32_t g_raw_y  = 0;
 static int32_t g_pix_x  = 0;
 static int32_t g_pix_y  = 0;
 
 static bool g_btn_left  = false;
 static bool g_btn_right = false;
 
+static constexpr uint32_t TQ_SIZE = 128;
+static SpscRing<tablet::PointerEvent, TQ_SIZE> g_tq;
+
+static int32_t g_h_x     = 0;
+static int32_t g_h_y     = 0;
+static bool    g_h_left  = false;
+static bool    g_h_right = false;
+static bool    g_h_moved = false;
+
 static bool device_has_ev_abs(uintptr_t base) {
     volatile uint8_t* sel = virtio::cfg8(base, 0);
     volatile uint8_t* sub = virtio::cfg8(base, 1);
@@ -81,6 +95,7 @@ static bool negotiate_tablet(uintptr_t base) {
     write32(base, DeviceFeaturesSel, 1);
     dsb_sy();
     uint32_t f1 = read32(base, DeviceFeatures);
+    g_packed = (f1 & VIRTIO_F_RING_PACKED) != 0;
     write32(base, DriverFeaturesSel, 1);
     write32(base, DriverFeatures, f1 | VIRTIO_F_VERSION_1);
     dsb_sy();
@@ -99,22 +114,20 @@ static void prefill_evtq() {
     uint16_t n = g_evtq._num;
 
     g_evbufs = static_cast<TabInputEvent*>(
-        kheap::alloc(sizeof(TabInputEvent) * n, 16));
+        kheap::alloc(sizeof(TabInputEvent) * n, 64));
     if (!g_evbufs) panic("tablet: evbuf alloc failed");
     memset(g_evbufs, 0, sizeof(TabInputEvent) * n);
+    dc_civac_range(g_evbufs, sizeof(TabInputEvent) * n);
 
     for (uint16_t i = 0; i < n; ++i) {
-        g_evtq.desc[i].addr  = virtio::VirtQueue::phys(&g_evbufs[i]);
-        g_evtq.desc[i].len   = sizeof(TabInputEvent);
-        g_evtq.desc[i].flags = VRING_DESC_F_WRITE;
-        g_evtq.desc[i].next  = 0;
-        g_evtq.avail->ring[i] = i;
+        g_evtq.fill_desc(i, VirtQueue::phys(&g_evbufs[i]),
+                         sizeof(TabInputEvent), true, false);
+        g_evtq.post(i);
     }
-    g_evtq.avail->idx = n;
-    dsb_sy();
-
-    write32(g_base, virtio::QueueNotify, 0);
-    dsb_sy();
+    g_evtq._free_head = 0xFFFF;
+    if (!g_evtq.is_packed())
+        dc_civac_range(g_evtq.desc, sizeof(VirtqDesc) * n);
+    g_evtq.kick(g_base, 0);
 }
 
 static int32_t raw_to_pix(int32_t raw, uint32_t screen_dim) {
@@ -122,6 +135,64 @@ static int32_t raw_to_pix(int32_t raw, uint32_t screen_dim) {
     return (int32_t)((uint32_t)raw * screen_dim >> 15);
 }
 
+static void emit() {
+    tablet::PointerEvent ev;
+    ev.ts    = read_cntpct_el0();
+    ev.x     = raw_to_pix(g_h_x, g_scr_w);
+    ev.y     = raw_to_pix(g_h_y, g_scr_h);
+    ev.left  = g_h_left;
+    ev.right = g_h_right;
+    g_tq.push(ev);
+    g_h_moved = false;
+}
+
+static void decode(const TabInputEvent& ev) {
+    if (ev.type == TEV_ABS) {
+        if (ev.code == ABS_X) {
+            g_h_x = (int32_t)ev.value;
+            g_h_moved = true;
+        } else if (ev.code == ABS_Y) {
+            g_h_y = (int32_t)ev.value;
+            g_h_moved = true;
+        }
+    } else if (ev.type == TEV_KEY) {
+        if (ev.code == BTN_LEFT)  { g_h_left  = (ev.value != 0); emit(); }
+        if (ev.code == BTN_RIGHT) { g_h_right = (ev.value != 0); emit(); }
+    }
+}
+
+static void harvest() {
+    uint16_t id;
+    uint32_t len;
+    uint32_t reposted = 0;
+    while (g_evtq.pop_used(id, len)) {
+        if (id >= g_evtq._num) continue;
+        dc_ivac_range(&g_evbufs[id], sizeof(TabInputEvent));
+        decode(g_evbufs[id]);
+        g_evtq.add_bytes(len);
+        g_evtq.post(id);
+        ++reposted;
+    }
+    if (g_h_moved) emit();
+    if (reposted) g_evtq.kick(g_base, 0);
+}
+
+static void (*g_notify)() = nullptr;
+
+static void on_work(void*) {
+    harvest();
+    if (g_notify && !g_tq.empty()) g_notify();
+}
+
+static work::Item g_work{ on_work, nullptr, work::Level::High };
+
+static void on_irq() {
+    uint32_t isr = virtio::read32(g_base, virtio::InterruptStatus);
+    if (isr) virtio::write32(g_base, virtio::InterruptACK, isr);
+    dsb_sy();
+    work::queue(g_work);
+}
+
 }
 
 namespace tablet {
@@ -155,10 +226,11 @@ bool init(const uintptr_t* bases, int n_bases,
         return false;
     }
 
-    if (!g_evtq.init(base, 0)) {
+    if (!g_evtq.init(base, 0, QUEUE_SIZE, g_packed, "tablet")) {
         print("tablet: eventq init failed\n");
         return false;
     }
+    g_evtq.set_timed(false);
 
     write32(base, Status,
             STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK | STATUS_DRIVER_OK);
@@ -171,13 +243,9 @@ bool init(const uintptr_t* bases, int n_bases,
 
     prefill_evtq();
 
-    uint32_t slot = (uint32_t)((base - 0x0a000000u) / 0x200u);
-    uint32_t irq  = 32u + slot;
-    gic::register_handler(irq, [](){
-        uint32_t isr = virtio::read32(g_base, virtio::InterruptStatus);
-        if (isr) virtio::write32(g_base, virtio::InterruptACK, isr);
-        dsb_sy();
-    });
+    uint32_t irq = irq_for(base);
+    gic::register_handler(irq, on_irq);
+    gic::set_priority(irq, gic::PRIO_INPUT);
     gic::enable_irq(irq);
 
     g_ready = true;
@@ -188,41 +256,24 @@ bool init(const uintptr_t* bases, int n_bases,
 void poll() {
     if (!g_ready) return;
 
-    dsb_sy();
-    uint32_t isr = virtio::read32(g_base, virtio::InterruptStatus);
-    if (isr) virtio::write32(g_base, virtio::InterruptACK, isr);
-    dsb_sy();
+    uint64_t flags = irq_save();
+    harvest();
+    irq_restore(flags);
+}
 
-    uint16_t used_idx = g_evtq.used->idx;
-    uint16_t last     = g_evtq._last_used;
-
-    while (last != used_idx) {
-        uint32_t desc_id = g_evtq.used->ring[last & (g_evtq._num - 1u)].id;
-        ++last;
-
-        const TabInputEvent& ev = g_evbufs[desc_id];
-
-        if (ev.type == TEV_ABS) {
-            if (ev.code == ABS_X) {
-                g_raw_x = (int32_t)ev.value;
-                g_pix_x = raw_to_pix(g_raw_x, g_scr_w);
-            } else if (ev.code == ABS_Y) {
-                g_raw_y = (int32_t)ev.value;
-                g_pix_y = raw_to_pix(g_raw_y, g_scr_h);
-            }
-        } else if (ev.type == TEV_KEY) {
-            if (ev.code == BTN_LEFT)  g_btn_left  = (ev.value != 0);
-            if (ev.code == BTN_RIGHT) g_btn_right = (ev.value != 0);
-        }
+void set_notify(void (*fn)()) { g_notify = fn; }
 
-        uint16_t slot = g_evtq.avail->idx & (g_evtq._num - 1u);
-        g_evtq.avail->ring[slot] = (uint16_t)desc_id;
-        dsb_sy();
-        g_evtq.avail->idx++;
-        dsb_sy();
-        virtio::write32(g_base, virtio::QueueNotify, 0);
-    }
-    g_evtq._last_used = last;
+bool pending() {
+    return !g_tq.empty();
+}
+
+bool next_event(PointerEvent& ev) {
+    if (!g_tq.pop(ev)) return false;
+    g_pix_x     = ev.x;
+    g_pix_y     = ev.y;
+    g_btn_left  = ev.left;
+    g_btn_right = ev.right;
+    return true;
 }
 
 int32_t cx()         { return g_pix_x;     }
@@ -1,17 +1,34 @@
 /*
   tablet.hpp - virtio-tablet driver interface
   init/poll/cx/cy/btn_left/btn_right/ready
+  next_event() pops a coalesced, timestamped pointer event and updates the
+  state reported by cx/cy/btn_left/btn_right; pending() checks without popping
+  set_notify() installs a callback run from the irq after events are queued
 */
 #pragma once
 #include <stdint.h>
 
 namespace tablet {
 
+struct PointerEvent {
+    uint64_t ts;
+    int32_t  x;
+    int32_t  y;
+    bool     left;
+    bool     right;
+};
+
 bool init(const uintptr_t* bases, int n_bases,
           uint32_t screen_w, uint32_t screen_h);
 
 void poll();
 
+void set_notify(void (*fn)());
+
+bool pending();
+
+bool next_event(PointerEvent& ev);
+
 int32_t cx();
 int32_t cy();
 
@@ -0,0 +1,37 @@
+/*
+  virtio_mmio.cpp - interrupt line lookup for virtio-mmio devices
+  main records each device's intid from the device tree; a device with no
+  recorded line gets the qemu virt wiring, intid 48 + slot
+*/
+#include "kernel/drivers/virtio/virtio_mmio.hpp"
+#include <stdint.h>
+
+namespace {
+
+static constexpr uint32_t MAX_DEVS = 32;
+
+static uintptr_t g_base[MAX_DEVS];
+static uint32_t  g_irq[MAX_DEVS];
+static uint32_t  g_count = 0;
+
+}
+
+namespace virtio {
+
+void set_irq(uintptr_t base, uint32_t irq) {
+    if (!irq) return;
+    for (uint32_t i = 0; i < g_count; ++i)
+        if (g_base[i] == base) { g_irq[i] = irq; return; }
+    if (g_count == MAX_DEVS) return;
+    g_base[g_count] = base;
+    g_irq[g_count]  = irq;
+    ++g_count;
+}
+
+uint32_t irq_for(uintptr_t base) {
+    for (uint32_t i = 0; i < g_count; ++i)
+        if (g_base[i] == base) return g_irq[i];
+    return MMIO_IRQ_BASE + (uint32_t)((base - MMIO_BASE) / MMIO_STEP);
+}
+
+}
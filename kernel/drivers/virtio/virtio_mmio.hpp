@@ -1,6 +1,8 @@
 /*
   virtio_mmio.hpp - virtio-mmio v2 register map and device ids
-  qemu virt puts virtio devices at 0x0a000000 + slot * 0x200
+  qemu virt puts virtio devices at 0x0a000000 + slot * 0x200, wired to
+  spi 16 + slot (intid 48 + slot); set_irq() records the line the device
+  tree gives and irq_for() falls back to that layout for devices it lacks
   has device ids, magic/version constants, status bits, and the read32/write32 accessors
 */
 #pragma once
@@ -13,6 +15,10 @@ static constexpr uint32_t DEVICE_BLK        = 2;
 static constexpr uint32_t DEVICE_GPU        = 16;
 static constexpr uint32_t DEVICE_INPUT      = 18;
 
+static constexpr uintptr_t MMIO_BASE        = 0x0a000000u;
+static constexpr uintptr_t MMIO_STEP        = 0x200u;
+static constexpr uint32_t  MMIO_IRQ_BASE    = 48u;
+
 static constexpr uint32_t MMIO_MAGIC        = 0x74726976u;
 static constexpr uint32_t MMIO_VERSION      = 2;
 
@@ -24,11 +30,15 @@ static constexpr uint32_t STATUS_NEEDS_RESET    = 64u;
 static constexpr uint32_t STATUS_FAILED         = 128u;
 
 static constexpr uint32_t VIRTIO_F_VERSION_1    = (1u << 0);
+static constexpr uint32_t VIRTIO_F_RING_PACKED  = (1u << 2);
 
 static constexpr uint16_t VRING_DESC_F_NEXT     = 1u;
 static constexpr uint16_t VRING_DESC_F_WRITE    = 2u;
 static constexpr uint16_t VRING_DESC_F_INDIRECT = 4u;
 
+static constexpr uint16_t VRING_PACKED_DESC_F_AVAIL = (1u << 7);
+static constexpr uint16_t VRING_PACKED_DESC_F_USED  = (1u << 15);
+
 enum Reg : uint32_t {
     MagicValue          = 0x000,
     Version             = 0x004,
@@ -66,4 +76,8 @@ inline volatile uint8_t*  cfg8 (uintptr_t base, uint32_t off) {
     return reinterpret_cast<volatile uint8_t*>(base + Config + off);
 }
 
+void     set_irq(uintptr_t base, uint32_t irq);
+
+uint32_t irq_for(uintptr_t base);
+
 }
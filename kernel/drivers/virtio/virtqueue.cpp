@@ -1,7 +1,12 @@
 /*
   virtqueue.cpp - virtqueue implementation
-  init allocates and zeros the descriptor/avail/used rings
-  begin_chain/add_desc/submit_chain/notify encode a request, poll() spins until done
+  init allocates and zeros the descriptor/avail/used rings (split) or the
+  descriptor ring plus the two event suppression areas (packed)
+  alloc_desc/fill_desc build a chain, submit() publishes it and notifies,
+  poll_used() checks for a completion
+  post() stamps each head with cntpct and complete() turns the stamp into
+  a latency sample; poll_used() on a split ring walks the new used entries
+  so single-request drivers are timed too
 */
 #include "kernel/drivers/virtio/virtqueue.hpp"
 #include "kernel/drivers/virtio/virtio_mmio.hpp"
@@ -12,10 +17,36 @@
 #include <stdint.h>
 #include <stddef.h>
 
-namespace virtio {
+namespace {
+
+static virtio::VirtQueue* g_queues[virtio::MAX_QUEUES];
+static uint32_t           g_nqueues = 0;
+static uint64_t           g_lat_lim[virtio::LAT_BUCKETS - 1] = {};
+
+static uint64_t to_ns(uint64_t ticks) {
+    uint64_t f = read_cntfrq_el0();
+    return f ? ticks * 1000000000ull / f : 0;
+}
 
-bool VirtQueue::init(uintptr_t mmio_base, uint16_t queue_idx, uint16_t num) {
+static inline uint32_t lat_bucket(uint64_t ticks) {
+    if (!g_lat_lim[0]) {
+        uint64_t f = read_cntfrq_el0();
+        for (uint32_t b = 0; b < virtio::LAT_BUCKETS - 1; ++b) {
+            uint64_t lim = f * (1ull << (2 * b)) / 1000000u;
+            g_lat_lim[b] = lim ? lim : 1;
+        }
+    }
+    uint32_t b = 0;
+    while (b < virtio::LAT_BUCKETS - 1 && ticks >= g_lat_lim[b]) ++b;
+    return b;
+}
+
+}
 
+namespace virtio {
+
+bool VirtQueue::init(uintptr_t mmio_base, uint16_t queue_idx, uint16_t num, bool packed,
+                     const char* name) {
     write32(mmio_base, QueueSel, queue_idx);
     dsb_sy();
 
@@ -24,18 +55,12 @@ bool VirtQueue::init(uintptr_t mmio_base, uint16_t queue_idx, uint16_t num) {
     if (num > max_num) num = (uint16_t)max_num;
     if (num > QUEUE_SIZE)  num = QUEUE_SIZE;
 
-    _num = num;
-
-    desc  = static_cast<VirtqDesc*> (kheap::alloc(sizeof(VirtqDesc)  * num,  4096));
-    avail = static_cast<VirtqAvail*>(kheap::alloc(sizeof(VirtqAvail),         4096));
-    used  = static_cast<VirtqUsed*> (kheap::alloc(sizeof(VirtqUsed),          4096));
+    _num    = num;
+    _packed = packed;
 
-    if (!desc || !avail || !used)
-        panic("virtqueue: alloc failed");
-
-    memset(desc,  0, sizeof(VirtqDesc)  * num);
-    memset(avail, 0, sizeof(VirtqAvail));
-    memset(used,  0, sizeof(VirtqUsed));
+    desc = static_cast<VirtqDesc*>(kheap::alloc(sizeof(VirtqDesc) * num, 4096));
+    if (!desc) panic("virtqueue: alloc failed");
+    memset(desc, 0, sizeof(VirtqDesc) * num);
 
     for (uint16_t i = 0; i < num - 1; ++i)
         desc[i].next = (uint16_t)(i + 1);
@@ -43,31 +68,73 @@ bool VirtQueue::init(uintptr_t mmio_base, uint16_t queue_idx, uint16_t num) {
     _free_head = 0;
     _last_used = 0;
 
-    avail->flags = 0;
-    avail->idx   = 0;
-    used->flags  = 0;
-    used->idx    = 0;
+    uint64_t desc_pa, driver_pa, device_pa;
+
+    if (packed) {
+
+        ring      = static_cast<VirtqPackedDesc*> (kheap::alloc(sizeof(VirtqPackedDesc) * num, 4096));
+        drv_event = static_cast<VirtqPackedEvent*>(kheap::alloc(sizeof(VirtqPackedEvent), 64));
+        dev_event = static_cast<VirtqPackedEvent*>(kheap::alloc(sizeof(VirtqPackedEvent), 64));
+
+        if (!ring || !drv_event || !dev_event)
+            panic("virtqueue: packed alloc failed");
+
+        memset(ring,      0, sizeof(VirtqPackedDesc) * num);
+        memset(drv_event, 0, sizeof(VirtqPackedEvent));
+        memset(dev_event, 0, sizeof(VirtqPackedEvent));
+
+        _avail_idx  = 0;
+        _avail_wrap = true;
+        _used_wrap  = true;
+        memset(_chain_len, 0, sizeof(_chain_len));
+
+        dc_civac_range(ring,      sizeof(VirtqPackedDesc) * num);
+        dc_civac_range(drv_event, sizeof(VirtqPackedEvent));
+        dc_civac_range(dev_event, sizeof(VirtqPackedEvent));
+
+        desc_pa   = phys(ring);
+        driver_pa = phys(drv_event);
+        device_pa = phys(dev_event);
+    } else {
+
+        avail = static_cast<VirtqAvail*>(kheap::alloc(sizeof(VirtqAvail), 4096));
+        used  = static_cast<VirtqUsed*> (kheap::alloc(sizeof(VirtqUsed),  4096));
+
+        if (!avail || !used)
+            panic("virtqueue: alloc failed");
+
+        memset(avail, 0, sizeof(VirtqAvail));
+        memset(used,  0, sizeof(VirtqUsed));
+
+        avail->flags = 0;
+        avail->idx   = 0;
+        used->flags  = 0;
+        used->idx    = 0;
+        _avail_idx   = 0;
+
+        desc_pa   = phys(desc);
+        driver_pa = phys(avail);
+        device_pa = phys(used);
+    }
 
     dsb_sy();
 
     write32(mmio_base, QueueNum, num);
     dsb_sy();
 
-    uint64_t desc_pa  = phys(desc);
-    uint64_t avail_pa = phys(avail);
-    uint64_t used_pa  = phys(used);
-
-    write32(mmio_base, QueueDescLow,    (uint32_t)(desc_pa  & 0xFFFFFFFFu));
-    write32(mmio_base, QueueDescHigh,   (uint32_t)(desc_pa  >> 32));
-    write32(mmio_base, QueueDriverLow,  (uint32_t)(avail_pa & 0xFFFFFFFFu));
-    write32(mmio_base, QueueDriverHigh, (uint32_t)(avail_pa >> 32));
-    write32(mmio_base, QueueDeviceLow,  (uint32_t)(used_pa  & 0xFFFFFFFFu));
-    write32(mmio_base, QueueDeviceHigh, (uint32_t)(used_pa  >> 32));
+    write32(mmio_base, QueueDescLow,    (uint32_t)(desc_pa   & 0xFFFFFFFFu));
+    write32(mmio_base, QueueDescHigh,   (uint32_t)(desc_pa   >> 32));
+    write32(mmio_base, QueueDriverLow,  (uint32_t)(driver_pa & 0xFFFFFFFFu));
+    write32(mmio_base, QueueDriverHigh, (uint32_t)(driver_pa >> 32));
+    write32(mmio_base, QueueDeviceLow,  (uint32_t)(device_pa & 0xFFFFFFFFu));
+    write32(mmio_base, QueueDeviceHigh, (uint32_t)(device_pa >> 32));
     dsb_sy();
 
     write32(mmio_base, QueueReady, 1);
     dsb_sy();
 
+    if (name && !_name && g_nqueues < MAX_QUEUES) g_queues[g_nqueues++] = this;
+    if (name) _name = name;
     return true;
 }
 
@@ -94,23 +161,156 @@ void VirtQueue::fill_desc(uint16_t idx, uint64_t pa, uint32_t len,
 }
 
 void VirtQueue::submit(uint16_t head, uintptr_t mmio_base, uint16_t queue_idx) {
-    uint16_t slot = avail->idx & (uint16_t)(_num - 1u);
-    avail->ring[slot] = head;
-    dsb_sy();
-    avail->idx = (uint16_t)(avail->idx + 1u);
-    dsb_sy();
+    post(head);
+    if (!_packed) dc_civac_range(desc, sizeof(VirtqDesc) * _num);
+    kick(mmio_base, queue_idx);
+}
+
+void VirtQueue::post(uint16_t head) {
+    ++_st.submits;
+    if (_timed && head < QUEUE_SIZE) _posted_at[head] = read_cntpct_el0();
+    if (_packed) {
+        submit_packed(head);
+        return;
+    }
+    avail->ring[_avail_idx & (uint16_t)(_num - 1u)] = head;
+    _avail_idx = (uint16_t)(_avail_idx + 1u);
+}
 
-    dc_civac_range(desc,  sizeof(VirtqDesc) * _num);
-    dc_civac_range(avail, sizeof(VirtqAvail));
+void VirtQueue::kick(uintptr_t mmio_base, uint16_t queue_idx) {
+    if (!_packed) {
+        dsb_sy();
+        avail->idx = _avail_idx;
+        dsb_sy();
+        dc_civac_range(avail, sizeof(VirtqAvail));
+    }
     write32(mmio_base, QueueNotify, queue_idx);
+    ++_st.notifies;
+}
+
+void VirtQueue::complete(uint16_t id) {
+    ++_st.completions;
+    if (id >= QUEUE_SIZE || !_posted_at[id]) return;
+    uint64_t d = read_cntpct_el0() - _posted_at[id];
+    _posted_at[id] = 0;
+    _lat_sum_ticks += d;
+    if (d > _max_lat_ticks) _max_lat_ticks = d;
+    ++_st.hist[lat_bucket(d)];
+}
+
+void VirtQueue::snapshot(QueueStats& out) const {
+    uint64_t flags = irq_save();
+    out = _st;
+    uint64_t sum = _lat_sum_ticks;
+    uint64_t max = _max_lat_ticks;
+    irq_restore(flags);
+    out.lat_sum_ns = to_ns(sum);
+    out.max_lat_ns = to_ns(max);
+}
+
+void VirtQueue::reset_stats() {
+    uint64_t flags = irq_save();
+    _st = QueueStats{};
+    _lat_sum_ticks = 0;
+    _max_lat_ticks = 0;
+    irq_restore(flags);
+}
+
+uint32_t queue_count() { return g_nqueues; }
+
+VirtQueue* queue(uint32_t i) { return i < g_nqueues ? g_queues[i] : nullptr; }
+
+uint64_t lat_limit_ns(uint32_t bucket) {
+    lat_bucket(0);
+    return bucket < LAT_BUCKETS - 1 ? to_ns(g_lat_lim[bucket]) : 0;
 }
 
 bool VirtQueue::poll_used() {
+    if (_packed) {
+        uint16_t id;
+        uint32_t len;
+        return pop_used(id, len);
+    }
 
     dc_ivac_range(used, sizeof(VirtqUsed));
     if (used->idx == _last_used) return false;
-    _last_used = used->idx;
+    for (; _last_used != used->idx; _last_used = (uint16_t)(_last_used + 1u))
+        complete((uint16_t)used->ring[_last_used & (uint16_t)(_num - 1u)].id);
+    return true;
+}
+
+bool VirtQueue::pop_used(uint16_t& id, uint32_t& len) {
+    if (_packed) {
+        VirtqPackedDesc& r = ring[_last_used];
+        dc_civac_range(&r, sizeof(VirtqPackedDesc));
+        uint16_t f = r.flags;
+        bool avail_ = (f & VRING_PACKED_DESC_F_AVAIL) != 0;
+        bool used_  = (f & VRING_PACKED_DESC_F_USED)  != 0;
+        if (avail_ != used_ || used_ != _used_wrap) return false;
+        dsb_sy();
+        id  = r.id;
+        len = r.len;
+        complete(id);
+        uint16_t n = (id < _num && _chain_len[id]) ? _chain_len[id] : 1u;
+        _last_used = (uint16_t)(_last_used + n);
+        if (_last_used >= _num) {
+            _last_used = (uint16_t)(_last_used - _num);
+            _used_wrap = !_used_wrap;
+        }
+        return true;
+    }
+
+    dc_ivac_range(&used->idx, sizeof(used->idx));
+    if (used->idx == _last_used) return false;
+    dsb_sy();
+    VirtqUsedElem& e = used->ring[_last_used & (uint16_t)(_num - 1u)];
+    dc_ivac_range(&e, sizeof(e));
+    id  = (uint16_t)e.id;
+    len = e.len;
+    _last_used = (uint16_t)(_last_used + 1u);
+    complete(id);
     return true;
 }
 
+void VirtQueue::submit_packed(uint16_t head) {
+
+    uint16_t start      = _avail_idx;
+    uint16_t head_flags = 0;
+    uint16_t n          = 0;
+
+    for (uint16_t i = head;; i = desc[i].next) {
+        const VirtqDesc& d = desc[i];
+        VirtqPackedDesc& r = ring[_avail_idx];
+
+        uint16_t f = (uint16_t)(d.flags & (VRING_DESC_F_NEXT | VRING_DESC_F_WRITE));
+        f |= _avail_wrap ? VRING_PACKED_DESC_F_AVAIL : VRING_PACKED_DESC_F_USED;
+
+        r.addr = d.addr;
+        r.len  = d.len;
+        r.id   = head;
+
+        if (n == 0) head_flags = f;
+        else        r.flags    = f;
+        ++n;
+
+        if (++_avail_idx == _num) {
+            _avail_idx  = 0;
+            _avail_wrap = !_avail_wrap;
+        }
+        if (!(d.flags & VRING_DESC_F_NEXT) || n == _num) break;
+    }
+    _chain_len[head] = n;
+
+    dsb_sy();
+    ring[start].flags = head_flags;
+    dsb_sy();
+
+    if (start + n <= _num) {
+        dc_civac_range(&ring[start], sizeof(VirtqPackedDesc) * n);
+    } else {
+        dc_civac_range(&ring[start], sizeof(VirtqPackedDesc) * (_num - start));
+        dc_civac_range(&ring[0],     sizeof(VirtqPackedDesc) * (start + n - _num));
+    }
+}
+
 }
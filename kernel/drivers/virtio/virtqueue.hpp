@@ -1,7 +1,19 @@
 /*
-  virtqueue.hpp - split-ring virtqueue (virtio spec 2.7)
+  virtqueue.hpp - split-ring (virtio spec 2.7) and packed-ring (2.8) virtqueue
   manages one virtqueue for one virtio device
   all rings heap-allocated with 4096-byte alignment, polling mode (no irq needed)
+  drivers always build chains in the desc table with alloc_desc/fill_desc;
+  in packed mode submit() copies the chain into the shared ring so the hot
+  path only touches the ring slots it writes and the one slot it polls
+  post() + kick() let a driver repost many buffers with a single notify,
+  pop_used() returns completed buffer ids one at a time
+  every queue keeps QueueStats: posts, completions, notifies and the
+  post-to-completion latency of each chain in factor-of-4 buckets, kept in
+  counter ticks and converted to ns by snapshot(); drivers add the payload
+  bytes they move and the polls they spin. a queue passed a name at init()
+  is listed by queue_count()/queue() for iostat
+  event queues call set_timed(false): a posted input buffer completes when
+  the user next types, so its wait is not device latency and is left out
 */
 #pragma once
 #include <stdint.h>
@@ -11,6 +23,20 @@ namespace virtio {
 
 static constexpr uint16_t QUEUE_SIZE = 64;
 
+static constexpr uint32_t LAT_BUCKETS = 8;
+static constexpr uint32_t MAX_QUEUES  = 8;
+
+struct QueueStats {
+    uint64_t submits;
+    uint64_t completions;
+    uint64_t notifies;
+    uint64_t spins;
+    uint64_t bytes;
+    uint64_t lat_sum_ns;
+    uint64_t max_lat_ns;
+    uint32_t hist[LAT_BUCKETS];
+};
+
 struct VirtqDesc {
     uint64_t addr;
     uint32_t len;
@@ -37,10 +63,23 @@ struct VirtqUsed {
     uint16_t        avail_event;
 } __attribute__((packed));
 
+struct VirtqPackedDesc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t id;
+    uint16_t flags;
+} __attribute__((packed));
+
+struct VirtqPackedEvent {
+    uint16_t off_wrap;
+    uint16_t flags;
+} __attribute__((packed));
+
 class VirtQueue {
 public:
 
-    bool init(uintptr_t mmio_base, uint16_t queue_idx, uint16_t num = QUEUE_SIZE);
+    bool init(uintptr_t mmio_base, uint16_t queue_idx, uint16_t num = QUEUE_SIZE,
+              bool packed = false, const char* name = nullptr);
 
     uint16_t alloc_desc();
 
@@ -53,6 +92,24 @@ public:
 
     bool poll_used();
 
+    void post(uint16_t head);
+
+    void kick(uintptr_t mmio_base, uint16_t queue_idx);
+
+    bool pop_used(uint16_t& id, uint32_t& len);
+
+    bool is_packed() const { return _packed; }
+
+    void add_bytes(uint64_t n) { _st.bytes += n; }
+    void add_spins(uint64_t n) { _st.spins += n; }
+
+    void snapshot(QueueStats& out) const;
+    void set_timed(bool on) { _timed = on; }
+    bool timed() const      { return _timed; }
+    void reset_stats();
+
+    const char* name() const { return _name; }
+
     static uint64_t phys(const void* p) {
         return reinterpret_cast<uint64_t>(p);
     }
@@ -61,9 +118,36 @@ public:
     VirtqAvail* avail = nullptr;
     VirtqUsed*  used  = nullptr;
 
+    VirtqPackedDesc*  ring      = nullptr;
+    VirtqPackedEvent* drv_event = nullptr;
+    VirtqPackedEvent* dev_event = nullptr;
+
     uint16_t _free_head = 0;
     uint16_t _last_used = 0;
     uint16_t _num       = 0;
+
+    bool     _packed     = false;
+    uint16_t _avail_idx  = 0;
+    bool     _avail_wrap = true;
+    bool     _used_wrap  = true;
+    uint16_t _chain_len[QUEUE_SIZE] = {};
+
+private:
+
+    void submit_packed(uint16_t head);
+    void complete(uint16_t id);
+
+    const char* _name = nullptr;
+    QueueStats  _st   = {};
+    bool        _timed = true;
+    uint64_t    _lat_sum_ticks = 0;
+    uint64_t    _max_lat_ticks = 0;
+    uint64_t    _posted_at[QUEUE_SIZE] = {};
 };
 
+uint32_t   queue_count();
+VirtQueue* queue(uint32_t i);
+
+uint64_t lat_limit_ns(uint32_t bucket);
+
 }
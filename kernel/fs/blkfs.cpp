@@ -1,7 +1,20 @@
 /*
   blkfs.cpp - block filesystem that persists ramfs to a virtio-blk disk
-  on init it reads the disk header and loads entries back into ramfs
-  flush() rewrites the whole disk from the current ramfs state
+  init() starts a load coroutine that reads the disk header and entry table
+  while boot carries on; on_loaded runs once it has finished. file data is
+  not read then: each file becomes a lazy ramfs entry whose backing tag is
+  its data sector, and ramfs pulls it in through load_file() on first read.
+  load_file() blocks its thread, so coroutines use load_async() instead
+  flush_async() brings the disk up to date with ramfs, after any load in
+  progress, one flush at a time; flush() blocks a thread on it. files keep
+  their table slot and data extent across flushes: only dirty files are
+  written, in place when they still fit and first-fit into the pool
+  otherwise, and only table sectors that differ from s_table go out. clean
+  files, lazy or not, are never read or moved. extents s_table still names
+  stay reserved until the new table is written, and a file that cannot be
+  written this time keeps its old extent and stays dirty. the exception is
+  a failed in-place overwrite: that extent may be half written, so the
+  file is saved empty and stays dirty
   disk layout: sector 0 = header, sectors 1-16 = entry table, 17+ = data pool
 */
 #include "kernel/fs/blkfs.hpp"
@@ -14,46 +27,75 @@
 
 static blkfs::DiskHeader s_header                                __attribute__((aligned(512)));
 static blkfs::DiskEntry  s_table[blkfs::MAX_ENTRIES]             __attribute__((aligned(512)));
+static blkfs::DiskEntry  s_next[blkfs::MAX_ENTRIES]              __attribute__((aligned(512)));
 
 static_assert(sizeof(s_table) == blkfs::TABLE_SECS * 512,
               "s_table size must equal the table sector region");
 
 namespace {
 
+static constexpr size_t PER_SEC = 512u / blkfs::ENTRY_SIZE;
+
+struct Job {
+    uint16_t slot;
+    uint16_t idx;
+    uint32_t gen;
+};
+
 static bool g_ready  = false;
 static bool g_loaded = false;
+static bool g_synced = false;
 
-static uint32_t sectors_for(uint32_t bytes) {
-    return (bytes + 511u) / 512u;
-}
+static uint32_t g_stale_secs   = 0;
+static bool     g_stale_header = false;
 
-}
+static Job      g_jobs[blkfs::MAX_ENTRIES];
+static uint8_t* g_bounce     = nullptr;
+static uint32_t g_bounce_cap = 0;
 
-namespace blkfs {
+static co::Event g_load_done;
+static co::Event g_flush_free;
+static void    (*g_on_loaded)(bool) = nullptr;
 
-bool ready() { return g_ready; }
+static uint32_t sectors_for(uint32_t bytes) {
+    return (bytes + 511u) / 512u;
+}
 
-bool init(const uintptr_t* bases, int n) {
-    if (!vblk::init(bases, n)) {
-        print("blkfs: no virtio-blk device found\n");
+static bool load_file(uint32_t sector, void* dst, size_t size) {
+    if (co::in_runner()) {
+        print("blkfs: blocking file load from a coroutine, use load_async\n");
         return false;
     }
-    g_ready = true;
+    uint32_t nsec = sectors_for((uint32_t)size);
+    void* buf = kheap::alloc(nsec * 512u, 512);
+    if (!buf) {
+        print("blkfs: out of memory loading file\n");
+        return false;
+    }
+    bool ok = vblk::read_sectors(sector, nsec, buf);
+    if (ok) memcpy(dst, buf, size);
+    else    print("blkfs: data read failed\n");
+    kheap::free(buf);
+    return ok;
+}
 
-    if (!vblk::read_sectors(HEADER_SEC, 1, &s_header)) {
+static co::Task<bool> read_disk() {
+    using namespace blkfs;
+
+    if (!co_await vblk::read_async(HEADER_SEC, 1, &s_header)) {
         print("blkfs: header read failed\n");
-        return false;
+        co_return false;
     }
 
     if (s_header.magic != MAGIC || s_header.version != VERSION) {
 
         print("blkfs: disk not formatted (will format on first flush)\n");
-        return false;
+        co_return false;
     }
 
-    if (!vblk::read_sectors(TABLE_SEC, TABLE_SECS, s_table)) {
+    if (!co_await vblk::read_async(TABLE_SEC, TABLE_SECS, s_table)) {
         print("blkfs: entry table read failed\n");
-        return false;
+        co_return false;
     }
 
     uint32_t loaded = 0;
@@ -66,107 +108,334 @@ bool init(const uintptr_t* bases, int n) {
         } else if (e.data_size == 0 || e.data_sector == 0) {
             ramfs::create(e.name, nullptr, 0);
         } else {
+            ramfs::create_lazy(e.name, e.data_size, e.data_sector);
+        }
+        ++loaded;
+    }
 
-            uint32_t nsec = sectors_for(e.data_size);
-            uint32_t bufsz = nsec * 512u;
-            void* buf = kheap::alloc(bufsz, 512);
-            if (!buf) {
-                print("blkfs: out of memory loading file\n");
-                continue;
-            }
-            if (!vblk::read_sectors(e.data_sector, nsec, buf)) {
-                print("blkfs: data read failed for ");
-                print(e.name); print("\n");
-                kheap::free(buf);
-                continue;
+    g_synced = true;
+    printk("blkfs: %u entries on disk, file data loads on first read\n", loaded);
+    co_return true;
+}
+
+static co::Task<void> load() {
+    g_loaded = co_await read_disk();
+    g_load_done.set();
+    if (g_on_loaded) g_on_loaded(g_loaded);
+}
+
+static bool sector_changed(uint32_t sec) {
+    size_t first = sec * PER_SEC;
+    return (g_stale_secs & (1u << sec)) ||
+           memcmp(&s_next[first], &s_table[first], 512) != 0;
+}
+
+static bool same_name(const blkfs::DiskEntry& de, const char* name) {
+    return strncmp(de.name, name, sizeof(de.name) - 1) == 0 &&
+           strlen(name) < sizeof(de.name);
+}
+
+static uint32_t extent_end(const blkfs::DiskEntry& de) {
+    return de.data_sector + sectors_for(de.data_size);
+}
+
+static bool overlaps(const blkfs::DiskEntry& de, uint32_t at, uint32_t nsec) {
+    return de.used && de.data_sector != 0 &&
+           de.data_sector < at + nsec && extent_end(de) > at;
+}
+
+static uint32_t alloc_extent(uint32_t nsec) {
+    using namespace blkfs;
+    uint32_t at = DATA_START;
+    for (bool moved = true; moved; ) {
+        moved = false;
+        for (size_t i = 0; i < MAX_ENTRIES; ++i) {
+            const DiskEntry* hit = overlaps(s_next[i],  at, nsec) ? &s_next[i]
+                                 : overlaps(s_table[i], at, nsec) ? &s_table[i]
+                                 : nullptr;
+            if (hit) {
+                at    = extent_end(*hit);
+                moved = true;
             }
-            ramfs::create(e.name, buf, e.data_size);
-            kheap::free(buf);
         }
-        ++loaded;
     }
+    if ((uint64_t)at + nsec > vblk::sector_count()) return 0;
+    return at;
+}
 
-    g_loaded = true;
-    printk("blkfs: loaded %u entries from disk\n", loaded);
+static void keep_old(size_t idx) {
+    blkfs::DiskEntry&       de  = s_next[idx];
+    const blkfs::DiskEntry& old = s_table[idx];
+    if (old.used && !old.is_dir && strncmp(old.name, de.name, sizeof(de.name)) == 0) {
+        de.data_sector = old.data_sector;
+        de.data_size   = old.data_size;
+    } else {
+        de.data_sector = 0;
+        de.data_size   = 0;
+    }
+}
+
+static bool ensure_bounce(uint32_t bytes) {
+    if (bytes <= g_bounce_cap) return true;
+    uint8_t* buf = (uint8_t*)kheap::alloc(bytes, 512);
+    if (!buf) return false;
+    kheap::free(g_bounce);
+    g_bounce     = buf;
+    g_bounce_cap = bytes;
     return true;
 }
 
-bool flush() {
-    if (!g_ready) return false;
+static uint32_t plan(const ramfs::Entry* tbl) {
+    using namespace blkfs;
 
-    const ramfs::Entry* tbl = ramfs::table();
-    uint32_t free_sec = DATA_START;
-    uint32_t entry_count = 0;
+    bool claimed[MAX_ENTRIES] = {};
+    int  idx_of[ramfs::MAX_FILES];
+    uint32_t jobs = 0;
 
-    memset(s_table, 0, sizeof(s_table));
+    memset(s_next, 0, sizeof(s_next));
 
-    for (size_t i = 0; i < MAX_ENTRIES; ++i) {
-        const ramfs::Entry& re = tbl[i];
+    for (size_t s = 0; s < ramfs::MAX_FILES; ++s) {
+        idx_of[s] = -1;
+        if (!tbl[s].used) continue;
+        for (size_t i = 0; i < MAX_ENTRIES; ++i) {
+            if (claimed[i] || !s_table[i].used || !same_name(s_table[i], tbl[s].name))
+                continue;
+            claimed[i] = true;
+            idx_of[s]  = (int)i;
+            break;
+        }
+    }
+
+    for (size_t s = 0; s < ramfs::MAX_FILES; ++s) {
+        const ramfs::Entry& re = tbl[s];
         if (!re.used) continue;
 
-        DiskEntry& de = s_table[entry_count++];
+        bool fresh = idx_of[s] < 0;
+        if (fresh) {
+            for (size_t i = 0; i < MAX_ENTRIES; ++i)
+                if (!claimed[i]) { claimed[i] = true; idx_of[s] = (int)i; break; }
+            if (idx_of[s] < 0) continue;
+        }
+
+        size_t idx = (size_t)idx_of[s];
+        DiskEntry&       de  = s_next[idx];
+        const DiskEntry& old = s_table[idx];
 
         size_t nl = strlen(re.name);
         if (nl >= sizeof(de.name)) nl = sizeof(de.name) - 1;
         memcpy(de.name, re.name, nl);
-        de.name[nl] = '\0';
+        de.is_dir = re.is_dir ? 1u : 0u;
+        de.used   = 1u;
+
+        if (re.is_dir || re.size == 0) {
+            ramfs::mark_clean(s, re.gen);
+            continue;
+        }
+
+        if (!re.dirty && !fresh) {
+            de.data_sector = old.data_sector;
+            de.data_size   = old.data_size;
+            continue;
+        }
+        if (!re.data) {
+            keep_old(idx);
+            continue;
+        }
 
-        de.is_dir  = re.is_dir ? 1u : 0u;
-        de.used    = 1u;
+        if (!fresh && old.data_sector != 0 && !old.is_dir &&
+            sectors_for((uint32_t)re.size) <= sectors_for(old.data_size)) {
+            de.data_sector = old.data_sector;
+            de.data_size   = (uint32_t)re.size;
+        }
+        g_jobs[jobs++] = { (uint16_t)s, (uint16_t)idx, re.gen };
+    }
 
-        if (re.is_dir || re.size == 0 || re.data == nullptr) {
-            de.data_sector = 0;
-            de.data_size   = 0;
+    for (uint32_t j = 0; j < jobs; ++j) {
+        DiskEntry& de = s_next[g_jobs[j].idx];
+        if (de.data_sector != 0) continue;
+        uint32_t size = (uint32_t)tbl[g_jobs[j].slot].size;
+        de.data_sector = alloc_extent(sectors_for(size));
+        if (de.data_sector == 0) {
+            print("blkfs: flush: disk full, skipping ");
+            print(de.name); print("\n");
+            keep_old(g_jobs[j].idx);
             continue;
         }
+        de.data_size = size;
+    }
+    return jobs;
+}
 
-        uint32_t nsec  = sectors_for((uint32_t)re.size);
-        uint32_t bufsz = nsec * 512u;
-        void* buf = kheap::alloc(bufsz, 512);
-        if (!buf) {
+static co::Task<uint32_t> write_files(uint32_t jobs) {
+    uint32_t written = 0;
+    for (uint32_t j = 0; j < jobs; ++j) {
+        const Job&          job = g_jobs[j];
+        blkfs::DiskEntry&   de  = s_next[job.idx];
+        const ramfs::Entry& re  = ramfs::table()[job.slot];
+        if (de.data_sector == 0) continue;
+
+        if (!re.used || !same_name(de, re.name)) {
+            memset(&de, 0, sizeof(de));
+            continue;
+        }
+
+        uint32_t room = sectors_for(de.data_size);
+        uint32_t size = (uint32_t)re.size;
+        uint32_t nsec = sectors_for(size);
+        if (nsec > room || !re.data) {
+            keep_old(job.idx);
+            continue;
+        }
+        if (!ensure_bounce(nsec * 512u)) {
             print("blkfs: flush: out of memory\n");
-            de.data_sector = 0;
-            de.data_size   = 0;
+            keep_old(job.idx);
             continue;
         }
-        memcpy(buf, re.data, re.size);
 
-        memset((uint8_t*)buf + re.size, 0, bufsz - re.size);
+        uint32_t gen = re.gen;
+        memcpy(g_bounce, re.data, size);
+        memset(g_bounce + size, 0, nsec * 512u - size);
 
-        if (!vblk::write_sectors(free_sec, nsec, buf)) {
+        if (!co_await vblk::write_async(de.data_sector, nsec, g_bounce)) {
             print("blkfs: flush: write failed for ");
-            print(re.name); print("\n");
-            kheap::free(buf);
-            de.data_sector = 0;
-            de.data_size   = 0;
+            print(de.name); print("\n");
+            if (de.data_sector != s_table[job.idx].data_sector) {
+                keep_old(job.idx);
+            } else {
+                de.data_sector = 0;
+                de.data_size   = 0;
+            }
             continue;
         }
+        de.data_size = size;
+        ramfs::mark_clean(job.slot, gen);
+        written += nsec;
+    }
+    co_return written;
+}
+
+static co::Task<bool> write_disk() {
+    using namespace blkfs;
 
-        de.data_sector = free_sec;
-        de.data_size   = (uint32_t)re.size;
-        free_sec      += nsec;
-        kheap::free(buf);
+    if (!g_synced) {
+        memset(s_table, 0, sizeof(s_table));
+        g_stale_secs   = (1u << TABLE_SECS) - 1u;
+        g_stale_header = true;
+        g_synced       = true;
     }
 
-    if (!vblk::write_sectors(TABLE_SEC, TABLE_SECS, s_table)) {
+    uint32_t jobs      = plan(ramfs::table());
+    uint32_t data_secs = co_await write_files(jobs);
+
+    uint32_t entry_count = 0;
+    uint32_t free_sec    = DATA_START;
+    for (size_t i = 0; i < MAX_ENTRIES; ++i) {
+        if (!s_next[i].used) continue;
+        ++entry_count;
+        if (s_next[i].data_sector && extent_end(s_next[i]) > free_sec)
+            free_sec = extent_end(s_next[i]);
+    }
+
+    uint32_t table_secs = 0;
+    bool     table_ok   = true;
+    for (uint32_t sec = 0; sec < TABLE_SECS; ) {
+        if (!sector_changed(sec)) { ++sec; continue; }
+        uint32_t run = 1;
+        while (sec + run < TABLE_SECS && sector_changed(sec + run)) ++run;
+
+        size_t   first = sec * PER_SEC;
+        uint32_t mask  = ((1u << run) - 1u) << sec;
+        memcpy(&s_table[first], &s_next[first], run * 512u);
+        if (co_await vblk::write_async(TABLE_SEC + sec, run, &s_table[first])) {
+            g_stale_secs &= ~mask;
+            table_secs   += run;
+        } else {
+            g_stale_secs |= mask;
+            table_ok      = false;
+        }
+        sec += run;
+    }
+    if (!table_ok) {
         print("blkfs: flush: entry table write failed\n");
-        return false;
+        co_return false;
     }
 
-    memset(&s_header, 0, sizeof(s_header));
-    s_header.magic        = MAGIC;
-    s_header.version      = VERSION;
-    s_header.entry_count  = entry_count;
-    s_header.free_sector  = free_sec;
+    if (g_stale_header || s_header.entry_count != entry_count ||
+        s_header.free_sector != free_sec) {
+        memset(&s_header, 0, sizeof(s_header));
+        s_header.magic        = MAGIC;
+        s_header.version      = VERSION;
+        s_header.entry_count  = entry_count;
+        s_header.free_sector  = free_sec;
+
+        g_stale_header = !co_await vblk::write_async(HEADER_SEC, 1, &s_header);
+        if (g_stale_header) {
+            print("blkfs: flush: header write failed\n");
+            co_return false;
+        }
+    }
+
+    printk("blkfs: flushed %u entries (%u data, %u table sectors written)\n",
+           entry_count, data_secs, table_secs);
+    co_return true;
+}
+}
+
+namespace blkfs {
+
+bool ready()  { return g_ready; }
+bool loaded() { return g_load_done.is_set(); }
 
-    if (!vblk::write_sectors(HEADER_SEC, 1, &s_header)) {
-        print("blkfs: flush: header write failed\n");
+co::Event& load_event() { return g_load_done; }
+
+bool init(const uintptr_t* bases, int n, void (*on_loaded)(bool loaded)) {
+    g_flush_free.set();
+    g_on_loaded = on_loaded;
+
+    if (!vblk::init(bases, n)) {
+        print("blkfs: no virtio-blk device found\n");
+        g_load_done.set();
+        if (g_on_loaded) g_on_loaded(false);
         return false;
     }
+    g_ready = true;
+    ramfs::set_loader(load_file);
 
-    printk("blkfs: flushed %u entries (%u data sectors)\n",
-           entry_count, free_sec - DATA_START);
+    co::spawn(load());
     return true;
 }
 
+co::Task<bool> load_async(const char* name) {
+    uint32_t backing, gen;
+    size_t   size;
+    if (!ramfs::lazy(name, backing, size, gen)) co_return ramfs::exists(name);
+
+    uint32_t nsec = sectors_for((uint32_t)size);
+    uint8_t* buf  = (uint8_t*)kheap::alloc(nsec * 512u, 512);
+    if (!buf) {
+        print("blkfs: out of memory loading file\n");
+        co_return false;
+    }
+    bool ok = co_await vblk::read_async(backing, nsec, buf);
+    if (!ok) print("blkfs: data read failed\n");
+    if (!ok || !ramfs::install(name, gen, backing, buf)) kheap::free(buf);
+    co_return ok && ramfs::exists(name) && !ramfs::lazy(name, backing, size, gen);
+}
+
+co::Task<bool> flush_async() {
+    if (!g_ready) co_return false;
+    co_await g_load_done;
+
+    while (!g_flush_free.is_set()) co_await g_flush_free;
+    g_flush_free.reset();
+    bool ok = co_await write_disk();
+    g_flush_free.set();
+    co_return ok;
+}
+
+bool flush() {
+    if (!g_ready) return false;
+    return co::block_on(flush_async());
+}
+
 }
@@ -1,12 +1,17 @@
 /*
   blkfs.hpp - block filesystem interface
-  init() loads from disk (or returns false if no formatted disk)
-  flush() saves all ramfs files back to disk
-  ready() / formatted() for status checks
+  init() finds the disk and starts loading it in the background, returning
+  false if there is no disk; on_loaded(loaded) is called once loading ends,
+  loaded is false for a missing or unformatted disk
+  flush() writes dirty ramfs files and changed table sectors back to disk,
+  flush_async() is the coroutine form; ready() / loaded() for status
+  checks, load_event() is set once loading has ended
+  load_async() reads a lazy file in without blocking, for coroutines
 */
 #pragma once
 #include <stdint.h>
 #include <stddef.h>
+#include "kernel/core/co.hpp"
 
 namespace blkfs {
 
@@ -41,10 +46,18 @@ static_assert(sizeof(DiskEntry)  == ENTRY_SIZE, "DiskEntry size mismatch");
 static_assert(MAX_ENTRIES * ENTRY_SIZE == TABLE_SECS * 512u,
               "Entry table must fit exactly in TABLE_SECS sectors");
 
-bool init (const uintptr_t* bases, int n);
+bool init (const uintptr_t* bases, int n, void (*on_loaded)(bool loaded) = nullptr);
 
 bool flush();
 
+co::Task<bool> flush_async();
+
+co::Task<bool> load_async(const char* name);
+
 bool ready();
 
+bool loaded();
+
+co::Event& load_event();
+
 }
@@ -0,0 +1,234 @@
+/*
+  procfs.cpp - /proc file generators
+  each file is a function that writes lines into a Text over a static
+  scratch page; callers hold the kernel lock, which covers the scratch.
+  output past the page is cut off, and ls() generates every file to report
+  its current size
+*/
+#include "kernel/fs/procfs.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/core/cpustat.hpp"
+#include "kernel/core/dispatch.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/drivers/virtio/virtqueue.hpp"
+#include "kernel/wm/wm.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <string.h>
+#include <stdint.h>
+
+namespace {
+
+static constexpr size_t PAGE = 4096;
+
+struct Text {
+    char*  buf;
+    size_t len;
+    size_t cap;
+
+    void put(const char* s) {
+        while (*s && len < cap) buf[len++] = *s++;
+    }
+
+    void dec(uint64_t v, int width = 0) {
+        char tmp[21]; int n = 0;
+        do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+        for (int i = n; i < width && len < cap; ++i) buf[len++] = ' ';
+        while (n && len < cap) buf[len++] = tmp[--n];
+    }
+
+    void col(const char* s, int width) {
+        int n = 0;
+        for (; s[n] && n < width - 1 && len < cap; ++n) buf[len++] = s[n];
+        for (; n < width && len < cap; ++n) buf[len++] = ' ';
+    }
+
+    void cs(uint64_t hundredths) {
+        dec(hundredths / 100u);
+        put(".");
+        if (hundredths % 100u < 10u) put("0");
+        dec(hundredths % 100u);
+    }
+};
+
+static void gen_meminfo(Text& t) {
+    size_t used = kheap::used_bytes();
+    size_t free = kheap::free_bytes();
+    t.col("HeapTotal:", 16); t.dec((used + free) / 1024u, 10); t.put(" kB\n");
+    t.col("HeapUsed:", 16);  t.dec(used / 1024u, 10);          t.put(" kB\n");
+    t.col("HeapFree:", 16);  t.dec(free / 1024u, 10);          t.put(" kB\n");
+    t.col("HeapKernel:", 16); t.dec(kheap::owner_bytes(0) / 1024u, 10); t.put(" kB\n");
+
+    size_t apps = 0;
+    for (uint32_t o = 1; o < kheap::OWNERS; ++o) apps += kheap::owner_bytes(o);
+    t.col("HeapApps:", 16);  t.dec(apps / 1024u, 10);          t.put(" kB\n");
+}
+
+static void gen_interrupts(Text& t) {
+    t.put(" irq      count  avg_lat  max_lat  avg_run  max_run  (us)\n");
+    for (uint32_t irq = 0; irq < 256; ++irq) {
+        gic::IrqStats st;
+        if (!gic::stats(irq, st)) continue;
+        t.dec(irq, 4);
+        t.dec(st.count, 11);
+        t.dec(st.lat_samples ? st.lat_sum_ns / st.lat_samples / 1000u : 0, 9);
+        t.dec(st.max_lat_ns / 1000u, 9);
+        t.dec(st.run_sum_ns / st.count / 1000u, 9);
+        t.dec(st.max_run_ns / 1000u, 9);
+        t.put("\n");
+    }
+    t.put("spurious: ");    t.dec(gic::spurious());
+    t.put("\nmax nesting: "); t.dec(gic::max_nesting()); t.put("\n");
+}
+
+static void gen_uptime(Text& t) {
+    cpustat::Stats st;
+    cpustat::snapshot(st);
+    uint64_t khz  = read_cntfrq_el0() / 1000u;
+    uint64_t idle = st.ticks[cpustat::IDLE] + st.ticks[cpustat::DISK_WAIT];
+    t.cs(timer::now_ns() / 10000000u);
+    t.put(" ");
+    t.cs(khz ? idle / khz / 10u : 0);
+    t.put("\n");
+}
+
+static void gen_virtio(Text& t) {
+    t.put("dev       submits  completions   notifies      spins       bytes  avg_us  max_us\n");
+    for (uint32_t i = 0; i < virtio::queue_count(); ++i) {
+        virtio::QueueStats st;
+        virtio::queue(i)->snapshot(st);
+        t.col(virtio::queue(i)->name(), 8);
+        t.dec(st.submits, 9);
+        t.dec(st.completions, 13);
+        t.dec(st.notifies, 11);
+        t.dec(st.spins, 11);
+        t.dec(st.bytes, 12);
+        if (virtio::queue(i)->timed()) {
+            t.dec(st.completions ? st.lat_sum_ns / st.completions / 1000u : 0, 8);
+            t.dec(st.max_lat_ns / 1000u, 8);
+        } else {
+            t.put("       -       -");
+        }
+        t.put("\n");
+    }
+}
+
+static void gen_windows(Text& t) {
+    dispatch::AppStats apps[dispatch::MAX_TASKS];
+    int napps = dispatch::stats(apps, dispatch::MAX_TASKS);
+
+    t.put("title                    x     y     w     h  redraws  surf_kb  cpu_ms  inputs  heap_kb\n");
+    for (int i = 0; i < wm::win_count(); ++i) {
+        wm::Window* w = wm::win_get(i);
+        if (!w) continue;
+        const dispatch::AppStats* a = nullptr;
+        for (int j = 0; j < napps; ++j)
+            if (apps[j].win == w) a = &apps[j];
+
+        t.col(w->title, 20);
+        t.dec((uint64_t)(w->x < 0 ? 0 : w->x), 6);
+        t.dec((uint64_t)(w->y < 0 ? 0 : w->y), 6);
+        t.dec(w->w, 6);
+        t.dec(w->h, 6);
+        t.dec(w->redraws, 9);
+        t.dec((uint64_t)w->fb_w * w->fb_client_h * 4u / 1024u, 9);
+        t.dec(a ? a->cpu_us / 1000u : 0, 8);
+        t.dec(a ? a->inputs : 0, 8);
+        t.dec(a ? a->heap_bytes / 1024u : 0, 9);
+        t.put("\n");
+    }
+}
+
+static void gen_frames(Text& t) {
+    framestat::Summary st;
+    framestat::summary(st);
+    t.put("phase         p50_us    p95_us    p99_us\n");
+    for (uint32_t p = 0; p < framestat::PHASES; ++p) {
+        t.col(framestat::name((framestat::Phase)p), 10);
+        t.dec(st.p50_us[p], 10);
+        t.dec(st.p95_us[p], 10);
+        t.dec(st.p99_us[p], 10);
+        t.put("\n");
+    }
+    t.put("frames: ");        t.dec(st.total_frames);
+    t.put("\nwindow: ");      t.dec(st.frames);
+    t.put("\npixels/frame: "); t.dec(st.pixels);
+    t.put("\nbytes/frame: "); t.dec(st.bytes);
+    t.put("\n");
+}
+
+struct File {
+    const char* name;
+    void (*gen)(Text& t);
+};
+
+static const File k_files[] = {
+    { "proc/meminfo",    gen_meminfo    },
+    { "proc/interrupts", gen_interrupts },
+    { "proc/uptime",     gen_uptime     },
+    { "proc/virtio",     gen_virtio     },
+    { "proc/windows",    gen_windows    },
+    { "proc/frames",     gen_frames     },
+};
+
+static constexpr size_t NFILES = sizeof(k_files) / sizeof(k_files[0]);
+
+static char g_page[PAGE];
+
+static const File* find(const char* path) {
+    for (size_t i = 0; i < NFILES; ++i)
+        if (strcmp(path, k_files[i].name) == 0) return &k_files[i];
+    return nullptr;
+}
+
+static size_t generate(const File& f) {
+    Text t{ g_page, 0, PAGE };
+    f.gen(t);
+    return t.len;
+}
+
+}
+
+namespace procfs {
+
+bool owns(const char* path) {
+    return path && strncmp(path, "proc", 4) == 0 && (path[4] == '\0' || path[4] == '/');
+}
+
+bool exists(const char* path) {
+    return is_dir(path) || find(path) != nullptr;
+}
+
+bool is_dir(const char* path) {
+    return path && strcmp(path, "proc") == 0;
+}
+
+int read(const char* path, void* buf, size_t len) {
+    const File* f = find(path);
+    if (!f) return -1;
+    size_t n = generate(*f);
+    if (n > len) n = len;
+    memcpy(buf, g_page, n);
+    return (int)n;
+}
+
+void ls(void (*cb)(const char* name, size_t size, bool is_dir)) {
+    if (!cb) return;
+    cb("proc", 0, true);
+    for (size_t i = 0; i < NFILES; ++i)
+        cb(k_files[i].name, generate(k_files[i]), false);
+}
+
+void ls_in(const char* dir, void (*cb)(const char* name, size_t size, bool is_dir)) {
+    if (!cb) return;
+    if (!dir || !dir[0]) {
+        cb("proc", 0, true);
+        return;
+    }
+    if (!is_dir(dir)) return;
+    for (size_t i = 0; i < NFILES; ++i)
+        cb(k_files[i].name + 5, generate(k_files[i]), false);
+}
+
+}
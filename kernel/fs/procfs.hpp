@@ -0,0 +1,26 @@
+/*
+  procfs.hpp - synthetic files under /proc
+  meminfo, interrupts, uptime, virtio, windows and frames are plain text
+  generated on every read from live counters, so cat, the editor and the
+  file explorer can inspect the kernel. nothing is stored: writes fail and
+  blkfs never sees these files
+  vfs routes any path that is "proc" or starts with "proc/" here
+*/
+#pragma once
+#include <stddef.h>
+
+namespace procfs {
+
+bool owns(const char* path);
+
+bool exists(const char* path);
+
+bool is_dir(const char* path);
+
+int  read(const char* path, void* buf, size_t len);
+
+void ls(void (*cb)(const char* name, size_t size, bool is_dir));
+
+void ls_in(const char* dir, void (*cb)(const char* name, size_t size, bool is_dir));
+
+}
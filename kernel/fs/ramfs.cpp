@@ -2,15 +2,27 @@
   ramfs.cpp - flat in-memory filesystem backed by kheap
   supports up to 64 files/dirs, each with a short name and heap-allocated data
   used as the primary fs on boot. blkfs syncs to/from disk on top of this
+  every mutation notifies the dispatcher so fs watchers can refresh
+  lazy entries keep data == nullptr until their first read; blkfs uses
+  this so boot only reads the entry table
+  the loader may sleep, so fault_in() keeps the name, gen and backing tag
+  and installs the buffer through install(), which only fills the entry if
+  it is still the same lazy file; a removed, rewritten or already loaded
+  entry makes it drop the buffer instead
+  gen comes from one counter so a removed and recreated file never
+  reuses the generation blkfs last wrote
 */
 #include "kernel/fs/ramfs.hpp"
 #include "kernel/mm/heap.hpp"
+#include "kernel/core/dispatch.hpp"
 #include <string.h>
 #include <stdint.h>
 
 namespace {
 
-static ramfs::Entry g_table[ramfs::MAX_FILES];
+static ramfs::Entry  g_table[ramfs::MAX_FILES];
+static ramfs::Loader g_loader = nullptr;
+static uint32_t      g_gen    = 0;
 
 static int find_name(const char* name) {
     for (size_t i = 0; i < ramfs::MAX_FILES; ++i)
@@ -32,6 +44,27 @@ static void name_copy(char* dst, const char* src) {
     dst[i] = '\0';
 }
 
+static int fault_in(int slot) {
+    ramfs::Entry& e = g_table[slot];
+    if (!e.backing) return slot;
+    if (!g_loader) return -1;
+
+    char     name[ramfs::NAME_MAX];
+    uint32_t backing = e.backing;
+    uint32_t gen     = e.gen;
+    size_t   size    = e.size;
+    memcpy(name, e.name, sizeof(name));
+
+    uint8_t* buf = (uint8_t*)kheap::alloc(size, 1);
+    if (!buf) return -1;
+    bool ok = g_loader(backing, buf, size);
+    if (!ok || !ramfs::install(name, gen, backing, buf)) kheap::free(buf);
+
+    slot = find_name(name);
+    if (!ok || slot < 0 || g_table[slot].backing) return -1;
+    return slot;
+}
+
 }
 
 namespace ramfs {
@@ -48,8 +81,9 @@ bool create(const char* name, const void* data, size_t size) {
         if (g_table[slot].is_dir) return false;
 
         kheap::free(g_table[slot].data);
-        g_table[slot].data = nullptr;
-        g_table[slot].size = 0;
+        g_table[slot].data    = nullptr;
+        g_table[slot].size    = 0;
+        g_table[slot].backing = 0;
     } else {
         slot = find_free();
         if (slot < 0) return false;
@@ -58,8 +92,12 @@ bool create(const char* name, const void* data, size_t size) {
         g_table[slot].is_dir = false;
         g_table[slot].data   = nullptr;
         g_table[slot].size   = 0;
+        g_table[slot].backing = 0;
     }
 
+    g_table[slot].dirty = true;
+    g_table[slot].gen   = ++g_gen;
+
     if (size > 0 && data) {
         uint8_t* buf = (uint8_t*)kheap::alloc(size, 1);
         if (!buf) {
@@ -72,6 +110,46 @@ bool create(const char* name, const void* data, size_t size) {
         g_table[slot].size = size;
     }
 
+    dispatch::notify(dispatch::SIG_FS);
+    return true;
+}
+
+bool create_lazy(const char* name, size_t size, uint32_t backing) {
+    if (!name || name[0] == '\0' || size == 0 || backing == 0) return false;
+    if (!create(name, nullptr, 0)) return false;
+    int slot = find_name(name);
+    g_table[slot].size    = size;
+    g_table[slot].backing = backing;
+    g_table[slot].dirty   = false;
+    return true;
+}
+
+void set_loader(Loader fn) {
+    g_loader = fn;
+}
+
+bool load(const char* name) {
+    if (!name) return false;
+    int slot = find_name(name);
+    return slot >= 0 && fault_in(slot) >= 0;
+}
+
+bool lazy(const char* name, uint32_t& backing, size_t& size, uint32_t& gen) {
+    int slot = name ? find_name(name) : -1;
+    if (slot < 0 || !g_table[slot].backing) return false;
+    backing = g_table[slot].backing;
+    size    = g_table[slot].size;
+    gen     = g_table[slot].gen;
+    return true;
+}
+
+bool install(const char* name, uint32_t gen, uint32_t backing, uint8_t* buf) {
+    int slot = name ? find_name(name) : -1;
+    if (slot < 0) return false;
+    Entry& e = g_table[slot];
+    if (e.gen != gen || e.backing != backing || !backing) return false;
+    e.data    = buf;
+    e.backing = 0;
     return true;
 }
 
@@ -79,6 +157,7 @@ int read(const char* name, void* buf, size_t len) {
     if (!name || !buf) return -1;
     int slot = find_name(name);
     if (slot < 0) return -1;
+    if ((slot = fault_in(slot)) < 0) return -1;
 
     size_t n = (g_table[slot].size < len) ? g_table[slot].size : len;
     if (n > 0 && g_table[slot].data)
@@ -136,6 +215,7 @@ bool remove(const char* name) {
 
     kheap::free(g_table[slot].data);
     memset(&g_table[slot], 0, sizeof(Entry));
+    dispatch::notify(dispatch::SIG_FS);
     return true;
 }
 
@@ -149,6 +229,8 @@ bool mkdir(const char* name) {
     g_table[slot].is_dir = true;
     g_table[slot].data   = nullptr;
     g_table[slot].size   = 0;
+    g_table[slot].dirty  = true;
+    dispatch::notify(dispatch::SIG_FS);
     return true;
 }
 
@@ -162,4 +244,9 @@ const Entry* table() {
     return g_table;
 }
 
+void mark_clean(size_t slot, uint32_t gen) {
+    if (slot < MAX_FILES && g_table[slot].used && g_table[slot].gen == gen)
+        g_table[slot].dirty = false;
+}
+
 }
@@ -2,6 +2,13 @@
   ramfs.hpp - ram filesystem interface
   init/create/read/write/list/remove/mkdir/exists
   entries are heap-allocated, max 64 files, name up to 64 chars
+  create_lazy() adds a file whose data is still elsewhere: it has a size
+  and a nonzero backing tag, and the first read() pulls the data in through
+  the loader set with set_loader(); load() does the same without a read.
+  lazy() reports a lazy entry's backing, size and gen, and install() hands
+  it a loaded buffer, taking it only if that entry is unchanged
+  every create/write sets dirty and bumps gen; blkfs clears dirty with
+  mark_clean() once that generation is on disk
 */
 #pragma once
 #include <stddef.h>
@@ -18,12 +25,27 @@ struct Entry {
     size_t   size;
     bool     used;
     bool     is_dir;
+    uint32_t backing;
+    bool     dirty;
+    uint32_t gen;
 };
 
+using Loader = bool (*)(uint32_t backing, void* buf, size_t size);
+
 void  init();
 
 bool  create(const char* name, const void* data, size_t size);
 
+bool  create_lazy(const char* name, size_t size, uint32_t backing);
+
+void  set_loader(Loader fn);
+
+bool  lazy(const char* name, uint32_t& backing, size_t& size, uint32_t& gen);
+
+bool  install(const char* name, uint32_t gen, uint32_t backing, uint8_t* buf);
+
+bool  load  (const char* name);
+
 int   read  (const char* name, void* buf, size_t len);
 
 int   write (const char* name, const void* buf, size_t len);
@@ -43,4 +65,6 @@ bool  exists_dir(const char* name);
 
 const Entry* table();
 
+void  mark_clean(size_t slot, uint32_t gen);
+
 }
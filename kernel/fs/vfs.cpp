@@ -1,39 +1,61 @@
 /*
   vfs.cpp - thin virtual filesystem dispatch layer
-  all calls currently forward to ramfs
+  proc and everything below it goes to procfs, all other paths to ramfs
   open/read/write/list_dir/remove - if a real disk backend is added it would plug in here
 */
 #include "kernel/fs/vfs.hpp"
 #include "kernel/fs/ramfs.hpp"
+#include "kernel/fs/procfs.hpp"
 
 namespace vfs {
 
 bool open(const char* path, int ) {
+    if (procfs::owns(path)) return procfs::exists(path);
     return ramfs::exists(path);
 }
 
 int read(const char* path, void* buf, size_t len) {
+    if (procfs::owns(path)) return procfs::read(path, buf, len);
     return ramfs::read(path, buf, len);
 }
 
 int write(const char* path, const void* buf, size_t len) {
+    if (procfs::owns(path)) return -1;
     return ramfs::write(path, buf, len);
 }
 
 bool exists(const char* path) {
+    if (procfs::owns(path)) return procfs::exists(path);
     return ramfs::exists(path);
 }
 
 void ls(void (*cb)(const char* name, size_t size, bool is_dir)) {
     ramfs::ls(cb);
+    procfs::ls(cb);
 }
 
 void ls_in(const char* dir, void (*cb)(const char* name, size_t size, bool is_dir)) {
+    if (procfs::owns(dir)) {
+        procfs::ls_in(dir, cb);
+        return;
+    }
     ramfs::ls_in(dir, cb);
+    if (!dir || !dir[0]) procfs::ls_in(dir, cb);
 }
 
 bool mkdir(const char* path) {
+    if (procfs::owns(path)) return false;
     return ramfs::mkdir(path);
 }
 
+bool remove(const char* path) {
+    if (procfs::owns(path)) return false;
+    return ramfs::remove(path);
+}
+
+bool is_dir(const char* path) {
+    if (procfs::owns(path)) return procfs::is_dir(path);
+    return ramfs::exists_dir(path);
+}
+
 }
@@ -1,7 +1,8 @@
 /*
   vfs.hpp - virtual filesystem interface
-  open/read/write/list_dir/remove/mkdir/exists
+  open/read/write/list_dir/remove/mkdir/exists/is_dir
   flat path convention for now, no symlinks or permissions
+  paths under proc/ are generated by procfs and are read-only
 */
 #pragma once
 #include <stddef.h>
@@ -28,4 +29,8 @@ void   ls_in (const char* dir,
 
 bool   mkdir (const char* path);
 
+bool   remove(const char* path);
+
+bool   is_dir(const char* path);
+
 }
@@ -2,9 +2,14 @@
   draw.cpp - software rasterizer writing directly to the vgpu framebuffer
   fill_rect, draw_hline, draw_vline, draw_rect, draw_char, draw_text, blit, blit_alpha
   pixel format is bgra (b8g8r8x8)
+  every primitive honours the calling core's row clip from set_clip_rows(),
+  which is how wm::render draws screen bands on several cores at once
+  blit is wrapped in a pmu scope so perfstat can report what it costs
 */
 #include "kernel/gfx/draw.hpp"
 #include "kernel/drivers/virtio/gpu.hpp"
+#include "kernel/sched/smp.hpp"
+#include "kernel/core/pmu.hpp"
 #include <stdint.h>
 
 namespace gfx {
@@ -13,19 +18,47 @@ static inline uint32_t* fb()         { return vgpu::framebuffer(); }
 static inline uint32_t  scr_w()      { return vgpu::width();       }
 static inline uint32_t  scr_h()      { return vgpu::height();      }
 
+static pmu::Counter g_pmu_blit("gfx::blit");
+
+static uint32_t g_clip_y0[smp::MAX_CPUS];
+static uint32_t g_clip_y1[smp::MAX_CPUS];
+
 static inline uint32_t clamp(uint32_t v, uint32_t hi) {
     return (v < hi) ? v : hi;
 }
 
+static inline void clip_rows(uint32_t& lo, uint32_t& hi) {
+    uint32_t c = smp::cpu_id();
+    lo = 0;
+    hi = scr_h();
+    if (g_clip_y1[c]) {
+        lo = g_clip_y0[c];
+        hi = clamp(g_clip_y1[c], hi);
+    }
+}
+
+void set_clip_rows(uint32_t y0, uint32_t y1) {
+    uint32_t c = smp::cpu_id();
+    g_clip_y0[c] = y0;
+    g_clip_y1[c] = y1;
+}
+
 void draw_pixel(uint32_t x, uint32_t y, uint32_t color) {
+    uint32_t lo, hi;
+    clip_rows(lo, hi);
+    if (y < lo || y >= hi) return;
     fb()[y * scr_w() + x] = color;
 }
 
 void fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) {
     uint32_t fw = scr_w(), fh = scr_h();
     if (x >= fw || y >= fh || !w || !h) return;
+    uint32_t lo, hi;
+    clip_rows(lo, hi);
     uint32_t x2 = clamp(x + w, fw);
-    uint32_t y2 = clamp(y + h, fh);
+    uint32_t y2 = clamp(y + h, hi);
+    if (y < lo) y = lo;
+    if (y >= y2) return;
     uint32_t* row = fb() + y * fw + x;
     uint32_t  rw  = x2 - x;
     for (uint32_t j = y; j < y2; ++j, row += fw) {
@@ -59,12 +92,17 @@ void blit(const uint32_t* src,
 void blit_stride(const uint32_t* src, uint32_t src_stride_px,
                  uint32_t dst_x, uint32_t dst_y,
                  uint32_t w, uint32_t h) {
+    pmu::Scope ps(g_pmu_blit);
     uint32_t fw = scr_w(), fh = scr_h();
     if (dst_x >= fw || dst_y >= fh || !w || !h) return;
     uint32_t copy_w = ((dst_x + w) <= fw) ? w : (fw - dst_x);
     uint32_t copy_h = ((dst_y + h) <= fh) ? h : (fh - dst_y);
+    uint32_t lo, hi;
+    clip_rows(lo, hi);
+    uint32_t j0 = (dst_y < lo) ? lo - dst_y : 0u;
+    uint32_t j1 = (dst_y < hi) ? clamp(hi - dst_y, copy_h) : 0u;
     uint32_t* dst_row = fb() + dst_y * fw + dst_x;
-    for (uint32_t j = 0; j < copy_h; ++j) {
+    for (uint32_t j = j0; j < j1; ++j) {
         const uint32_t* sr = src + j * src_stride_px;
         uint32_t*       dr = dst_row + j * fw;
         for (uint32_t i = 0; i < copy_w; ++i)
@@ -82,8 +120,12 @@ void blit_alpha(const uint32_t* src, uint32_t bg_color,
     uint32_t bg_b = (bg_color      ) & 0xFFu;
     uint32_t bg_g = (bg_color >>  8) & 0xFFu;
     uint32_t bg_r = (bg_color >> 16) & 0xFFu;
+    uint32_t lo, hi;
+    clip_rows(lo, hi);
+    uint32_t j0 = (dst_y < lo) ? lo - dst_y : 0u;
+    uint32_t j1 = (dst_y < hi) ? clamp(hi - dst_y, copy_h) : 0u;
     uint32_t* dst_row = fb() + dst_y * fw + dst_x;
-    for (uint32_t j = 0; j < copy_h; ++j) {
+    for (uint32_t j = j0; j < j1; ++j) {
         const uint32_t* sr = src + j * w;
         uint32_t*       dr = dst_row + j * fw;
         for (uint32_t i = 0; i < copy_w; ++i) {
@@ -2,6 +2,8 @@
   draw.hpp - software rasterizer interface
   all coordinates are pixel-space, top-left origin
   color format: bgra b8g8r8x8 - use gfx::rgb(r,g,b) to build values
+  set_clip_rows(y0, y1) limits drawing on the calling core to rows [y0, y1);
+  set_clip_rows(0, 0) removes the clip
 */
 #pragma once
 #include <stdint.h>
@@ -21,6 +23,8 @@ static constexpr uint32_t BLUE    = 0x000000FFu;
 static constexpr uint32_t GRAY    = 0x00808080u;
 static constexpr uint32_t DARKGRAY= 0x00303030u;
 
+void set_clip_rows(uint32_t y0, uint32_t y1);
+
 void draw_pixel(uint32_t x, uint32_t y, uint32_t color);
 
 void fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color);
@@ -1,8 +1,23 @@
 /*
   main.cpp - this is the kernel entry point
-  boots everything in order: uart, mmu, heap, ramfs, gic, timer, virtio
-  devices, gpu, wm, keyboard, tablet, then drops into the main event loop
-  the event loop polls input, ticks all active apps, and rerenders at ~33hz
+  boots everything in order: uart, mmu, heap, ramfs, gic, timer, scheduler,
+  kworker, coroutine runtime, secondary cores, virtio devices, gpu, wm, keyboard,
+  tablet, then becomes the input thread; the disk loads in the background
+  and on_disk_loaded seeds the default files if it was blank
+  the uart goes interrupt-driven once the gic and timer are up; without a
+  gpu the input thread runs the shell over serial only
+  the input thread sleeps until the virtio or uart irq handlers queue events, feeds
+  them to the wm, wakes the apps whose windows got input and hands finished
+  command lines to the shell thread. the compositor thread sleeps until a
+  frame is requested or the clock needs updating and renders at most ~33hz
+  the apps each run on their own thread, see dispatch.cpp
+  each boot phase ends with a bootlog mark; the first frame is left to the
+  compositor so it overlaps input device init and the disk table read, and
+  finishing it fixes time-to-desktop and prints the timeline
+  bench=<suite> in bootargs runs bench::run() once the devices and wm are
+  up, instead of the gui loop, then powers off
+  while inputrec replays a recording, live input is dropped and the
+  recorded events go through the same paths; any live key stops it
 */
 #include "kernel/core/print.hpp"
 #include "kernel/core/panic.hpp"
@@ -10,6 +25,17 @@
 #include "kernel/mm/mmu.hpp"
 #include "kernel/irq/gic.hpp"
 #include "kernel/irq/timer.hpp"
+#include "kernel/irq/work.hpp"
+#include "kernel/core/dispatch.hpp"
+#include "kernel/sched/sched.hpp"
+#include "kernel/sched/smp.hpp"
+#include "kernel/core/co.hpp"
+#include "kernel/core/pmu.hpp"
+#include "kernel/core/bootlog.hpp"
+#include "kernel/core/bench.hpp"
+#include "kernel/core/inputrec.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/core/cpustat.hpp"
 #include "kernel/drivers/uart_pl011.hpp"
 #include "kernel/platform/fdt.hpp"
 #include "kernel/drivers/virtio/virtio_mmio.hpp"
@@ -26,12 +52,7 @@
 #include "kernel/drivers/virtio/tablet.hpp"
 #include "kernel/apps/editor.hpp"
 #include "kernel/apps/desktop.hpp"
-#include "kernel/apps/controlpanel.hpp"
-#include "kernel/apps/shellwin.hpp"
-#include "kernel/apps/calc.hpp"
-#include "kernel/apps/fileexplorer.hpp"
 #include "kernel/apps/sysmon.hpp"
-#include "kernel/apps/paint.hpp"
 #include "kernel/core/rtc.hpp"
 #include "arch/aarch64/regs.hpp"
 #include <stdint.h>
@@ -41,6 +62,7 @@ static constexpr uintptr_t VIRTIO_BASE = 0x0a000000u;
 static constexpr uintptr_t VIRTIO_STEP = 0x200u;
 
 static uintptr_t g_virtio[VIRTIO_MAX];
+static uint32_t  g_virtio_irq[VIRTIO_MAX];
 static int       g_nvirtio = 0;
 
 static void probe_virtio_fixed() {
@@ -78,6 +100,193 @@ static void print_prompt() {
     wm::term_puts("root@os:/");
     wm::term_puts(cwd);
     wm::term_puts(" $ ");
+    print("root@os:/");
+    print(cwd);
+    print(" $ ");
+}
+
+static constexpr uint64_t FRAME_NS = 30000000ull;
+
+static sched::WaitQueue g_input_wq;
+static sched::WaitQueue g_shell_wq;
+
+static char     g_line_buf[256];
+static uint32_t g_line_len   = 0;
+static bool     g_shell_busy = false;
+
+static char g_bench[32];
+static bool g_bench_mode = false;
+
+[[noreturn]] static void run_bench() {
+    while (blkfs::ready() && !blkfs::loaded())
+        sched::sleep_until(timer::now_ns() + 1000000ull);
+    bench::run(g_bench);
+    uart::flush_sync();
+
+    register uint64_t x0 asm("x0") = 0x84000008ULL;
+    asm volatile("hvc #0" :: "r"(x0) : "memory");
+    for (;;) asm volatile("wfi");
+}
+
+static void on_input_irq() {
+    sched::wake_all(g_input_wq);
+    co::input_event().set();
+}
+
+static void on_disk_loaded(bool loaded) {
+    bootlog::mark("disk table");
+    if (!loaded) {
+
+        static const char k_readme[] =
+            "AArch64 Bare-Metal OS\n"
+            "=====================\n"
+            "Files on this disk are persistent via virtio-blk.\n"
+            "Use 'sync' to save changes, or they autosave on exit.\n"
+            "\n"
+            "Commands: ls  cat  touch  rm  mkdir  cd  pwd  echo  clear  exit  help\n";
+        static const char k_motd[] =
+            "Welcome to AArch64 OS.\n"
+            "Type 'help' to list commands.\n";
+        ramfs::create("readme.txt", k_readme, sizeof(k_readme) - 1);
+        ramfs::create("motd.txt",   k_motd,   sizeof(k_motd)   - 1);
+        print("ramfs: seeded with default files\n");
+    }
+    if (blkfs::ready())
+        print(loaded ? "disk: loaded\n" : "disk: blank\n");
+}
+
+static void shell_key(char c) {
+    if (inputrec::recording()) inputrec::note_shell_key(c);
+    if (c == '\r' || c == '\n') {
+
+        g_line_buf[g_line_len < sizeof(g_line_buf) ? g_line_len : sizeof(g_line_buf) - 1] = '\0';
+        print("\n");
+        wm::term_putc('\n');
+        g_shell_busy = true;
+        sched::wake_all(g_shell_wq);
+    } else if (c == '\b' || c == 127) {
+
+        if (g_line_len > 0) {
+            print("\b \b");
+            wm::term_putc('\b');
+            --g_line_len;
+        }
+    } else if ((uint8_t)c >= 0x20u) {
+        uart::putc(c);
+        wm::term_putc(c);
+
+        if (g_line_len < (uint32_t)(sizeof(g_line_buf) - 1))
+            g_line_buf[g_line_len] = c;
+        ++g_line_len;
+    }
+}
+
+static void serial_keys() {
+    int c;
+    while (!g_shell_busy && (c = uart::getc()) >= 0) {
+        if (inputrec::recording())
+            inputrec::record_key({ read_cntpct_el0(), (char)c }, inputrec::Kind::Serial);
+        shell_key((char)c);
+    }
+}
+
+static void key_input(char c, uint64_t ts) {
+    if (wm::start_menu_wants_keys())
+        wm::start_menu_on_key(c);
+    else if (!wm::key_event(c, ts))
+        shell_key(c);
+}
+
+static bool replay_input() {
+    tablet::PointerEvent pev;
+    kbd::KeyEvent        kev;
+    bool abort = false;
+    while (tablet::next_event(pev)) {}
+    while (!g_shell_busy && kbd::next_event(kev)) abort |= kev.ch != 0;
+    while (!g_shell_busy && uart::getc() >= 0) abort = true;
+    if (abort) {
+        inputrec::stop_replay();
+        print("input: replay stopped by a key press\n");
+        return true;
+    }
+
+    bool any = false;
+    inputrec::Event ev;
+    while (inputrec::peek(ev)) {
+        uint64_t ts = read_cntpct_el0();
+        if (ev.kind == inputrec::Kind::Pointer) {
+            wm::mouse_update(ev.x, ev.y, ev.left, ev.right, ts);
+        } else {
+            if (g_shell_busy) break;
+            if (ev.kind == inputrec::Kind::Serial) shell_key(ev.ch);
+            else                                  key_input(ev.ch, ts);
+        }
+        inputrec::pop();
+        any = true;
+    }
+    return any;
+}
+
+static void shell_main(void*) {
+    cpustat::classify(cpustat::OTHER);
+    sched::lock_kernel();
+    for (;;) {
+        while (!g_shell_busy) sched::wait(g_shell_wq);
+
+        shell::execute(g_line_buf);
+        g_line_len = 0;
+        print_prompt();
+
+        g_shell_busy = false;
+        dispatch::redraw();
+        sched::wake_all(g_input_wq);
+    }
+}
+
+static void compositor_main(void*) {
+    char     status_buf[32];
+    uint64_t last_render_ns   = 0;
+    uint64_t last_tick_update = 0;
+    bool     was_editor       = false;
+
+    cpustat::classify(cpustat::COMPOSITOR);
+    sched::lock_kernel();
+    for (;;) {
+        bool dirty = dispatch::wait_redraw(timer::tick_to_ns(last_tick_update + 100));
+
+        uint64_t t = timer::ticks();
+        if (t - last_tick_update >= 100) {
+            last_tick_update = t;
+            fmt_clock(status_buf, t);
+            wm::set_status(status_buf);
+            dirty = true;
+        }
+
+        bool ed = editor::active();
+        if (was_editor && !ed) {
+            g_line_len = 0;
+            print_prompt();
+            dirty = true;
+        }
+        was_editor = ed;
+
+        if (!dirty) continue;
+
+        uint64_t due = last_render_ns + FRAME_NS;
+        if (timer::now_ns() < due) sched::sleep_until(due);
+        dispatch::take_redraw();
+
+        last_render_ns = timer::now_ns();
+        sysmon::record_frame();
+        framestat::begin();
+        wm::render_dirty();
+        framestat::end();
+
+        if (!bootlog::desktop_us()) {
+            bootlog::desktop();
+            bootlog::print();
+        }
+    }
 }
 
 extern "C" void kernel_main(void* dtb) {
@@ -87,9 +296,11 @@ extern "C" void kernel_main(void* dtb) {
     print("=====================================\n");
     print("  AArch64 OS boot\n");
     print("=====================================\n\n");
+    bootlog::mark("uart");
 
     mmu::init();
     print("mmu: enabled (caches on, guard page mapped)\n");
+    bootlog::mark("mmu");
 
     kheap::init();
     printk("heap: %u MiB available\n",
@@ -100,20 +311,40 @@ extern "C" void kernel_main(void* dtb) {
     kheap::free(ta);
     kheap::free(tb);
     print("heap: alloc/free self-test passed\n");
+    bootlog::mark("heap");
 
     ramfs::init();
+    bootlog::mark("ramfs");
 
-    gic::init();
+    gic::init(dtb);
+    bootlog::mark("gic");
 
     timer::init(100);
 
+    uart::init_irq();
+
     irq_enable();
     print("irq: enabled\n\n");
+    bootlog::mark("timer");
+
+    sched::init("input", sched::PRIO_INPUT);
+    cpustat::classify(cpustat::INPUT);
+    sched::lock_kernel();
+
+    work::init();
+    co::init();
+    bootlog::mark("sched");
+
+    pmu::init();
+    smp::init();
+    bootlog::mark("smp");
 
     int n = 0;
     if (fdt::valid(dtb)) {
-        n = fdt::collect_virtio_mmio_regs(dtb, g_virtio, VIRTIO_MAX);
+        n = fdt::collect_virtio_mmio_regs(dtb, g_virtio, VIRTIO_MAX, g_virtio_irq);
+        for (int i = 0; i < n; ++i) virtio::set_irq(g_virtio[i], g_virtio_irq[i]);
         printk("fdt: found %d virtio-mmio nodes\n", n);
+        g_bench_mode = fdt::bootarg(fdt::bootargs(dtb), "bench", g_bench, sizeof(g_bench));
     }
     if (n == 0) {
         print("fdt: fallback – probing fixed addresses\n");
@@ -121,76 +352,76 @@ extern "C" void kernel_main(void* dtb) {
         n = g_nvirtio;
     }
     printk("virtio: %d devices found\n", n);
+    bootlog::mark("virtio probe");
 
-    bool disk_loaded = blkfs::init(g_virtio, n);
-    if (!disk_loaded) {
-
-        static const char k_readme[] =
-            "AArch64 Bare-Metal OS\n"
-            "=====================\n"
-            "Files on this disk are persistent via virtio-blk.\n"
-            "Use 'sync' to save changes, or they autosave on exit.\n"
-            "\n"
-            "Commands: ls  cat  touch  rm  mkdir  cd  pwd  echo  clear  exit  help\n";
-        static const char k_motd[] =
-            "Welcome to AArch64 OS.\n"
-            "Type 'help' to list commands.\n";
-        ramfs::create("readme.txt", k_readme, sizeof(k_readme) - 1);
-        ramfs::create("motd.txt",   k_motd,   sizeof(k_motd)   - 1);
-        print("ramfs: seeded with default files\n");
-    }
+    blkfs::init(g_virtio, n, on_disk_loaded);
+    bootlog::mark("blkfs");
 
     if (!vgpu::init(g_virtio, n)) {
 
-        print("vgpu: no GPU found – serial-only mode\n");
-        print("kernel: entering idle  (tick prints every 5 s)\n\n");
-        uint64_t last = 0;
+        print("vgpu: no GPU found – serial-only mode\n\n");
+        if (g_bench_mode) run_bench();
+        uart::set_notify(on_input_irq);
+        sched::spawn("shell", shell_main, nullptr, sched::PRIO_APP);
+        bootlog::mark("shell");
+        bootlog::print();
+        print_prompt();
         for (;;) {
-            asm volatile("wfi");
-            uint64_t t = timer::ticks();
-            if (t - last >= 500) { last = t; printk("tick: %u\n", (unsigned)t); }
+            serial_keys();
+            uint64_t flags = irq_save();
+            if (g_shell_busy || !uart::pending())
+                sched::wait(g_input_wq);
+            irq_restore(flags);
         }
     }
 
+    bootlog::mark("gpu");
+
     wm::init(vgpu::width(), vgpu::height());
     printk("wm: terminal %u × %u chars\n", wm::term_cols(), wm::term_rows());
 
     desktop::init();
     rtc::init(timer::ticks());
+    bootlog::mark("wm");
+    if (g_bench_mode) run_bench();
 
-    wm::render();
+    sched::spawn("compositor", compositor_main, nullptr, sched::PRIO_UI);
+    dispatch::redraw();
 
     kbd::init(g_virtio, n);
-    if (kbd::ready()) {
-        print("kbd: ready\n");
-        wm::render_dirty();
-    }
+    if (kbd::ready()) print("kbd: ready\n");
 
     tablet::init(g_virtio, n, vgpu::width(), vgpu::height());
-    if (tablet::ready()) {
-        print("tablet: ready\n");
-        wm::render_dirty();
-    }
+    if (tablet::ready()) print("tablet: ready\n");
+    bootlog::mark("input");
 
-    if (blkfs::ready()) {
-        print(disk_loaded ? "disk: loaded\n" : "disk: blank\n");
-    } else {
+    if (!blkfs::ready())
         print("disk: none (volatile session)\n");
-    }
 
-    char     status_buf[32];
-    uint64_t last_render      = 0;
-    uint64_t last_tick_update = 0;
-    bool     dirty            = false;
-    uint32_t line_len         = 0;
-    static char line_buf[256];
-    int32_t  last_cx = -1, last_cy = -1;
+    kbd::set_notify(on_input_irq);
+    tablet::set_notify(on_input_irq);
+    uart::set_notify(on_input_irq);
+
+    sched::spawn("shell", shell_main, nullptr, sched::PRIO_APP);
+
+    int32_t last_cx = -1, last_cy = -1;
 
     for (;;) {
 
-        if (tablet::ready()) {
-            tablet::poll();
-            wm::mouse_update(tablet::cx(), tablet::cy(), tablet::btn_left(), tablet::btn_right());
+        bool dirty = false;
+
+        if (inputrec::replaying()) {
+            dirty = replay_input();
+        } else if (tablet::ready()) {
+            tablet::PointerEvent pev;
+            bool any = false;
+            while (tablet::next_event(pev)) {
+                if (inputrec::recording()) inputrec::record_pointer(pev);
+                wm::mouse_update(pev.x, pev.y, pev.left, pev.right, pev.ts);
+                any = true;
+            }
+            if (!any)
+                wm::mouse_update(tablet::cx(), tablet::cy(), tablet::btn_left(), tablet::btn_right());
 
             int32_t cx = tablet::cx(), cy = tablet::cy();
             if (cx != last_cx || cy != last_cy) {
@@ -200,73 +431,20 @@ extern "C" void kernel_main(void* dtb) {
             }
         }
 
-        if (kbd::ready()) {
-            bool was_editor = editor::active();
-            char c;
-            while ((c = kbd::getc_nb()) != 0) {
-                if (editor::active()) {
-
-                    editor::on_key(c);
-                } else if (calc::active()) {
-
-                    calc::on_key(c);
-                } else if (wm::start_menu_wants_keys()) {
-
-                    wm::start_menu_on_key(c);
-                } else {
-
-                    if (c == '\r' || c == '\n') {
-
-                        line_buf[line_len] = '\0';
-                        print("\n");
-                        wm::term_putc('\n');
-                        shell::execute(line_buf);
-                        line_len = 0;
-                        print_prompt();
-                    } else if (c == '\b' || c == 127) {
-
-                        if (line_len > 0) {
-                            print("\b \b");
-                            wm::term_putc('\b');
-                            --line_len;
-                        }
-                    } else if ((uint8_t)c >= 0x20u) {
-                        uart::putc(c);
-                        wm::term_putc(c);
-
-                        if (line_len < (uint32_t)(sizeof(line_buf) - 1))
-                            line_buf[line_len] = c;
-                        ++line_len;
-                    }
-                }
-                dirty = true;
-            }
-
-            if (was_editor && !editor::active()) {
-                line_len = 0;
-                print_prompt();
+        if (kbd::ready() && !g_shell_busy && kbd::pending()) {
+            kbd::KeyEvent kev;
+            while (!g_shell_busy && kbd::next_event(kev)) {
+                if (!kev.ch) continue;
+                if (inputrec::recording()) inputrec::record_key(kev);
+                key_input(kev.ch, kev.ts);
                 dirty = true;
             }
         }
 
-        uint64_t t = timer::ticks();
-
-        editor::tick(t);
-        if (editor::active()) dirty = true;
-
-        controlpanel::tick(t);
-
-        calc::tick(t);
-        if (calc::active()) dirty = true;
-
-        fileexplorer::tick(t);
-        if (fileexplorer::active()) dirty = true;
-
-        sysmon::tick(t);
-        if (sysmon::active()) dirty = true;
-
-        paint::tick(t);
-        if (paint::active()) dirty = true;
+        if (!g_shell_busy && uart::pending()) {
+            serial_keys();
+            dirty = true;
+        }
 
         if (wm::desktop_was_clicked()) {
             desktop::on_click(wm::desktop_click_x(), wm::desktop_click_y());
@@ -301,23 +479,16 @@ extern "C" void kernel_main(void* dtb) {
             }
         }
 
-        if (t - last_tick_update >= 100) {
-            last_tick_update = t;
-            fmt_clock(status_buf, t);
-            wm::set_status(status_buf);
-            dirty = true;
-        }
+        dispatch::poll_input();
+        if (dirty) dispatch::redraw();
 
-        shellwin::tick(t);
-        if (shellwin::active()) dirty = true;
-
-        if (dirty && (t - last_render >= 3)) {
-            last_render = t;
-            dirty       = false;
-            sysmon::record_frame();
-            wm::render_dirty();
+        uint64_t flags = irq_save();
+        if (inputrec::replaying() && !g_shell_busy) {
+            uint64_t due = inputrec::next_due_ns();
+            if (due > timer::now_ns()) sched::wait_until(g_input_wq, due);
+        } else if (!tablet::pending() && (g_shell_busy || (!kbd::pending() && !uart::pending()))) {
+            sched::wait(g_input_wq);
         }
-
-        asm volatile("wfi");
+        irq_restore(flags);
     }
 }
@@ -1,11 +1,22 @@
 /*
-  gic.cpp - gicv2 interrupt controller driver for qemu virt
-  distributor at 0x08000000, cpu interface at 0x08010000
+  gic.cpp - gic interrupt controller driver for qemu virt
+  init() reads the gic node from the dtb: gicv3 goes to the gicv3.cpp
+  backend, otherwise this file drives a gicv2 (distributor at 0x08000000,
+  cpu interface at 0x08010000 unless the dtb says otherwise)
   supports registering c handlers per irq line and dispatching from exception entry
+  the iar read raises the cpu interface's running priority to that of the
+  acknowledged irq, so dispatch can unmask irqs for the handler: only
+  strictly higher priority lines are signalled until the eoi drops it again.
+  elr/spsr are already in the frame vectors.S pushed, which is all a nested
+  entry would clobber
 */
 #include "kernel/irq/gic.hpp"
+#include "kernel/irq/gicv3.hpp"
+#include "kernel/platform/fdt.hpp"
 #include "kernel/core/panic.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/core/trace.hpp"
+#include "arch/aarch64/regs.hpp"
 #include <stdint.h>
 
 namespace gic {
@@ -13,6 +24,10 @@ namespace gic {
 static constexpr uintptr_t GICD_BASE = 0x08000000;
 static constexpr uintptr_t GICC_BASE = 0x08010000;
 
+static uintptr_t g_gicd = GICD_BASE;
+static uintptr_t g_gicc = GICC_BASE;
+static bool      g_v3   = false;
+
 static constexpr uint32_t GICD_CTLR        = 0x000;
 static constexpr uint32_t GICD_TYPER       = 0x004;
 static constexpr uint32_t GICD_IGROUPR0    = 0x080;
@@ -30,16 +45,64 @@ static constexpr uint32_t GICC_EOIR = 0x010;
 
 static constexpr uint32_t MAX_IRQ = 256;
 
-static Handler g_handlers[MAX_IRQ] = {};
+static Handler  g_handlers[MAX_IRQ] = {};
+static Stamp    g_stamps  [MAX_IRQ] = {};
+static uint32_t g_count   [MAX_IRQ] = {};
+static uint64_t g_max_lat [MAX_IRQ] = {};
+static uint64_t g_lat_sum [MAX_IRQ] = {};
+static uint32_t g_lat_n   [MAX_IRQ] = {};
+static uint64_t g_run_sum [MAX_IRQ] = {};
+static uint64_t g_max_run [MAX_IRQ] = {};
+static uint32_t g_hist    [MAX_IRQ][HIST_BUCKETS] = {};
+static uint64_t g_hist_lim[HIST_BUCKETS - 1] = {};
+static uint32_t g_spurious          = 0;
+static uint32_t g_nesting           = 0;
+static uint32_t g_max_nesting       = 0;
 
 static inline volatile uint32_t* gicd(uint32_t off) {
-    return reinterpret_cast<volatile uint32_t*>(GICD_BASE + off);
+    return reinterpret_cast<volatile uint32_t*>(g_gicd + off);
 }
 static inline volatile uint32_t* gicc(uint32_t off) {
-    return reinterpret_cast<volatile uint32_t*>(GICC_BASE + off);
+    return reinterpret_cast<volatile uint32_t*>(g_gicc + off);
+}
+
+static uint64_t to_ns(uint64_t ticks) {
+    uint64_t f = read_cntfrq_el0();
+    return f ? ticks * 1000000000ull / f : 0;
 }
 
-void init() {
+static void init_hist() {
+    uint64_t f = read_cntfrq_el0();
+    for (uint32_t b = 0; b < HIST_BUCKETS - 1; ++b) {
+        uint64_t lim = f * (1ull << (2 * b)) / 1000000u;
+        g_hist_lim[b] = lim ? lim : 1;
+    }
+}
+
+static inline uint32_t hist_bucket(uint64_t ticks) {
+    uint32_t b = 0;
+    while (b < HIST_BUCKETS - 1 && ticks >= g_hist_lim[b]) ++b;
+    return b;
+}
+
+void init(const void* dtb) {
+
+    init_hist();
+
+    fdt::GicInfo info;
+    if (fdt::find_gic(dtb, info)) {
+        g_v3   = info.version == 3;
+        g_gicd = info.dist;
+        g_gicc = info.cpu_or_redist;
+    }
+
+    if (g_v3) {
+        uint32_t n_irqs = v3::init(g_gicd, g_gicc);
+        init_cpu();
+        printk("gic: v3 init done (n_irqs=%u, system-register cpu interface)\n",
+               (unsigned)n_irqs);
+        return;
+    }
 
     *gicd(GICD_CTLR) = 0;
 
@@ -57,42 +120,58 @@ void init() {
     for (uint32_t i = 0; i < n_irqs; i++) {
 
         volatile uint8_t* prio = reinterpret_cast<volatile uint8_t*>(
-            GICD_BASE + GICD_IPRIORITYR0 + i);
-        *prio = 0xA0;
+            g_gicd + GICD_IPRIORITYR0 + i);
+        *prio = PRIO_DEFAULT;
 
         if (i >= 32) {
             volatile uint8_t* tgt = reinterpret_cast<volatile uint8_t*>(
-                GICD_BASE + GICD_ITARGETSR0 + i);
+                g_gicd + GICD_ITARGETSR0 + i);
             *tgt = 0x01;
         }
     }
 
     *gicd(GICD_CTLR) = 0x1;
 
+    init_cpu();
+
+    printk("gic: v2 init done (n_irqs=%u)\n", (unsigned)n_irqs);
+}
+
+void init_cpu() {
+
+    if (g_v3) {
+        if (!v3::init_cpu()) panic("gic: no redistributor for this cpu");
+        return;
+    }
+
+    *gicd(GICD_IGROUPR0)   = 0x00000000;
+    *gicd(GICD_ICENABLER0) = 0xFFFFFFFF;
+
     *gicc(GICC_PMR) = 0xFF;
 
     *gicc(GICC_BPR) = 0x00;
 
     *gicc(GICC_CTLR) = 0x1;
-
-    printk("gic: init done (n_irqs=%u)\n", (unsigned)n_irqs);
 }
 
 void enable_irq(uint32_t irq) {
     if (irq >= MAX_IRQ) return;
+    if (g_v3) { v3::enable_irq(irq); return; }
 
     *gicd(GICD_ISENABLER0 + (irq / 32) * 4) = (1u << (irq & 31));
 }
 
 void disable_irq(uint32_t irq) {
     if (irq >= MAX_IRQ) return;
+    if (g_v3) { v3::disable_irq(irq); return; }
     *gicd(GICD_ICENABLER0 + (irq / 32) * 4) = (1u << (irq & 31));
 }
 
 void set_priority(uint32_t irq, uint8_t prio) {
     if (irq >= MAX_IRQ) return;
+    if (g_v3) { v3::set_priority(irq, prio); return; }
     volatile uint8_t* p = reinterpret_cast<volatile uint8_t*>(
-        GICD_BASE + GICD_IPRIORITYR0 + irq);
+        g_gicd + GICD_IPRIORITYR0 + irq);
     *p = prio;
 }
 
@@ -101,23 +180,111 @@ void register_handler(uint32_t irq, Handler h) {
     g_handlers[irq] = h;
 }
 
+void set_raised_stamp(uint32_t irq, Stamp fn) {
+    if (irq >= MAX_IRQ) panic("gic: irq out of range", irq);
+    g_stamps[irq] = fn;
+}
+
+uint32_t count(uint32_t irq) {
+    return irq < MAX_IRQ ? g_count[irq] : 0;
+}
+
+uint64_t max_latency_ns(uint32_t irq) {
+    return irq < MAX_IRQ ? to_ns(g_max_lat[irq]) : 0;
+}
+
+bool stats(uint32_t irq, IrqStats& out) {
+    if (irq >= MAX_IRQ || !g_count[irq]) return false;
+
+    uint64_t flags = irq_save();
+    out.count       = g_count[irq];
+    out.lat_samples = g_lat_n[irq];
+    out.lat_sum_ns  = to_ns(g_lat_sum[irq]);
+    out.max_lat_ns  = to_ns(g_max_lat[irq]);
+    out.run_sum_ns  = to_ns(g_run_sum[irq]);
+    out.max_run_ns  = to_ns(g_max_run[irq]);
+    for (uint32_t b = 0; b < HIST_BUCKETS; ++b) out.hist[b] = g_hist[irq][b];
+    irq_restore(flags);
+    return true;
+}
+
+uint64_t hist_limit_ns(uint32_t bucket) {
+    return bucket < HIST_BUCKETS - 1 ? to_ns(g_hist_lim[bucket]) : 0;
+}
+
+uint32_t spurious() { return g_spurious; }
+
+uint32_t max_nesting() { return g_max_nesting; }
+
+void reset_stats() {
+    uint64_t flags = irq_save();
+    for (uint32_t i = 0; i < MAX_IRQ; ++i) {
+        g_count[i]   = 0;
+        g_max_lat[i] = 0;
+        g_lat_sum[i] = 0;
+        g_lat_n[i]   = 0;
+        g_run_sum[i] = 0;
+        g_max_run[i] = 0;
+        for (uint32_t b = 0; b < HIST_BUCKETS; ++b) g_hist[i][b] = 0;
+    }
+    g_spurious    = 0;
+    g_max_nesting = 0;
+    irq_restore(flags);
+}
+
+static inline uint32_t ack() {
+    return g_v3 ? v3::ack() : *gicc(GICC_IAR);
+}
+
+static inline void eoi(uint32_t iar) {
+    if (g_v3) v3::eoi(iar);
+    else      *gicc(GICC_EOIR) = iar;
+}
+
+uint32_t version() { return g_v3 ? 3 : 2; }
+
 extern "C" void dispatch() {
 
-    uint32_t iar = *gicc(GICC_IAR);
-    uint32_t irq = iar & 0x3FF;
+    uint32_t iar = ack();
+    uint32_t irq = g_v3 ? (iar & 0xFFFFFF) : (iar & 0x3FF);
 
-    if (irq == 1023) {
-        *gicc(GICC_EOIR) = iar;
+    if (irq >= 1020 && irq <= 1023) {
+        if (irq == 1023) ++g_spurious;
+        if (!g_v3) eoi(iar);
         return;
     }
 
-    if (irq < MAX_IRQ && g_handlers[irq]) {
-        g_handlers[irq]();
-    } else {
+    if (irq >= MAX_IRQ || !g_handlers[irq]) {
         printk("gic: unhandled irq %u\n", (unsigned)irq);
+        eoi(iar);
+        return;
+    }
+
+    ++g_count[irq];
+    uint64_t t0 = read_cntpct_el0();
+    if (g_stamps[irq]) {
+        uint64_t lat = t0 - g_stamps[irq]();
+        if ((int64_t)lat > 0) {
+            g_lat_sum[irq] += lat;
+            ++g_lat_n[irq];
+            if (lat > g_max_lat[irq]) g_max_lat[irq] = lat;
+        }
     }
+    if (++g_nesting > g_max_nesting) g_max_nesting = g_nesting;
+
+    uint64_t tt = trace::begin(trace::IRQ);
+    irq_enable();
+    g_handlers[irq]();
+    irq_disable();
+    trace::end(trace::IRQ, tt, irq);
+
+    uint64_t run = read_cntpct_el0() - t0;
+    g_run_sum[irq] += run;
+    if (run > g_max_run[irq]) g_max_run[irq] = run;
+    ++g_hist[irq][hist_bucket(run)];
 
-    *gicc(GICC_EOIR) = iar;
+    --g_nesting;
+    eoi(iar);
 }
 
 }
@@ -1,14 +1,38 @@
 /*
-  gic.hpp - gicv2 driver interface
+  gic.hpp - gic driver interface (gicv2 or gicv3, picked from the dtb)
   init, enable_irq, disable_irq, set_priority, register_handler
-  dispatch() is called by the irq vector in vectors.S
+  init(dtb) falls back to the gicv2 at the qemu virt addresses without a dtb
+  init_cpu() sets up the calling core's banked sgi/ppi state and cpu interface;
+  spis all target cpu 0, which is the only core that runs the scheduler
+  dispatch() is called by the irq vector in vectors.S; it unmasks irqs while
+  the handler runs, so an irq with a higher priority (numerically lower)
+  preempts a slower one. every line starts at PRIO_DEFAULT, drivers raise
+  theirs with set_priority: profiler > timer > input > block > gpu
+  set_raised_stamp() gives a line a function returning the cntpct value at
+  which it fired (the timer's cval); dispatch then tracks the average and
+  worst raise-to-handler latency for it
+  stats() also gives each line's handler run time as a histogram with
+  HIST_BUCKETS factor-of-4 buckets (<1us, <4us, ... <4ms, rest), including
+  any higher-priority handler nested inside it; spurious() counts acks that
+  returned intid 1023
 */
 #pragma once
 #include <stdint.h>
 
 namespace gic {
 
-  void init();
+  static constexpr uint8_t PRIO_PROF    = 0x20;
+  static constexpr uint8_t PRIO_TIMER   = 0x40;
+  static constexpr uint8_t PRIO_INPUT   = 0x60;
+  static constexpr uint8_t PRIO_BLOCK   = 0x80;
+  static constexpr uint8_t PRIO_GPU     = 0xA0;
+  static constexpr uint8_t PRIO_DEFAULT = 0xA0;
+
+  void init(const void* dtb = nullptr);
+
+  uint32_t version();
+
+  void init_cpu();
 
   void enable_irq(uint32_t irq);
 
@@ -19,5 +43,28 @@ namespace gic {
   using Handler = void (*)();
   void register_handler(uint32_t irq, Handler h);
 
+  using Stamp = uint64_t (*)();
+  void set_raised_stamp(uint32_t irq, Stamp fn);
+
+  static constexpr uint32_t HIST_BUCKETS = 8;
+
+  struct IrqStats {
+      uint32_t count;
+      uint32_t lat_samples;
+      uint64_t lat_sum_ns;
+      uint64_t max_lat_ns;
+      uint64_t run_sum_ns;
+      uint64_t max_run_ns;
+      uint32_t hist[HIST_BUCKETS];
+  };
+
+  uint32_t count(uint32_t irq);
+  uint64_t max_latency_ns(uint32_t irq);
+  bool     stats(uint32_t irq, IrqStats& out);
+  uint64_t hist_limit_ns(uint32_t bucket);
+  uint32_t spurious();
+  uint32_t max_nesting();
+  void     reset_stats();
+
   extern "C" void dispatch();
 }
@@ -0,0 +1,181 @@
+/*
+  gicv3.cpp - gicv3 distributor, redistributors and system-register cpu interface
+  runs with affinity routing on and a single security state (qemu virt
+  without secure=on), all lines in group 1. every spi is routed to the
+  boot cpu like the gicv2 path. each cpu finds its redistributor by
+  matching gicr_typer's affinity against its own mpidr, wakes it and keeps
+  its base in a per-cpu slot for the banked sgi/ppi registers
+  the icc_* registers are named by encoding so the assembler needs no
+  gicv3 feature flag
+*/
+#include "kernel/irq/gicv3.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/sched/smp.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+static constexpr uint32_t GICD_CTLR        = 0x0000;
+static constexpr uint32_t GICD_TYPER       = 0x0004;
+static constexpr uint32_t GICD_IGROUPR0    = 0x0080;
+static constexpr uint32_t GICD_ISENABLER0  = 0x0100;
+static constexpr uint32_t GICD_ICENABLER0  = 0x0180;
+static constexpr uint32_t GICD_IPRIORITYR0 = 0x0400;
+static constexpr uint32_t GICD_IROUTER0    = 0x6000;
+
+static constexpr uint32_t CTLR_ENABLE_G0 = 1u << 0;
+static constexpr uint32_t CTLR_ENABLE_G1 = 1u << 1;
+static constexpr uint32_t CTLR_ARE       = 1u << 4;
+static constexpr uint32_t CTLR_RWP       = 1u << 31;
+
+static constexpr uint32_t GICR_STRIDE      = 0x20000;
+static constexpr uint32_t GICR_SGI         = 0x10000;
+static constexpr uint32_t GICR_TYPER       = 0x0008;
+static constexpr uint32_t GICR_WAKER       = 0x0014;
+static constexpr uint32_t GICR_IGROUPR0    = 0x0080;
+static constexpr uint32_t GICR_ISENABLER0  = 0x0100;
+static constexpr uint32_t GICR_ICENABLER0  = 0x0180;
+static constexpr uint32_t GICR_IPRIORITYR0 = 0x0400;
+
+static constexpr uint64_t TYPER_LAST   = 1ull << 4;
+static constexpr uint32_t WAKER_SLEEP  = 1u << 1;
+static constexpr uint32_t WAKER_ASLEEP = 1u << 2;
+static constexpr uint32_t MAX_REDIST   = 64;
+
+static constexpr uint32_t MAX_IRQ = 256;
+
+static uintptr_t g_dist = 0;
+static uintptr_t g_redist_base = 0;
+static uintptr_t g_rd[smp::MAX_CPUS];
+
+static inline volatile uint32_t* reg32(uintptr_t base, uint32_t off) {
+    return reinterpret_cast<volatile uint32_t*>(base + off);
+}
+static inline volatile uint64_t* reg64(uintptr_t base, uint32_t off) {
+    return reinterpret_cast<volatile uint64_t*>(base + off);
+}
+static inline volatile uint8_t* reg8(uintptr_t base, uint32_t off) {
+    return reinterpret_cast<volatile uint8_t*>(base + off);
+}
+
+static void dist_wait_rwp() {
+    while (*reg32(g_dist, GICD_CTLR) & CTLR_RWP) {}
+}
+
+static uint64_t mpidr() {
+    return SYSREG_READ(mpidr_el1);
+}
+
+static uint32_t mpidr_to_typer_aff(uint64_t m) {
+    return (uint32_t)(((m >> 32) & 0xFF) << 24) | (uint32_t)(m & 0xFFFFFF);
+}
+
+static uint64_t mpidr_to_irouter(uint64_t m) {
+    return m & 0xFF00FFFFFFull;
+}
+
+static uintptr_t find_redist() {
+    uint32_t aff = mpidr_to_typer_aff(mpidr());
+    uintptr_t rd = g_redist_base;
+    for (uint32_t i = 0; i < MAX_REDIST; ++i, rd += GICR_STRIDE) {
+        uint64_t typer = *reg64(rd, GICR_TYPER);
+        if ((uint32_t)(typer >> 32) == aff) return rd;
+        if (typer & TYPER_LAST) break;
+    }
+    return 0;
+}
+
+static uintptr_t cur_sgi() {
+    return g_rd[smp::cpu_id()] + GICR_SGI;
+}
+
+}
+
+namespace gic::v3 {
+
+uint32_t init(uintptr_t dist, uintptr_t redist) {
+    g_dist        = dist;
+    g_redist_base = redist;
+
+    *reg32(g_dist, GICD_CTLR) = 0;
+    dist_wait_rwp();
+
+    uint32_t typer  = *reg32(g_dist, GICD_TYPER);
+    uint32_t n_irqs = ((typer & 0x1F) + 1) * 32;
+    if (n_irqs > MAX_IRQ) n_irqs = MAX_IRQ;
+
+    for (uint32_t i = 1; i < n_irqs / 32; ++i) {
+        *reg32(g_dist, GICD_IGROUPR0   + i * 4) = 0xFFFFFFFF;
+        *reg32(g_dist, GICD_ICENABLER0 + i * 4) = 0xFFFFFFFF;
+    }
+    dist_wait_rwp();
+
+    uint64_t route = mpidr_to_irouter(mpidr());
+    for (uint32_t i = 32; i < n_irqs; ++i) {
+        *reg8(g_dist, GICD_IPRIORITYR0 + i)   = gic::PRIO_DEFAULT;
+        *reg64(g_dist, GICD_IROUTER0 + i * 8) = route;
+    }
+
+    *reg32(g_dist, GICD_CTLR) = CTLR_ARE;
+    dist_wait_rwp();
+    *reg32(g_dist, GICD_CTLR) = CTLR_ARE | CTLR_ENABLE_G1 | CTLR_ENABLE_G0;
+    dist_wait_rwp();
+
+    return n_irqs;
+}
+
+bool init_cpu() {
+    uintptr_t rd = find_redist();
+    if (!rd) return false;
+    g_rd[smp::cpu_id()] = rd;
+
+    uint32_t w = *reg32(rd, GICR_WAKER);
+    *reg32(rd, GICR_WAKER) = w & ~WAKER_SLEEP;
+    while (*reg32(rd, GICR_WAKER) & WAKER_ASLEEP) {}
+
+    uintptr_t sgi = rd + GICR_SGI;
+    *reg32(sgi, GICR_IGROUPR0)   = 0xFFFFFFFF;
+    *reg32(sgi, GICR_ICENABLER0) = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < 32; ++i)
+        *reg8(sgi, GICR_IPRIORITYR0 + i) = gic::PRIO_DEFAULT;
+
+    SYSREG_WRITE(S3_0_C12_C12_5, SYSREG_READ(S3_0_C12_C12_5) | 1u);
+    isb();
+    SYSREG_WRITE(S3_0_C4_C6_0,   0xFF);
+    SYSREG_WRITE(S3_0_C12_C12_3, 0);
+    SYSREG_WRITE(S3_0_C12_C12_7, 1);
+    isb();
+    return true;
+}
+
+void enable_irq(uint32_t irq) {
+    if (irq >= MAX_IRQ) return;
+    if (irq < 32) *reg32(cur_sgi(), GICR_ISENABLER0) = 1u << irq;
+    else          *reg32(g_dist, GICD_ISENABLER0 + (irq / 32) * 4) = 1u << (irq & 31);
+}
+
+void disable_irq(uint32_t irq) {
+    if (irq >= MAX_IRQ) return;
+    if (irq < 32) *reg32(cur_sgi(), GICR_ICENABLER0) = 1u << irq;
+    else          *reg32(g_dist, GICD_ICENABLER0 + (irq / 32) * 4) = 1u << (irq & 31);
+}
+
+void set_priority(uint32_t irq, uint8_t prio) {
+    if (irq >= MAX_IRQ) return;
+    if (irq < 32) *reg8(cur_sgi(), GICR_IPRIORITYR0 + irq) = prio;
+    else          *reg8(g_dist,    GICD_IPRIORITYR0 + irq) = prio;
+}
+
+uint32_t ack() {
+    uint32_t iar = (uint32_t)SYSREG_READ(S3_0_C12_C12_0);
+    dsb_sy();
+    return iar;
+}
+
+void eoi(uint32_t iar) {
+    SYSREG_WRITE(S3_0_C12_C12_1, iar);
+    isb();
+}
+
+}
@@ -0,0 +1,26 @@
+/*
+  gicv3.hpp - gicv3 backend used by gic.cpp
+  the distributor routes spis by affinity, each cpu has its own
+  redistributor for sgis/ppis, and the cpu interface is the icc_* system
+  registers instead of an mmio page
+*/
+#pragma once
+#include <stdint.h>
+
+namespace gic::v3 {
+
+uint32_t init(uintptr_t dist, uintptr_t redist);
+
+bool init_cpu();
+
+void enable_irq(uint32_t irq);
+
+void disable_irq(uint32_t irq);
+
+void set_priority(uint32_t irq, uint8_t prio);
+
+uint32_t ack();
+
+void eoi(uint32_t iar);
+
+}
@@ -1,7 +1,13 @@
 /*
-  timer.cpp - arm generic timer at 100hz
-  uses cntp_tval_el0 (physical non-secure) which fires at gic ppi 30
-  increments a tick counter each irq. one tick = 10ms
+  timer.cpp - tickless arm generic timer
+  ticks() and now_ns() are computed from cntpct, so nothing interrupts just
+  to count time. one-shot timers live on a 4-level hashed wheel (64 slots per
+  level, 1ms granularity at level 0, cascading down as time advances) and
+  cntp_cval is programmed for the earliest pending deadline only, so a far
+  timer causes no wakeups before it is due. advance() catches the wheel up
+  when the irq comes, stepping one jiffy at a time only while level 0 holds
+  timers and otherwise jumping straight to the next boundary of the lowest
+  occupied level. with no timers pending the comparator is switched off
 */
 #include "kernel/irq/timer.hpp"
 #include "kernel/irq/gic.hpp"
@@ -14,51 +20,289 @@ namespace timer {
 static constexpr uint32_t TIMER_IRQ = 30;
 
 static constexpr uint64_t CTL_ENABLE  = (1u << 0);
-[[maybe_unused]] static constexpr uint64_t CTL_IMASK   = (1u << 1);
+static constexpr uint64_t CTL_IMASK   = (1u << 1);
 [[maybe_unused]] static constexpr uint64_t CTL_ISTATUS = (1u << 2);
 
-static uint64_t          g_ticks_per_irq = 0;
-static uint64_t volatile g_tick_count    = 0;
+static constexpr uint64_t NS_PER_SEC = 1000000000ull;
+static constexpr uint64_t JIFFY_NS   = 1000000ull;
 
-static void on_tick() {
-    g_tick_count = g_tick_count + 1;
+static constexpr uint32_t WHEEL_BITS = 6;
+static constexpr uint32_t WHEEL_SIZE = 1u << WHEEL_BITS;
+static constexpr uint32_t WHEEL_MASK = WHEEL_SIZE - 1u;
+static constexpr uint32_t LEVELS     = 4;
+static constexpr uint32_t MAX_TIMERS = 64;
 
-    write_cntp_tval_el0(g_ticks_per_irq);
+struct Timer {
+    uint64_t deadline;
+    Callback cb;
+    void*    arg;
+    Timer*   prev;
+    Timer*   next;
+    uint16_t gen;
+    uint8_t  level;
+    uint8_t  slot;
+    bool     used;
+};
+
+static uint64_t g_freq         = 0;
+static uint64_t g_cnt_per_tick = 0;
+static uint64_t g_base_cnt     = 0;
+
+static Timer    g_pool[MAX_TIMERS];
+static Timer*   g_wheel[LEVELS][WHEEL_SIZE];
+static uint32_t g_level_count[LEVELS];
+static uint32_t g_count = 0;
+static uint64_t g_cur   = 0;
+
+static void (*g_free_hook)() = nullptr;
+
+static uint64_t freq() {
+    if (!g_freq) g_freq = read_cntfrq_el0();
+    return g_freq;
+}
+
+static uint64_t cnt_to_ns(uint64_t c) {
+    uint64_t f = freq();
+    if (!f) return 0;
+    return (c / f) * NS_PER_SEC + (c % f) * NS_PER_SEC / f;
+}
+
+static uint64_t ns_to_cnt(uint64_t ns) {
+    uint64_t f = freq();
+    return (ns / NS_PER_SEC) * f + ((ns % NS_PER_SEC) * f + NS_PER_SEC - 1u) / NS_PER_SEC;
+}
+
+static void link(Timer* t) {
+    uint64_t j = t->deadline / JIFFY_NS;
+    if (j < g_cur) j = g_cur;
+    uint64_t delta = j - g_cur;
+
+    uint32_t lv = 0;
+    while (lv + 1u < LEVELS && delta >= (1ull << (WHEEL_BITS * (lv + 1u))))
+        ++lv;
+    if (lv == LEVELS - 1u) {
+        uint64_t span = 1ull << (WHEEL_BITS * LEVELS);
+        if (delta >= span) j = g_cur + span - 1u;
+    }
+
+    uint32_t slot = (uint32_t)(j >> (WHEEL_BITS * lv)) & WHEEL_MASK;
+    t->level = (uint8_t)lv;
+    t->slot  = (uint8_t)slot;
+    t->prev  = nullptr;
+    t->next  = g_wheel[lv][slot];
+    if (t->next) t->next->prev = t;
+    g_wheel[lv][slot] = t;
+    ++g_level_count[lv];
+}
+
+static void unlink(Timer* t) {
+    if (t->prev) t->prev->next = t->next;
+    else         g_wheel[t->level][t->slot] = t->next;
+    if (t->next) t->next->prev = t->prev;
+    t->prev = t->next = nullptr;
+    --g_level_count[t->level];
+}
+
+static uint32_t cascade(uint32_t lv) {
+    uint32_t idx = (uint32_t)(g_cur >> (WHEEL_BITS * lv)) & WHEEL_MASK;
+    Timer* t = g_wheel[lv][idx];
+    while (t) {
+        Timer* nx = t->next;
+        unlink(t);
+        link(t);
+        t = nx;
+    }
+    return idx;
+}
+
+static void expire_slot(uint32_t slot, uint64_t now, Timer*& expired) {
+    Timer* t = g_wheel[0][slot];
+    while (t) {
+        Timer* nx = t->next;
+        if (t->deadline <= now) {
+            unlink(t);
+            t->next = expired;
+            expired = t;
+        }
+        t = nx;
+    }
+}
+
+static void advance(uint64_t now, Timer*& expired) {
+    uint64_t now_j = now / JIFFY_NS;
+    if (g_count == 0) {
+        if (now_j > g_cur) g_cur = now_j;
+        return;
+    }
+    for (;;) {
+        expire_slot((uint32_t)g_cur & WHEEL_MASK, now, expired);
+        if (g_cur >= now_j) break;
+
+        uint64_t step = 1;
+        if (!g_level_count[0]) {
+            uint32_t lv = 1;
+            while (lv + 1u < LEVELS && !g_level_count[lv]) ++lv;
+            uint64_t span = 1ull << (WHEEL_BITS * lv);
+            step = span - (g_cur & (span - 1u));
+            if (g_cur + step > now_j) {
+                g_cur = now_j;
+                continue;
+            }
+        }
+        g_cur += step;
+        if ((g_cur & WHEEL_MASK) == 0) {
+            for (uint32_t lv = 1; lv < LEVELS; ++lv)
+                if (cascade(lv) != 0) break;
+        }
+    }
+}
+
+static uint64_t next_expiry() {
+    if (!g_count) return 0;
+
+    uint64_t best = 0;
+    for (uint32_t i = 0; i < MAX_TIMERS; ++i)
+        if (g_pool[i].used && (!best || g_pool[i].deadline < best))
+            best = g_pool[i].deadline;
+    return best;
+}
+
+static void program() {
+    uint64_t next = next_expiry();
+    if (!next) {
+        write_cntp_ctl_el0(CTL_IMASK);
+        isb();
+        return;
+    }
+    write_cntp_cval_el0(ns_to_cnt(next));
+    write_cntp_ctl_el0(CTL_ENABLE);
+    isb();
+}
+
+static void release(Timer* t) {
+    t->used = false;
+    t->gen  = (uint16_t)(t->gen + 1u);
+    --g_count;
+}
+
+static void on_irq() {
+    Timer* expired = nullptr;
+    advance(now_ns(), expired);
+
+    Callback cbs [MAX_TIMERS];
+    void*    args[MAX_TIMERS];
+    uint32_t n = 0;
+    while (expired) {
+        Timer* t = expired;
+        expired  = t->next;
+        t->next  = nullptr;
+        cbs[n]   = t->cb;
+        args[n]  = t->arg;
+        ++n;
+        release(t);
+    }
+    for (uint32_t i = 0; i < n; ++i)
+        if (cbs[i]) cbs[i](args[i]);
+    if (n && g_free_hook) g_free_hook();
+    program();
 }
 
 void init(uint32_t hz) {
-    uint64_t freq = read_cntfrq_el0();
-    if (freq == 0) {
+    uint64_t f = freq();
+    if (f == 0) {
         print("timer: CNTFRQ is 0 – cannot initialise\n");
         return;
     }
 
-    g_ticks_per_irq = freq / hz;
+    g_cnt_per_tick = f / hz;
+    g_base_cnt     = read_cntpct_el0();
+    g_cur          = now_ns() / JIFFY_NS;
 
-    printk("timer: freq=%u Hz  ticks_per_irq=%u  target_hz=%u\n",
-           (unsigned)freq, (unsigned)g_ticks_per_irq, (unsigned)hz);
+    printk("timer: freq=%u Hz  tick=%u cnt (%u Hz units), tickless\n",
+           (unsigned)f, (unsigned)g_cnt_per_tick, (unsigned)hz);
 
-    gic::register_handler(TIMER_IRQ, on_tick);
-    gic::set_priority(TIMER_IRQ, 0x40);
+    gic::register_handler(TIMER_IRQ, on_irq);
+    gic::set_raised_stamp(TIMER_IRQ, read_cntp_cval_el0);
+    gic::set_priority(TIMER_IRQ, gic::PRIO_TIMER);
     gic::enable_irq(TIMER_IRQ);
 
-    write_cntp_tval_el0(g_ticks_per_irq);
-    write_cntp_ctl_el0(CTL_ENABLE);
+    write_cntp_ctl_el0(CTL_IMASK);
     isb();
 
     print("timer: init done\n");
 }
 
 uint64_t ticks() {
-    return g_tick_count;
+    if (!g_cnt_per_tick) return 0;
+    return (read_cntpct_el0() - g_base_cnt) / g_cnt_per_tick;
+}
+
+uint64_t now_ns() {
+    return cnt_to_ns(read_cntpct_el0());
+}
+
+uint64_t tick_to_ns(uint64_t tick) {
+    return cnt_to_ns(g_base_cnt + tick * g_cnt_per_tick);
 }
 
 void sleep_ms(uint32_t ms) {
-    uint64_t freq    = read_cntfrq_el0();
-    uint64_t target  = read_cntpct_el0() + (freq / 1000) * ms;
+    uint64_t target  = read_cntpct_el0() + (freq() / 1000) * ms;
     while (read_cntpct_el0() < target) {
         asm volatile("nop");
     }
 }
 
+int add(uint64_t deadline_ns, Callback cb, void* arg) {
+    uint64_t flags = irq_save();
+
+    int idx = -1;
+    for (uint32_t i = 0; i < MAX_TIMERS; ++i)
+        if (!g_pool[i].used) { idx = (int)i; break; }
+    if (idx < 0) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    if (g_count == 0) {
+        uint64_t nj = now_ns() / JIFFY_NS;
+        if (nj > g_cur) g_cur = nj;
+    }
+
+    Timer& t = g_pool[idx];
+    t.deadline = deadline_ns;
+    t.cb       = cb;
+    t.arg      = arg;
+    t.used     = true;
+    link(&t);
+    ++g_count;
+    program();
+
+    int id = (int)(((uint32_t)t.gen << 8) | (uint32_t)idx);
+    irq_restore(flags);
+    return id;
+}
+
+bool cancel(int id) {
+    if (id < 0) return false;
+    uint32_t idx = (uint32_t)id & 0xFFu;
+    uint16_t gen = (uint16_t)((uint32_t)id >> 8);
+    if (idx >= MAX_TIMERS) return false;
+
+    uint64_t flags = irq_save();
+    Timer& t = g_pool[idx];
+    if (!t.used || t.gen != gen) {
+        irq_restore(flags);
+        return false;
+    }
+    unlink(&t);
+    release(&t);
+    program();
+    irq_restore(flags);
+    return true;
+}
+
+uint32_t pending() { return g_count; }
+
+void set_free_hook(void (*fn)()) { g_free_hook = fn; }
+
 }
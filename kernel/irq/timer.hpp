@@ -1,15 +1,34 @@
 /*
   timer.hpp - arm generic timer interface
-  init(hz) sets up the tick rate, ticks() returns elapsed count, sleep_ms() busy-waits
+  init(hz) sets the unit of ticks(), which is derived from cntpct and needs no irq
+  now_ns() is a nanosecond clock, sleep_ms() busy-waits
+  add(deadline_ns, cb) arms a one-shot timer on the wheel, cancel() removes it;
+  the hardware only interrupts when the earliest pending timer is due
+  set_free_hook() registers a function run in the timer irq after expired
+  timers have been released, for callers waiting on a full pool
 */
 #pragma once
 #include <stdint.h>
 
 namespace timer {
 
+  using Callback = void (*)(void* arg);
+
   void init(uint32_t hz);
 
   uint64_t ticks();
 
+  uint64_t now_ns();
+
+  uint64_t tick_to_ns(uint64_t tick);
+
   void sleep_ms(uint32_t ms);
+
+  int  add(uint64_t deadline_ns, Callback cb, void* arg = nullptr);
+
+  bool cancel(int id);
+
+  void set_free_hook(void (*fn)());
+
+  uint32_t pending();
 }
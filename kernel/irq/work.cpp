@@ -0,0 +1,131 @@
+/*
+  work.cpp - softirq and kworker queues
+  each level is an intrusive lock-free lifo: queue() pushes with a cas and
+  the drainer takes the whole list with one exchange, then reverses it so
+  items run in the order they were queued. run_softirq() is only entered
+  from irq_entry on cpu 0 and never nests: an irq taken while it drains
+  just queues more work, which the same drain picks up. after
+  MAX_ROUNDS passes the rest is left to kworker so a storm cannot pin the
+  cpu in irq context; kworker raises the same in-softirq flag while it runs
+  softirq items so the two never drain at once
+*/
+#include "kernel/irq/work.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/sched/sched.hpp"
+#include "kernel/core/panic.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+static constexpr uint32_t MAX_ROUNDS = 8;
+
+static work::Item*      g_head[work::LEVELS] = {};
+static work::Stats      g_stats[work::LEVELS] = {};
+static volatile bool    g_in_softirq = false;
+static sched::WaitQueue g_kworker_wq;
+
+static bool pending(uint32_t lvl) {
+    return __atomic_load_n(&g_head[lvl], __ATOMIC_ACQUIRE) != nullptr;
+}
+
+static bool drain(uint32_t lvl) {
+    work::Item* list = __atomic_exchange_n(&g_head[lvl], nullptr, __ATOMIC_ACQUIRE);
+    if (!list) return false;
+
+    work::Item* fifo = nullptr;
+    while (list) {
+        work::Item* nx = list->next;
+        list->next = fifo;
+        fifo       = list;
+        list       = nx;
+    }
+
+    work::Stats& st = g_stats[lvl];
+    while (fifo) {
+        work::Item* it = fifo;
+        fifo = it->next;
+
+        uint64_t lat = timer::now_ns() - it->queued_ns;
+        st.total_lat_ns += lat;
+        if (lat > st.max_lat_ns) st.max_lat_ns = lat;
+        __atomic_sub_fetch(&st.depth, 1u, __ATOMIC_RELAXED);
+        ++st.ran;
+
+        __atomic_store_n(&it->queued, 0, __ATOMIC_RELEASE);
+        it->fn(it->arg);
+    }
+    return true;
+}
+
+static void kworker_main(void*) {
+    for (;;) {
+        uint64_t flags = irq_save();
+        while (!pending(0) && !pending(1) && !pending(2))
+            sched::wait(g_kworker_wq);
+        irq_restore(flags);
+
+        flags = irq_save();
+        g_in_softirq = true;
+        irq_restore(flags);
+        drain((uint32_t)work::Level::High);
+        drain((uint32_t)work::Level::Normal);
+        g_in_softirq = false;
+
+        drain((uint32_t)work::Level::Thread);
+    }
+}
+
+}
+
+namespace work {
+
+void init() {
+    if (!sched::spawn("kworker", kworker_main, nullptr, sched::PRIO_WORK))
+        panic("work: kworker spawn failed");
+}
+
+bool queue(Item& it) {
+    if (__atomic_exchange_n(&it.queued, 1, __ATOMIC_ACQ_REL)) return false;
+
+    uint32_t lvl = (uint32_t)it.level;
+    Stats&   st  = g_stats[lvl];
+    it.queued_ns = timer::now_ns();
+
+    Item* old = __atomic_load_n(&g_head[lvl], __ATOMIC_RELAXED);
+    do {
+        it.next = old;
+    } while (!__atomic_compare_exchange_n(&g_head[lvl], &old, &it, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_add_fetch(&st.queued, 1u, __ATOMIC_RELAXED);
+    uint32_t d = __atomic_add_fetch(&st.depth, 1u, __ATOMIC_RELAXED);
+    if (d > st.max_depth) st.max_depth = d;
+
+    if (it.level == Level::Thread) sched::wake_all(g_kworker_wq);
+    return true;
+}
+
+void run_softirq() {
+    if (g_in_softirq) return;
+    if (!pending((uint32_t)Level::High) && !pending((uint32_t)Level::Normal)) return;
+    g_in_softirq = true;
+
+    for (uint32_t round = 0; round < MAX_ROUNDS; ++round) {
+        irq_enable();
+        bool any  = drain((uint32_t)Level::High);
+        any      |= drain((uint32_t)Level::Normal);
+        irq_disable();
+        if (!any) break;
+    }
+
+    g_in_softirq = false;
+    if (pending((uint32_t)Level::High) || pending((uint32_t)Level::Normal))
+        sched::wake_all(g_kworker_wq);
+}
+
+Stats stats(Level lvl) {
+    return g_stats[(uint32_t)lvl];
+}
+
+}
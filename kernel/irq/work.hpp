@@ -0,0 +1,49 @@
+/*
+  work.hpp - deferred work for irq handlers
+  a handler acks its device and queue()s a work Item instead of doing the
+  work with interrupts masked. High and Normal items run in softirq context:
+  at the end of irq_entry with interrupts re-enabled, High first. Thread
+  items run on the "kworker" thread and may sleep; they do not hold the
+  kernel lock unless they take it
+  an Item is queued at most once; queueing it again before it has run is a
+  no-op, so one item per device is enough
+  stats() reports per-level queue depth and the latency from queue() to run
+*/
+#pragma once
+#include <stdint.h>
+
+namespace work {
+
+enum class Level : uint8_t { High, Normal, Thread };
+
+static constexpr uint32_t LEVELS = 3;
+
+using Fn = void (*)(void* arg);
+
+struct Item {
+    Fn       fn;
+    void*    arg;
+    Level    level;
+    uint8_t  queued    = 0;
+    uint64_t queued_ns = 0;
+    Item*    next      = nullptr;
+};
+
+struct Stats {
+    uint32_t queued;
+    uint32_t ran;
+    uint32_t depth;
+    uint32_t max_depth;
+    uint64_t total_lat_ns;
+    uint64_t max_lat_ns;
+};
+
+void init();
+
+bool queue(Item& it);
+
+void run_softirq();
+
+Stats stats(Level lvl);
+
+}
@@ -3,9 +3,13 @@
   manages a 16mib region defined by __heap_start/__heap_end in the linker script
   supports arbitrary power-of-two alignment, splitting on alloc, and coalescing on free
   every block has a magic value so we can catch corruption
+  alloc runs inside a pmu scope so perfstat can report what it costs
+  bits 8-15 of an allocated block's flags hold its owner tag
 */
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/panic.hpp"
+#include "kernel/core/pmu.hpp"
+#include "kernel/sched/sched.hpp"
 #include <stdint.h>
 
 extern "C" uint8_t __heap_start[];
@@ -16,6 +20,7 @@ namespace kheap {
 static constexpr uint32_t MAGIC     = 0xB10CB10Cu;
 static constexpr size_t   HDR_SIZE  = 32;
 static constexpr size_t   MIN_SPLIT = HDR_SIZE + 16;
+static constexpr uint32_t OWNER_SHIFT = 8;
 
 struct Block {
     uint32_t magic;
@@ -26,8 +31,11 @@ struct Block {
 };
 static_assert(sizeof(Block) == HDR_SIZE, "Block header size mismatch");
 
+static pmu::Counter g_pmu_alloc("kheap::alloc");
+
 static Block*  g_start = nullptr;
 static size_t  g_used  = 0;
+static size_t  g_owner_used[OWNERS];
 
 void init() {
     uintptr_t start = (uintptr_t)__heap_start;
@@ -47,6 +55,7 @@ void init() {
 
 void* alloc(size_t bytes, size_t align) {
     if (!g_start) panic("heap: not initialised");
+    pmu::Scope ps(g_pmu_alloc);
     if (bytes == 0) bytes = 1;
 
     bytes = (bytes + 15u) & ~size_t(15u);
@@ -92,8 +101,11 @@ void* alloc(size_t bytes, size_t align) {
             b->size     = bytes;
         }
 
-        b->flags = 0;
+        sched::Thread* cur = sched::current();
+        uint32_t owner = cur && cur->heap_owner < OWNERS ? cur->heap_owner : 0u;
+        b->flags = owner << OWNER_SHIFT;
         g_used  += b->size;
+        g_owner_used[owner] += b->size;
         return reinterpret_cast<void*>(reinterpret_cast<uint8_t*>(b) + HDR_SIZE);
     }
 
@@ -110,6 +122,7 @@ void free(void* ptr) {
     if (b->flags & 1)
         panic("heap: double free", reinterpret_cast<uintptr_t>(ptr));
 
+    g_owner_used[(b->flags >> OWNER_SHIFT) & (OWNERS - 1u)] -= b->size;
     b->flags = 1;
     g_used  -= b->size;
 
@@ -132,6 +145,10 @@ void free(void* ptr) {
 
 size_t used_bytes() { return g_used; }
 
+size_t owner_bytes(uint32_t owner) {
+    return owner < OWNERS ? g_owner_used[owner] : 0;
+}
+
 size_t free_bytes() {
     size_t total = 0;
     for (Block* b = g_start; b; b = b->next)
@@ -2,9 +2,12 @@
   heap.hpp - kernel heap allocator interface
   kheap::alloc(bytes, align) and kheap::free(ptr)
   also provides placement new operators so you can do: new (kheap_tag) Foo()
+  each block is tagged with the allocating thread's heap_owner (0 = kernel)
+  and owner_bytes() reports what each tag currently holds
 */
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
 namespace kheap {
 
@@ -16,6 +19,10 @@ namespace kheap {
 
   size_t used_bytes();
   size_t free_bytes();
+
+  static constexpr uint32_t OWNERS = 32;
+
+  size_t owner_bytes(uint32_t owner);
 }
 
 struct KHeapTag {};
@@ -4,6 +4,7 @@
   ram (0x40000000-0x7fffffff) as normal wb cached
   carves out a guard page below the stack bottom so stack overflow triggers a fault
   after mmu::init() instruction and data caches are on
+  secondary cores call init_secondary() to switch on the same tables
 */
 #include "kernel/mm/mmu.hpp"
 #include "kernel/core/panic.hpp"
@@ -83,9 +84,7 @@ static void build_tables() {
 
 namespace mmu {
 
-void init() {
-
-    build_tables();
+static void enable() {
 
     asm volatile("dsb sy" ::: "memory");
     asm volatile("isb"    ::: "memory");
@@ -117,10 +116,18 @@ void init() {
            | (1ULL << 12);
     asm volatile("msr sctlr_el1, %0" :: "r"(sctlr) : "memory");
     asm volatile("isb" ::: "memory");
+}
 
+void init() {
+    build_tables();
+    enable();
     g_enabled = true;
 }
 
+void init_secondary() {
+    enable();
+}
+
 bool enabled() { return g_enabled; }
 
 }
@@ -9,6 +9,8 @@ namespace mmu {
 
 void init();
 
+void init_secondary();
+
 bool enabled();
 
 }
@@ -1,8 +1,11 @@
 /*
   fdt.cpp - minimal flattened device tree scanner
   qemu passes the dtb address in x0 at boot
-  we only care about one thing: finding virtio-mmio node base addresses
-  if no dtb or it looks bad, the caller falls back to probing fixed addresses
+  we only care about finding virtio-mmio node base addresses, which gic
+  the machine has and the kernel command line in /chosen; regs are read as
+  two-cell address / two-cell size pairs and interrupts as gic
+  (type, number, flags) triples
+  if no dtb or it looks bad, the caller falls back to fixed addresses
 */
 #include "kernel/platform/fdt.hpp"
 #include <stdint.h>
@@ -60,7 +63,8 @@ bool valid(const void* dtb) {
     return be32(dtb) == FDT_MAGIC;
 }
 
-int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max) {
+int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max,
+                             uint32_t* irqs) {
     if (!valid(dtb)) return 0;
     if (max <= 0)    return 0;
 
@@ -79,6 +83,7 @@ int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max) {
     bool     in_virtio   = false;
     uint64_t node_reg    = 0;
     bool     have_reg    = false;
+    uint32_t node_irq    = 0;
 
     int      node_depth  = 0;
     int      virtio_depth = -1;
@@ -93,6 +98,7 @@ int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max) {
         switch (token) {
         case FDT_BEGIN_NODE: {
             node_depth++;
+            if (!in_virtio) node_irq = 0;
 
             while (*p) ++p;
             ++p;
@@ -102,11 +108,13 @@ int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max) {
             if (in_virtio && node_depth == virtio_depth) {
 
                 if (have_reg && found < max) {
+                    if (irqs) irqs[found] = node_irq;
                     out[found++] = (uintptr_t)node_reg;
                 }
                 in_virtio    = false;
                 have_reg     = false;
                 node_reg     = 0;
+                node_irq     = 0;
                 virtio_depth = -1;
             }
             node_depth--;
@@ -138,6 +146,9 @@ int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max) {
                     node_reg = be32(val);
                     have_reg = true;
                 }
+            } else if (streq(prop_name, "interrupts") && prop_len >= 8) {
+
+                node_irq = (be32(val) == 0 ? 32u : 16u) + be32(val + 4);
             }
             break;
         }
@@ -154,4 +165,155 @@ done:
     return found;
 }
 
+bool find_gic(const void* dtb, GicInfo& out) {
+    if (!valid(dtb)) return false;
+
+    const uint8_t* base = static_cast<const uint8_t*>(dtb);
+
+    auto hdr = [&](uint32_t off) { return be32(base + off); };
+    const uint8_t* strings = base + hdr(12);
+    const uint8_t* p       = base + hdr(8);
+    const uint8_t* p_end   = p + hdr(36);
+
+    int            node_depth = 0;
+    int            gic_depth  = -1;
+    uint32_t       version    = 0;
+    const uint8_t* reg        = nullptr;
+    uint32_t       reg_len    = 0;
+
+    while (p < p_end) {
+        p = align4(p);
+        if (p >= p_end) break;
+
+        uint32_t token = be32(p);
+        p += 4;
+
+        if ((token == FDT_BEGIN_NODE || token == FDT_END_NODE) && gic_depth == node_depth) {
+            if (!reg || reg_len < 32) return false;
+            auto cell64 = [&](uint32_t off) {
+                return ((uint64_t)be32(reg + off) << 32) | be32(reg + off + 4);
+            };
+            out.version       = version;
+            out.dist          = (uintptr_t)cell64(0);
+            out.cpu_or_redist = (uintptr_t)cell64(16);
+            return true;
+        }
+
+        switch (token) {
+        case FDT_BEGIN_NODE:
+            node_depth++;
+            while (*p) ++p;
+            ++p;
+            reg = nullptr;
+            break;
+        case FDT_END_NODE:
+            node_depth--;
+            break;
+        case FDT_PROP: {
+            uint32_t prop_len     = be32(p); p += 4;
+            uint32_t prop_nameoff = be32(p); p += 4;
+            const uint8_t* val    = p;
+            p += prop_len;
+
+            const char* prop_name =
+                reinterpret_cast<const char*>(strings + prop_nameoff);
+
+            if (streq(prop_name, "compatible") && gic_depth < 0) {
+                if (compat_contains(val, prop_len, "arm,gic-v3")) {
+                    version   = 3;
+                    gic_depth = node_depth;
+                } else if (compat_contains(val, prop_len, "arm,cortex-a15-gic") ||
+                           compat_contains(val, prop_len, "arm,gic-400")) {
+                    version   = 2;
+                    gic_depth = node_depth;
+                }
+            } else if (streq(prop_name, "reg")) {
+                reg     = val;
+                reg_len = prop_len;
+            }
+            break;
+        }
+        case FDT_NOP:
+            break;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+const char* bootargs(const void* dtb) {
+    if (!valid(dtb)) return nullptr;
+
+    const uint8_t* base = static_cast<const uint8_t*>(dtb);
+
+    auto hdr = [&](uint32_t off) { return be32(base + off); };
+    const uint8_t* strings = base + hdr(12);
+    const uint8_t* p       = base + hdr(8);
+    const uint8_t* p_end   = p + hdr(36);
+
+    int  node_depth = 0;
+    bool in_chosen  = false;
+
+    while (p < p_end) {
+        p = align4(p);
+        if (p >= p_end) break;
+
+        uint32_t token = be32(p);
+        p += 4;
+
+        switch (token) {
+        case FDT_BEGIN_NODE:
+            node_depth++;
+            in_chosen = node_depth == 2 && streq(reinterpret_cast<const char*>(p), "chosen");
+            while (*p) ++p;
+            ++p;
+            break;
+        case FDT_END_NODE:
+            if (in_chosen) return nullptr;
+            node_depth--;
+            break;
+        case FDT_PROP: {
+            uint32_t prop_len     = be32(p); p += 4;
+            uint32_t prop_nameoff = be32(p); p += 4;
+            const uint8_t* val    = p;
+            p += prop_len;
+
+            const char* prop_name =
+                reinterpret_cast<const char*>(strings + prop_nameoff);
+
+            if (in_chosen && prop_len > 0 && streq(prop_name, "bootargs"))
+                return reinterpret_cast<const char*>(val);
+            break;
+        }
+        case FDT_NOP:
+            break;
+        default:
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+bool bootarg(const char* args, const char* key, char* out, uint32_t max) {
+    if (!args || !key || !out || max == 0) return false;
+
+    const char* p = args;
+    while (*p) {
+        while (*p == ' ') ++p;
+        const char* k = key;
+        const char* w = p;
+        while (*k && *w == *k) { ++w; ++k; }
+        if (!*k && *w == '=') {
+            ++w;
+            uint32_t i = 0;
+            while (*w && *w != ' ' && i + 1 < max) out[i++] = *w++;
+            out[i] = '\0';
+            return true;
+        }
+        while (*p && *p != ' ') ++p;
+    }
+    return false;
+}
+
 }
@@ -2,6 +2,13 @@
   fdt.hpp - fdt/dtb scanner interface
   valid() checks if a pointer looks like a real dtb
   collect_virtio_mmio_regs() pulls out the base addresses of all virtio,mmio nodes
+  and, when irqs is given, each node's interrupt id from its interrupts
+  property (32 + n for spi n, 16 + n for ppi n, 0 if the node has none)
+  find_gic() reports the interrupt controller: version 2 with the distributor
+  and cpu interface bases, or version 3 with the distributor and the first
+  redistributor region
+  bootargs() returns the /chosen/bootargs string (qemu -append) or nullptr;
+  bootarg() copies the value of one key=value word out of it
 */
 #pragma once
 #include <stdint.h>
@@ -10,6 +17,19 @@ namespace fdt {
 
 bool valid(const void* dtb);
 
-int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max);
+int collect_virtio_mmio_regs(const void* dtb, uintptr_t* out, int max,
+                             uint32_t* irqs = nullptr);
+
+struct GicInfo {
+    uint32_t  version;
+    uintptr_t dist;
+    uintptr_t cpu_or_redist;
+};
+
+bool find_gic(const void* dtb, GicInfo& out);
+
+const char* bootargs(const void* dtb);
+
+bool bootarg(const char* args, const char* key, char* out, uint32_t max);
 
 }
@@ -0,0 +1,142 @@
+/*
+  pool.cpp - chase-lev work-stealing deques, one per core
+  the owning core pushes and pops at the bottom, thieves take from the top
+  with a cas. cpu 0 can be preempted, so its owner-side operations run with
+  irqs masked; jobs of different callers may share a deque since each job
+  carries its own completion counter. workers sleep in wfe and a push ends
+  with sev
+*/
+#include "kernel/sched/pool.hpp"
+#include "kernel/sched/smp.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+static constexpr int64_t DEQUE_SIZE = 256;
+static constexpr int64_t DEQUE_MASK = DEQUE_SIZE - 1;
+
+struct Group {
+    uint32_t remaining;
+};
+
+struct Job {
+    pool::Fn fn;
+    void*    arg;
+    uint32_t index;
+    Group*   group;
+};
+
+struct alignas(64) Deque {
+    int64_t  top;
+    int64_t  bottom;
+    uint64_t run;
+    uint64_t stolen;
+    Job      jobs[DEQUE_SIZE];
+};
+
+static Deque g_dq[smp::MAX_CPUS];
+
+static bool push(Deque& d, const Job& j) {
+    int64_t b = __atomic_load_n(&d.bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&d.top,    __ATOMIC_ACQUIRE);
+    if (b - t >= DEQUE_SIZE) return false;
+    d.jobs[b & DEQUE_MASK] = j;
+    __atomic_store_n(&d.bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool pop(Deque& d, Job& j) {
+    int64_t b = __atomic_load_n(&d.bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d.bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&d.top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        __atomic_store_n(&d.bottom, b + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    j = d.jobs[b & DEQUE_MASK];
+    if (t == b) {
+        bool won = __atomic_compare_exchange_n(&d.top, &t, t + 1, false,
+                                               __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&d.bottom, b + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+static bool steal(Deque& d, Job& j) {
+    int64_t t = __atomic_load_n(&d.top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&d.bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) return false;
+    j = d.jobs[t & DEQUE_MASK];
+    return __atomic_compare_exchange_n(&d.top, &t, t + 1, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static bool take(uint32_t cpu, Job& j) {
+    uint64_t flags = irq_save();
+    bool got = pop(g_dq[cpu], j);
+    irq_restore(flags);
+    if (got) return true;
+
+    for (uint32_t k = 1; k < smp::MAX_CPUS; ++k) {
+        uint32_t victim = (cpu + k) % smp::MAX_CPUS;
+        if (steal(g_dq[victim], j)) {
+            __atomic_add_fetch(&g_dq[cpu].stolen, 1u, __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run(uint32_t cpu, const Job& j) {
+    j.fn(j.arg, j.index);
+    __atomic_add_fetch(&g_dq[cpu].run, 1u, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&j.group->remaining, 1u, __ATOMIC_RELEASE);
+}
+
+}
+
+namespace pool {
+
+void parallel_for(uint32_t n, Fn fn, void* arg) {
+    if (n == 0) return;
+    if (smp::online() <= 1 || n == 1) {
+        for (uint32_t i = 0; i < n; ++i) fn(arg, i);
+        return;
+    }
+
+    uint32_t cpu = smp::cpu_id();
+    Group    g   = { n };
+
+    for (uint32_t i = 0; i < n; ++i) {
+        Job j = { fn, arg, i, &g };
+        uint64_t flags = irq_save();
+        bool queued = push(g_dq[cpu], j);
+        irq_restore(flags);
+        if (!queued) run(cpu, j);
+    }
+    asm volatile("dsb ish\n\tsev" ::: "memory");
+
+    while (__atomic_load_n(&g.remaining, __ATOMIC_ACQUIRE)) {
+        Job j;
+        if (take(cpu, j)) run(cpu, j);
+        else              asm volatile("yield");
+    }
+}
+
+void worker(uint32_t cpu) {
+    for (;;) {
+        Job j;
+        if (take(cpu, j)) run(cpu, j);
+        else              asm volatile("wfe");
+    }
+}
+
+uint64_t jobs_run(uint32_t cpu) { return cpu < smp::MAX_CPUS ? g_dq[cpu].run    : 0; }
+uint64_t steals(uint32_t cpu)   { return cpu < smp::MAX_CPUS ? g_dq[cpu].stolen : 0; }
+
+}
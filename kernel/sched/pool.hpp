@@ -0,0 +1,23 @@
+/*
+  pool.hpp - work-stealing job pool across all online cores
+  parallel_for() queues fn(arg, i) for every i < n on the calling core's
+  deque, helps run jobs until all of them finished and then returns. idle
+  cores steal from the top of other cores' deques. jobs run without the
+  kernel lock and with no scheduler underneath, so they must only touch
+  data that no other job of the same call touches
+*/
+#pragma once
+#include <stdint.h>
+
+namespace pool {
+
+using Fn = void (*)(void* arg, uint32_t index);
+
+void parallel_for(uint32_t n, Fn fn, void* arg);
+
+[[noreturn]] void worker(uint32_t cpu);
+
+uint64_t jobs_run(uint32_t cpu);
+uint64_t steals(uint32_t cpu);
+
+}
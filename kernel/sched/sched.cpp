@@ -0,0 +1,452 @@
+/*
+  sched.cpp - priority round-robin scheduler
+  every thread's context is the 272-byte register frame from vectors.S:
+  irq entry saves it on the interrupted stack and irq_exit() may hand back a
+  different thread's frame, while voluntary switches build the same frame in
+  arch_switch. scheduler state is only touched with irqs masked (one cpu)
+  dead threads are reaped on the next spawn, under the kernel lock
+  each switch hands cpustat the incoming thread's accounting class
+  when the timer pool is full, wait_until() fails at once as a timeout and
+  a slice that cannot be armed ends at the next irq instead
+*/
+#include "kernel/sched/sched.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/core/panic.hpp"
+#include "kernel/core/print.hpp"
+#include "kernel/core/cpustat.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <string.h>
+#include <stdint.h>
+
+extern "C" void arch_switch(uint64_t* save_sp, uint64_t next_sp);
+extern "C" [[noreturn]] void sched_thread_entry(sched::Thread* t);
+
+namespace {
+
+using sched::Thread;
+using sched::WaitQueue;
+using sched::State;
+
+static constexpr uint64_t SLICE_NS     = 10000000ull;
+static constexpr uint32_t FRAME_BYTES  = 272u;
+static constexpr uint64_t SPSR_EL1H_AF = 0x145u;
+
+static Thread   g_boot;
+static Thread*  g_cur  = nullptr;
+static Thread*  g_idle = nullptr;
+static Thread*  g_all  = nullptr;
+static Thread*  g_rq_head[sched::PRIO_COUNT];
+static Thread*  g_rq_tail[sched::PRIO_COUNT];
+static bool     g_need_resched = false;
+static uint32_t g_irq_depth    = 0;
+static int      g_slice_timer  = -1;
+static uint32_t g_slice_misses = 0;
+static uint32_t g_next_id      = 0;
+static uint64_t g_run_since    = 0;
+
+static Thread*   g_bkl_owner = nullptr;
+static uint32_t  g_bkl_depth = 0;
+static WaitQueue g_bkl_wq;
+
+static void rq_push(Thread* t) {
+    t->state = State::Ready;
+    t->next  = nullptr;
+    if (g_rq_tail[t->prio]) g_rq_tail[t->prio]->next = t;
+    else                    g_rq_head[t->prio]       = t;
+    g_rq_tail[t->prio] = t;
+}
+
+static Thread* rq_pop() {
+    for (int p = sched::PRIO_COUNT - 1; p >= 0; --p) {
+        Thread* t = g_rq_head[p];
+        if (!t) continue;
+        g_rq_head[p] = t->next;
+        if (!g_rq_head[p]) g_rq_tail[p] = nullptr;
+        t->next = nullptr;
+        return t;
+    }
+    return g_idle;
+}
+
+static bool any_ready() {
+    for (uint32_t p = 0; p < sched::PRIO_COUNT; ++p)
+        if (g_rq_head[p]) return true;
+    return false;
+}
+
+static void wq_push(WaitQueue& wq, Thread* t) {
+    t->next    = nullptr;
+    t->waiting = &wq;
+    if (wq.tail) wq.tail->next = t;
+    else         wq.head       = t;
+    wq.tail = t;
+}
+
+static Thread* wq_pop(WaitQueue& wq) {
+    Thread* t = wq.head;
+    if (!t) return nullptr;
+    wq.head = t->next;
+    if (!wq.head) wq.tail = nullptr;
+    t->next    = nullptr;
+    t->waiting = nullptr;
+    return t;
+}
+
+static void wq_remove(WaitQueue& wq, Thread* t) {
+    Thread* prev = nullptr;
+    for (Thread* c = wq.head; c; prev = c, c = c->next) {
+        if (c != t) continue;
+        if (prev) prev->next = c->next;
+        else      wq.head    = c->next;
+        if (wq.tail == c) wq.tail = prev;
+        c->next    = nullptr;
+        c->waiting = nullptr;
+        return;
+    }
+}
+
+static void on_slice(void*) {
+    g_slice_timer  = -1;
+    g_need_resched = true;
+}
+
+static void arm_slice() {
+    if (g_slice_timer >= 0) timer::cancel(g_slice_timer);
+    g_slice_timer = -1;
+    if (g_cur == g_idle) return;
+    if (!g_rq_head[g_cur->prio]) return;
+    g_slice_timer = timer::add(timer::now_ns() + SLICE_NS, on_slice);
+    if (g_slice_timer >= 0) return;
+    if (g_slice_misses++ == 0)
+        print("sched: timer pool full, slices end at the next irq\n");
+    g_need_resched = true;
+}
+
+static void make_ready(Thread* t) {
+    rq_push(t);
+    if (!g_cur) return;
+    if (g_cur == g_idle || t->prio > g_cur->prio)
+        g_need_resched = true;
+    else if (t->prio == g_cur->prio && g_slice_timer < 0)
+        arm_slice();
+}
+
+static void charge_run(Thread* prev) {
+    uint64_t now = read_cntpct_el0();
+    prev->cpu_ticks += now - g_run_since;
+    g_run_since = now;
+}
+
+static void switch_away() {
+    Thread* prev = g_cur;
+    Thread* next = rq_pop();
+    if (next == prev) {
+        prev->state = State::Running;
+        return;
+    }
+    charge_run(prev);
+    g_cur = next;
+    next->state = State::Running;
+    ++next->switches;
+    cpustat::enter(next->acct);
+    arm_slice();
+    arch_switch(&prev->sp, next->sp);
+}
+
+static void bkl_take(uint32_t depth) {
+    while (g_bkl_owner && g_bkl_owner != g_cur) {
+        g_cur->state = State::Blocked;
+        wq_push(g_bkl_wq, g_cur);
+        switch_away();
+    }
+    g_bkl_owner = g_cur;
+    g_bkl_depth = depth;
+}
+
+static uint32_t bkl_drop() {
+    if (g_bkl_owner != g_cur) return 0;
+    uint32_t depth = g_bkl_depth;
+    g_bkl_owner = nullptr;
+    g_bkl_depth = 0;
+    if (Thread* w = wq_pop(g_bkl_wq)) make_ready(w);
+    return depth;
+}
+
+static void sleep_current() {
+    uint32_t depth = bkl_drop();
+    switch_away();
+    if (depth) bkl_take(depth);
+}
+
+static void maybe_preempt() {
+    if (!g_cur || g_irq_depth || !g_need_resched) return;
+    uint64_t flags = irq_save();
+    g_need_resched = false;
+    if (g_cur != g_idle) rq_push(g_cur);
+    switch_away();
+    irq_restore(flags);
+}
+
+static void on_wait_timeout(void* arg) {
+    Thread* t = static_cast<Thread*>(arg);
+    if (t->state != State::Blocked || !t->waiting) return;
+    wq_remove(*t->waiting, t);
+    t->timed_out = true;
+    make_ready(t);
+}
+
+static void reap() {
+    Thread** pp = &g_all;
+    while (*pp) {
+        Thread* t = *pp;
+        if (t->state == State::Dead && t != g_cur) {
+            *pp = t->all_next;
+            kheap::free(t->stack);
+            kheap::free(t);
+        } else {
+            pp = &t->all_next;
+        }
+    }
+}
+
+static void idle_main(void*) {
+    for (;;) {
+        irq_disable();
+        if (!any_ready()) asm volatile("wfi");
+        irq_enable();
+
+        uint64_t flags = irq_save();
+        if (any_ready()) switch_away();
+        irq_restore(flags);
+    }
+}
+
+static Thread* create(const char* name, sched::Entry fn, void* arg,
+                      uint8_t prio, uint32_t stack_size) {
+    Thread*  t   = static_cast<Thread*>(kheap::alloc(sizeof(Thread), 16));
+    uint8_t* stk = static_cast<uint8_t*>(kheap::alloc(stack_size, 16));
+    if (!t || !stk) {
+        if (t)   kheap::free(t);
+        if (stk) kheap::free(stk);
+        return nullptr;
+    }
+    memset(t, 0, sizeof(Thread));
+
+    t->name  = name;
+    t->id    = ++g_next_id;
+    t->prio  = (prio < sched::PRIO_COUNT) ? prio : (uint8_t)(sched::PRIO_COUNT - 1);
+    t->stack = stk;
+    t->fn    = fn;
+    t->arg   = arg;
+
+    uint64_t* frame = reinterpret_cast<uint64_t*>(stk + stack_size - FRAME_BYTES);
+    memset(frame, 0, FRAME_BYTES);
+    frame[0]  = reinterpret_cast<uint64_t>(t);
+    frame[31] = reinterpret_cast<uint64_t>(&sched_thread_entry);
+    frame[32] = SPSR_EL1H_AF;
+    t->sp = reinterpret_cast<uint64_t>(frame);
+
+    uint64_t flags = irq_save();
+    t->all_next = g_all;
+    g_all = t;
+    irq_restore(flags);
+    return t;
+}
+
+}
+
+extern "C" [[noreturn]] void sched_thread_entry(Thread* t) {
+    t->fn(t->arg);
+    sched::exit();
+}
+
+namespace sched {
+
+void init(const char* boot_name, uint8_t boot_prio) {
+    memset(&g_boot, 0, sizeof(g_boot));
+    g_boot.name  = boot_name;
+    g_boot.id    = ++g_next_id;
+    g_boot.prio  = boot_prio;
+    g_boot.state = State::Running;
+    g_all = &g_boot;
+
+    g_idle = create("idle", idle_main, nullptr, PRIO_IDLE, 8192u);
+    if (!g_idle) panic("sched: idle thread alloc failed");
+    g_idle->acct = cpustat::IDLE;
+
+    g_cur = &g_boot;
+    g_run_since = read_cntpct_el0();
+    printk("sched: started, boot thread '%s' prio %u\n", boot_name, (unsigned)boot_prio);
+}
+
+bool started() { return g_cur != nullptr; }
+
+Thread* spawn(const char* name, Entry fn, void* arg, uint8_t prio, uint32_t stack_size) {
+    lock_kernel();
+    reap();
+    Thread* t = create(name, fn, arg, prio, stack_size);
+    unlock_kernel();
+    if (!t) return nullptr;
+
+    uint64_t flags = irq_save();
+    make_ready(t);
+    irq_restore(flags);
+    maybe_preempt();
+    return t;
+}
+
+void exit() {
+    irq_disable();
+    bkl_drop();
+    g_cur->state = State::Dead;
+    switch_away();
+    for (;;) asm volatile("wfi");
+}
+
+Thread* current() { return g_cur; }
+
+void yield() {
+    if (!g_cur) return;
+    uint64_t flags = irq_save();
+    g_need_resched = false;
+    if (g_cur != g_idle) rq_push(g_cur);
+    sleep_current();
+    irq_restore(flags);
+}
+
+void wait(WaitQueue& wq) {
+    if (!g_cur) return;
+    uint64_t flags = irq_save();
+    g_cur->state = State::Blocked;
+    wq_push(wq, g_cur);
+    sleep_current();
+    irq_restore(flags);
+}
+
+bool wait_until(WaitQueue& wq, uint64_t deadline_ns) {
+    if (!g_cur) return false;
+    uint64_t flags = irq_save();
+    if (timer::now_ns() >= deadline_ns) {
+        irq_restore(flags);
+        return false;
+    }
+    g_cur->timed_out = false;
+    int tid = timer::add(deadline_ns, on_wait_timeout, g_cur);
+    if (tid < 0) {
+        g_cur->timed_out = true;
+        irq_restore(flags);
+        return false;
+    }
+    g_cur->state = State::Blocked;
+    wq_push(wq, g_cur);
+    uint32_t depth = bkl_drop();
+    switch_away();
+    timer::cancel(tid);
+    if (depth) bkl_take(depth);
+    bool woken = !g_cur->timed_out;
+    irq_restore(flags);
+    return woken;
+}
+
+void wake_one(WaitQueue& wq) {
+    uint64_t flags = irq_save();
+    if (Thread* t = wq_pop(wq)) make_ready(t);
+    irq_restore(flags);
+    maybe_preempt();
+}
+
+void wake_all(WaitQueue& wq) {
+    uint64_t flags = irq_save();
+    while (Thread* t = wq_pop(wq)) make_ready(t);
+    irq_restore(flags);
+    maybe_preempt();
+}
+
+void sleep_until(uint64_t deadline_ns) {
+    if (!g_cur) {
+        while (timer::now_ns() < deadline_ns) asm volatile("nop");
+        return;
+    }
+    WaitQueue wq;
+    while (timer::now_ns() < deadline_ns)
+        if (!wait_until(wq, deadline_ns)) yield();
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_until(timer::now_ns() + (uint64_t)ms * 1000000ull);
+}
+
+void lock_kernel() {
+    if (!g_cur) return;
+    uint64_t flags = irq_save();
+    if (g_bkl_owner == g_cur) ++g_bkl_depth;
+    else                      bkl_take(1);
+    irq_restore(flags);
+}
+
+void unlock_kernel() {
+    if (!g_cur) return;
+    uint64_t flags = irq_save();
+    if (g_bkl_owner == g_cur && --g_bkl_depth == 0) {
+        g_bkl_owner = nullptr;
+        if (Thread* w = wq_pop(g_bkl_wq)) make_ready(w);
+    }
+    irq_restore(flags);
+    maybe_preempt();
+}
+
+void Mutex::lock() {
+    if (!g_cur) return;
+    uint64_t flags = irq_save();
+    while (_owner && _owner != g_cur) {
+        g_cur->state = State::Blocked;
+        wq_push(_wq, g_cur);
+        sleep_current();
+    }
+    _owner = g_cur;
+    irq_restore(flags);
+}
+
+void Mutex::unlock() {
+    if (!g_cur) return;
+    uint64_t flags = irq_save();
+    _owner = nullptr;
+    if (Thread* w = wq_pop(_wq)) make_ready(w);
+    irq_restore(flags);
+    maybe_preempt();
+}
+
+bool Mutex::held() const { return _owner != nullptr; }
+
+void irq_enter() {
+    ++g_irq_depth;
+}
+
+uint32_t irq_depth() { return g_irq_depth; }
+
+uint64_t irq_exit(uint64_t sp) {
+    --g_irq_depth;
+    if (!g_cur || g_irq_depth || !g_need_resched) return sp;
+    g_need_resched = false;
+
+    Thread* prev = g_cur;
+    if (prev != g_idle) rq_push(prev);
+    Thread* next = rq_pop();
+    if (next == prev) {
+        prev->state = State::Running;
+        return sp;
+    }
+    prev->sp = sp;
+    charge_run(prev);
+    g_cur = next;
+    next->state = State::Running;
+    ++next->switches;
+    cpustat::enter(next->acct);
+    arm_slice();
+    return next->sp;
+}
+
+Thread* first() { return g_all; }
+
+}
@@ -0,0 +1,98 @@
+/*
+  sched.hpp - kernel threads and the scheduler
+  spawn() creates a thread with its own heap stack. threads run by priority,
+  round-robin within a priority on a 10ms slice, and are preempted on irq exit
+  when a higher priority thread was woken
+  WaitQueue + wait/wake_one/wake_all and sleep_until are the blocking
+  primitives, Mutex is a sleeping lock. lock_kernel() is a recursive big
+  kernel lock that wm, fs and the apps run under; it is dropped while its
+  holder sleeps or yields and retaken before the holder continues
+  fp/simd state is not switched: only calc.cpp is built with fp enabled
+  cpu_ticks is the cntpct time a thread has been running, irqs taken while
+  it runs included; heap_owner tags the kheap blocks it allocates
+*/
+#pragma once
+#include <stdint.h>
+
+namespace sched {
+
+using Entry = void (*)(void* arg);
+
+static constexpr uint8_t PRIO_IDLE  = 0;
+static constexpr uint8_t PRIO_APP   = 2;
+static constexpr uint8_t PRIO_UI    = 3;
+static constexpr uint8_t PRIO_INPUT = 4;
+static constexpr uint8_t PRIO_WORK  = 5;
+static constexpr uint8_t PRIO_COUNT = 8;
+
+static constexpr uint32_t STACK_SIZE = 32u * 1024u;
+
+enum class State : uint8_t { Ready, Running, Blocked, Dead };
+
+struct WaitQueue;
+
+struct Thread {
+    uint64_t    sp;
+    const char* name;
+    uint32_t    id;
+    uint8_t     prio;
+    State       state;
+    bool        timed_out;
+    Thread*     next;
+    Thread*     all_next;
+    WaitQueue*  waiting;
+    void*       stack;
+    Entry       fn;
+    void*       arg;
+    uint64_t    switches;
+    uint64_t    cpu_ticks;
+    uint8_t     acct;
+    uint8_t     heap_owner;
+};
+
+struct WaitQueue {
+    Thread* head = nullptr;
+    Thread* tail = nullptr;
+};
+
+class Mutex {
+public:
+    void lock();
+    void unlock();
+    bool held() const;
+
+private:
+    Thread*   _owner = nullptr;
+    WaitQueue _wq;
+};
+
+void init(const char* boot_name, uint8_t boot_prio);
+bool started();
+
+Thread* spawn(const char* name, Entry fn, void* arg,
+              uint8_t prio = PRIO_APP, uint32_t stack_size = STACK_SIZE);
+
+[[noreturn]] void exit();
+
+Thread* current();
+
+void yield();
+
+void wait(WaitQueue& wq);
+bool wait_until(WaitQueue& wq, uint64_t deadline_ns);
+void wake_one(WaitQueue& wq);
+void wake_all(WaitQueue& wq);
+
+void sleep_until(uint64_t deadline_ns);
+void sleep_ms(uint32_t ms);
+
+void lock_kernel();
+void unlock_kernel();
+
+void     irq_enter();
+uint64_t irq_exit(uint64_t sp);
+uint32_t irq_depth();
+
+Thread* first();
+
+}
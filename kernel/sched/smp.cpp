@@ -0,0 +1,87 @@
+/*
+  smp.cpp - psci based secondary core bring-up
+  cores are tried in mpidr order (aff0 = index on qemu virt) until psci says
+  the mpidr does not exist. the stack and its slot in smp_stack_tops are
+  cleaned to memory first because the new core reads them with the mmu off
+*/
+#include "kernel/sched/smp.hpp"
+#include "kernel/sched/pool.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/irq/timer.hpp"
+#include "kernel/mm/heap.hpp"
+#include "kernel/mm/mmu.hpp"
+#include "kernel/core/print.hpp"
+#include "kernel/core/pmu.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+extern "C" void _secondary_start();
+extern "C" uint64_t smp_stack_tops[smp::MAX_CPUS];
+
+uint64_t smp_stack_tops[smp::MAX_CPUS];
+
+namespace {
+
+static constexpr uint64_t PSCI_CPU_ON           = 0xC4000003ull;
+static constexpr int64_t  PSCI_SUCCESS          = 0;
+static constexpr int64_t  PSCI_INVALID_PARAMS   = -2;
+static constexpr uint64_t ONLINE_TIMEOUT_NS     = 100000000ull;
+
+static uint32_t g_online = 1;
+static bool     g_up[smp::MAX_CPUS];
+
+static int64_t psci_cpu_on(uint64_t mpidr, uint64_t entry, uint64_t ctx) {
+    register uint64_t x0 asm("x0") = PSCI_CPU_ON;
+    register uint64_t x1 asm("x1") = mpidr;
+    register uint64_t x2 asm("x2") = entry;
+    register uint64_t x3 asm("x3") = ctx;
+    asm volatile("hvc #0" : "+r"(x0) : "r"(x1), "r"(x2), "r"(x3) : "memory");
+    return (int64_t)x0;
+}
+
+}
+
+extern "C" [[noreturn]] void secondary_main(uint64_t cpu) {
+    mmu::init_secondary();
+    gic::init_cpu();
+    if (pmu::ready()) pmu::init_cpu();
+
+    __atomic_store_n(&g_up[cpu], true, __ATOMIC_RELEASE);
+    pool::worker((uint32_t)cpu);
+}
+
+namespace smp {
+
+uint32_t init() {
+    for (uint32_t cpu = 1; cpu < MAX_CPUS; ++cpu) {
+        uint8_t* stk = static_cast<uint8_t*>(kheap::alloc(STACK_SIZE, 16));
+        if (!stk) break;
+        smp_stack_tops[cpu] = (uint64_t)(uintptr_t)(stk + STACK_SIZE);
+        dc_civac_range(stk, STACK_SIZE);
+        dc_civac_range(&smp_stack_tops[cpu], sizeof(uint64_t));
+
+        int64_t r = psci_cpu_on(cpu, (uint64_t)(uintptr_t)&_secondary_start, cpu);
+        if (r != PSCI_SUCCESS) {
+            kheap::free(stk);
+            if (r == PSCI_INVALID_PARAMS) break;
+            printk("smp: cpu%u CPU_ON failed (%d)\n", (unsigned)cpu, (int)r);
+            continue;
+        }
+
+        uint64_t deadline = timer::now_ns() + ONLINE_TIMEOUT_NS;
+        while (!__atomic_load_n(&g_up[cpu], __ATOMIC_ACQUIRE) && timer::now_ns() < deadline)
+            asm volatile("yield");
+        if (!__atomic_load_n(&g_up[cpu], __ATOMIC_ACQUIRE)) {
+            printk("smp: cpu%u did not come online\n", (unsigned)cpu);
+            continue;
+        }
+        __atomic_add_fetch(&g_online, 1u, __ATOMIC_RELEASE);
+    }
+
+    printk("smp: %u cpu(s) online\n", (unsigned)online());
+    return online();
+}
+
+uint32_t online() { return __atomic_load_n(&g_online, __ATOMIC_ACQUIRE); }
+
+}
@@ -0,0 +1,27 @@
+/*
+  smp.hpp - secondary core bring-up
+  init() starts every other core with psci CPU_ON; each one gets its own
+  stack, installs the vectors, switches on the mmu and its gic cpu interface
+  and then runs pool::worker(). the scheduler, irqs and all spis stay on
+  cpu 0, secondaries only execute pool jobs
+  cpu_id() is the logical index kept in tpidr_el1 (0 = boot cpu)
+*/
+#pragma once
+#include <stdint.h>
+
+namespace smp {
+
+static constexpr uint32_t MAX_CPUS   = 8;
+static constexpr uint32_t STACK_SIZE = 16u * 1024u;
+
+static inline uint32_t cpu_id() {
+    uint64_t v;
+    asm volatile("mrs %0, tpidr_el1" : "=r"(v));
+    return (uint32_t)v;
+}
+
+uint32_t init();
+
+uint32_t online();
+
+}
@@ -1,15 +1,29 @@
 /*
   shell.cpp - command interpreter for the terminal pane
-  supports: ls, cat, echo, touch, rm, mkdir, cd, pwd, clear, sync, exit, help
+  supports: ls, cat, echo, touch, rm, mkdir, cd, pwd, clear, sync, vqbench,
+  workstat, irqstat, trace, prof, perfstat, boottime, input, frames, iostat,
+  exit, help
   maintains a cwd and uses vfs to access files
 */
 #include "kernel/shell/shell.hpp"
 #include "kernel/fs/vfs.hpp"
-#include "kernel/fs/ramfs.hpp"
 #include "kernel/fs/blkfs.hpp"
 #include "kernel/wm/wm.hpp"
 #include "kernel/apps/editor.hpp"
+#include "kernel/drivers/virtio/blk.hpp"
+#include "kernel/drivers/virtio/gpu.hpp"
+#include "kernel/drivers/virtio/virtqueue.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/irq/work.hpp"
+#include "kernel/irq/gic.hpp"
+#include "kernel/core/trace.hpp"
+#include "kernel/core/prof.hpp"
+#include "kernel/core/pmu.hpp"
+#include "kernel/core/bootlog.hpp"
+#include "kernel/core/inputrec.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/sched/sched.hpp"
+#include "arch/aarch64/regs.hpp"
 #include <string.h>
 #include <stdint.h>
 
@@ -84,6 +98,16 @@ static void cmd_help() {
     out("  pwd             print working directory\n");
     out("  clear           clear the terminal\n");
     out("  sync            save filesystem to disk\n");
+    out("  vqbench [n]     time n blk/gpu virtqueue requests\n");
+    out("  workstat        deferred irq work queue counters\n");
+    out("  irqstat [reset] per-irq counts, latency and run-time histogram\n");
+    out("  trace [on|off|clear|dump [file]]  kernel trace ring, dump as chrome json\n");
+    out("  prof start [hz] | stop | top [n]  sampling profiler, hottest functions\n");
+    out("  perfstat <cmd>  run a command and print pmu counters for it\n");
+    out("  boottime        boot phase timeline and time to desktop\n");
+    out("  input record | stop [file] | replay [file] [fast]  record / replay input events\n");
+    out("  frames [overlay on|off | reset]  render phase percentiles, frame overlay\n");
+    out("  iostat [ms | reset]  per-device iops, MB/s and latency over an interval\n");
     out("  edit <file>     open / create file in the text editor\n");
     out("  wintest         open a floating test window\n");
     out("  winclose [N]    close test window N (or newest if omitted)\n");
@@ -91,10 +115,10 @@ static void cmd_help() {
     out("  help            show this help\n");
 }
 
-static char* rjust(char* buf, unsigned v, int width) {
-    char tmp[17]; int len = 0;
+static char* rjust(char* buf, uint64_t v, int width) {
+    char tmp[21]; int len = 0;
     if (v == 0) { tmp[len++] = '0'; }
-    else { unsigned x = v; while (x) { tmp[len++] = (char)('0' + x % 10); x /= 10; } }
+    else { uint64_t x = v; while (x) { tmp[len++] = (char)('0' + x % 10); x /= 10; } }
 
     int pad = width - len; if (pad < 0) pad = 0;
     int i = 0;
@@ -242,7 +266,7 @@ static void cmd_touch(const char* args) {
     if (!args[0]) { out("touch: missing filename\n"); return; }
     const char* path = resolve(args);
     if (!path[0])        { out("touch: invalid path\n"); return; }
-    if (ramfs::exists_dir(path)) { out("touch: '"); out(args); out("': is a directory\n"); return; }
+    if (vfs::is_dir(path)) { out("touch: '"); out(args); out("': is a directory\n"); return; }
     if (!vfs::exists(path)) {
         if (vfs::write(path, nullptr, 0) < 0)
             { out("touch: failed to create '"); out(args); out("'\n"); return; }
@@ -255,8 +279,8 @@ static void cmd_rm(const char* args) {
     args = skip_ws(args);
     if (!args[0]) { out("rm: missing filename\n"); return; }
     const char* path = resolve(args);
-    if (ramfs::exists_dir(path)) { out("rm: '"); out(args); out("': is a directory\n"); return; }
-    if (!ramfs::remove(path))
+    if (vfs::is_dir(path)) { out("rm: '"); out(args); out("': is a directory\n"); return; }
+    if (!vfs::remove(path))
         { out("rm: '"); out(args); out("': not found\n"); return; }
     if (blkfs::ready()) blkfs::flush();
 }
@@ -271,6 +295,402 @@ static void cmd_mkdir(const char* args) {
     if (blkfs::ready()) blkfs::flush();
 }
 
+static unsigned parse_uint(const char* s, unsigned dflt) {
+    s = skip_ws(s);
+    if (*s < '0' || *s > '9') return dflt;
+    unsigned v = 0;
+    while (*s >= '0' && *s <= '9') v = v * 10u + (unsigned)(*s++ - '0');
+    return v;
+}
+
+static void vqbench_report(const char* dev, bool packed, unsigned reqs,
+                           uint64_t cycles, uint64_t freq) {
+    char nbuf[12];
+    uint64_t us   = cycles * 1000000ull / freq;
+    uint64_t rate = cycles ? (uint64_t)reqs * freq / cycles : 0;
+    out("  "); out(dev);
+    out(packed ? " (packed): " : " (split):  ");
+    to_dec(nbuf, reqs);           out(nbuf); out(" reqs in ");
+    to_dec(nbuf, (unsigned)us);   out(nbuf); out(" us  = ");
+    to_dec(nbuf, (unsigned)rate); out(nbuf); out(" req/s\n");
+}
+
+static void cmd_vqbench(const char* args) {
+    unsigned n = parse_uint(args, 1000);
+    if (n == 0) n = 1;
+    uint64_t freq = read_cntfrq_el0();
+
+    out("vqbench: "); char nbuf[12]; to_dec(nbuf, n); out(nbuf); out(" iterations\n");
+
+    if (vblk::ready()) {
+        static uint8_t s_sector[512] __attribute__((aligned(512)));
+        uint64_t t0 = read_cntpct_el0();
+        for (unsigned i = 0; i < n; ++i)
+            vblk::read_sectors(0, 1, s_sector);
+        vqbench_report("blk", vblk::ring_packed(), n, read_cntpct_el0() - t0, freq);
+    } else {
+        out("  blk: no device\n");
+    }
+
+    if (vgpu::ready()) {
+        uint64_t t0 = read_cntpct_el0();
+        for (unsigned i = 0; i < n; ++i)
+            vgpu::flush_rect(0, 0, 64, 64);
+        vqbench_report("gpu", vgpu::ring_packed(), n * 2u, read_cntpct_el0() - t0, freq);
+    } else {
+        out("  gpu: no device\n");
+    }
+}
+
+static void cmd_iostat(const char* args) {
+    uint32_t n = virtio::queue_count();
+    if (strcmp(args, "reset") == 0) {
+        for (uint32_t i = 0; i < n; ++i) virtio::queue(i)->reset_stats();
+        out("iostat: counters cleared\n");
+        return;
+    }
+    if (n == 0) { out("iostat: no virtio queues\n"); return; }
+
+    unsigned ms = parse_uint(args, 1000);
+    if (ms == 0) ms = 1;
+
+    virtio::QueueStats a[virtio::MAX_QUEUES], b[virtio::MAX_QUEUES];
+    for (uint32_t i = 0; i < n; ++i) virtio::queue(i)->snapshot(a[i]);
+    sched::sleep_ms(ms);
+    for (uint32_t i = 0; i < n; ++i) virtio::queue(i)->snapshot(b[i]);
+
+    char nbuf[21];
+    out("dev           iops    MB/s   avg us   max us  spins/io  kicks/io\n");
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t ios   = b[i].completions - a[i].completions;
+        uint64_t bytes = b[i].bytes - a[i].bytes;
+        uint64_t cs    = bytes * 100u / 1000u / ms;
+        const char* nm = virtio::queue(i)->name();
+        out(nm);
+        for (size_t k = strlen(nm); k < 8; ++k) out(" ");
+        out(rjust(nbuf, ios * 1000u / ms, 10));
+        out(rjust(nbuf, cs / 100u, 5));
+        out(".");
+        if (cs % 100u < 10u) out("0");
+        out(to_dec(nbuf, (unsigned)(cs % 100u)));
+        if (virtio::queue(i)->timed()) {
+            out(rjust(nbuf, ios ? (b[i].lat_sum_ns - a[i].lat_sum_ns) / ios / 1000u : 0, 9));
+            out(rjust(nbuf, b[i].max_lat_ns / 1000u, 9));
+        } else {
+            out("        -        -");
+        }
+        out(rjust(nbuf, ios ? (b[i].spins - a[i].spins) / ios : 0, 10));
+        uint64_t subs = b[i].submits - a[i].submits;
+        out(rjust(nbuf, subs ? (b[i].notifies - a[i].notifies) * 100u / subs : 0, 9));
+        out("%\n");
+    }
+
+    out("since boot, latency:");
+    for (uint32_t k = 0; k < virtio::LAT_BUCKETS; ++k) {
+        uint64_t lim = virtio::lat_limit_ns(k);
+        uint64_t us  = lim ? lim : virtio::lat_limit_ns(virtio::LAT_BUCKETS - 2);
+        out(lim ? " <" : " >=");
+        out(to_dec(nbuf, (unsigned)((us + 500u) / 1000u)));
+        out("us");
+    }
+    out("\n");
+    for (uint32_t i = 0; i < n; ++i) {
+        if (!virtio::queue(i)->timed()) continue;
+        const char* nm = virtio::queue(i)->name();
+        out(nm);
+        for (size_t k = strlen(nm); k < 8; ++k) out(" ");
+        out(rjust(nbuf, b[i].completions, 10));
+        out(" done:");
+        for (uint32_t k = 0; k < virtio::LAT_BUCKETS; ++k) {
+            out(" ");
+            out(to_dec(nbuf, b[i].hist[k]));
+        }
+        out("\n");
+    }
+}
+
+static void cmd_workstat() {
+    static const char* const k_names[work::LEVELS] = { "high  ", "normal", "thread" };
+    char nbuf[17];
+
+    out("level     queued      ran  depth  max  avg us  max us\n");
+    for (uint32_t l = 0; l < work::LEVELS; ++l) {
+        work::Stats st = work::stats((work::Level)l);
+        unsigned avg = st.ran ? (unsigned)(st.total_lat_ns / st.ran / 1000u) : 0;
+        out(k_names[l]);
+        out(rjust(nbuf, st.queued, 10));
+        out(rjust(nbuf, st.ran, 9));
+        out(rjust(nbuf, st.depth, 7));
+        out(rjust(nbuf, st.max_depth, 5));
+        out(rjust(nbuf, avg, 8));
+        out(rjust(nbuf, (unsigned)(st.max_lat_ns / 1000u), 8));
+        out("\n");
+    }
+}
+
+static void cmd_irqstat(const char* args) {
+    if (strcmp(args, "reset") == 0) {
+        gic::reset_stats();
+        out("irqstat: counters cleared\n");
+        return;
+    }
+
+    char nbuf[17];
+    out(" irq      count  avg lat  max lat  avg run  max run   (us)\n");
+    for (uint32_t irq = 0; irq < 256; ++irq) {
+        gic::IrqStats st;
+        if (!gic::stats(irq, st)) continue;
+        out(rjust(nbuf, irq, 4));
+        out(rjust(nbuf, st.count, 11));
+        if (st.lat_samples) {
+            out(rjust(nbuf, (unsigned)(st.lat_sum_ns / st.lat_samples / 1000u), 9));
+            out(rjust(nbuf, (unsigned)(st.max_lat_ns / 1000u), 9));
+        } else {
+            out("        -        -");
+        }
+        out(rjust(nbuf, (unsigned)(st.run_sum_ns / st.count / 1000u), 9));
+        out(rjust(nbuf, (unsigned)(st.max_run_ns / 1000u), 9));
+        out("\n     run:");
+        for (uint32_t b = 0; b < gic::HIST_BUCKETS; ++b) {
+            uint64_t lim = gic::hist_limit_ns(b);
+            out(" ");
+            if (!lim) out(">=");
+            else      out("<");
+            uint64_t us = lim ? lim : gic::hist_limit_ns(gic::HIST_BUCKETS - 2);
+            out(to_dec(nbuf, (unsigned)((us + 500u) / 1000u)));
+            out(":");
+            out(to_dec(nbuf, st.hist[b]));
+        }
+        out("\n");
+    }
+    out("spurious: ");    out(to_dec(nbuf, gic::spurious()));
+    out("  max nesting: "); out(to_dec(nbuf, gic::max_nesting())); out("\n");
+}
+
+static void cmd_trace(const char* args) {
+    char nbuf[17];
+    if (strcmp(args, "on") == 0)    { trace::enable(trace::ALL); out("trace: on\n");      return; }
+    if (strcmp(args, "off") == 0)   { trace::enable(0);          out("trace: off\n");     return; }
+    if (strcmp(args, "clear") == 0) { trace::clear();            out("trace: cleared\n"); return; }
+
+    if (args[0] == 'd' && args[1] == 'u' && args[2] == 'm' && args[3] == 'p' &&
+        (args[4] == '\0' || args[4] == ' ')) {
+        const char* file = skip_ws(args + 4);
+        if (!file[0]) file = "trace.json";
+        const char* path = resolve(file);
+        if (!path[0]) { out("trace: invalid path\n"); return; }
+        int n = trace::dump_json(path);
+        if (n < 0) { out("trace: dump failed (out of memory?)\n"); return; }
+        out("trace: wrote "); out(to_dec(nbuf, (unsigned)n)); out(" bytes to "); out(file); out("\n");
+        return;
+    }
+    if (args[0]) { out("usage: trace [on|off|clear|dump [file]]\n"); return; }
+
+    uint32_t m = trace::mask();
+    out("trace: "); out(m ? "on" : "off");
+    out(", "); out(to_dec(nbuf, trace::recorded()));
+    out(" / "); out(to_dec(nbuf, trace::capacity())); out(" records\n");
+    for (uint32_t id = 0; id < trace::COUNT; ++id) {
+        out((m >> id) & 1u ? "  [x] " : "  [ ] ");
+        out(trace::name((trace::Id)id));
+        out("\n");
+    }
+}
+
+static void cmd_prof(const char* args) {
+    char nbuf[17];
+    if (args[0] == 's' && args[1] == 't' && args[2] == 'a' && args[3] == 'r' && args[4] == 't') {
+        unsigned hz = parse_uint(args + 5, prof::DEFAULT_HZ);
+        if (!prof::start(hz)) { out("prof: no symbol table in this image\n"); return; }
+        out("prof: sampling cpu0 at "); out(to_dec(nbuf, prof::hz())); out(" Hz\n");
+        return;
+    }
+    if (strcmp(args, "stop") == 0) {
+        prof::stop();
+        out("prof: stopped, "); out(to_dec(nbuf, prof::samples())); out(" samples\n");
+        return;
+    }
+    if (args[0] == 't' && args[1] == 'o' && args[2] == 'p' && (args[3] == '\0' || args[3] == ' ')) {
+        static prof::Entry s_top[40];
+        unsigned want = parse_uint(args + 3, 15);
+        if (want == 0 || want > 40) want = 40;
+        uint32_t total = prof::samples();
+        uint32_t n     = prof::top(s_top, want);
+        if (!total) { out("prof: no samples, run 'prof start' first\n"); return; }
+
+        out(prof::running() ? "prof: running, " : "prof: ");
+        out(to_dec(nbuf, total)); out(" samples at "); out(to_dec(nbuf, prof::hz())); out(" Hz\n");
+        out(" samples      %  function\n");
+        for (uint32_t i = 0; i < n; ++i) {
+            unsigned pm = (unsigned)((uint64_t)s_top[i].hits * 1000u / total);
+            out(rjust(nbuf, s_top[i].hits, 8));
+            out(rjust(nbuf, pm / 10u, 5)); out("."); out(to_dec(nbuf, pm % 10u));
+            out("  "); out(s_top[i].name); out("\n");
+        }
+        return;
+    }
+    out("usage: prof start [hz] | stop | top [n]\n");
+}
+
+static void perfstat_row(const char* label, uint64_t v) {
+    char nbuf[24];
+    out(label);
+    out(rjust(nbuf, v, 16));
+    out("\n");
+}
+
+static void cmd_perfstat(const char* args) {
+    char nbuf[24];
+    if (!args[0])        { out("usage: perfstat <command>\n"); return; }
+    if (!pmu::ready())   { out("perfstat: no pmu on this cpu\n"); return; }
+    if (pmu::collecting()) { out("perfstat: already running\n"); return; }
+
+    pmu::reset_counters();
+    pmu::set_collecting(true);
+    uint64_t    t0 = read_cntpct_el0();
+    pmu::Sample s0 = pmu::read();
+    shell::execute(args);
+    pmu::Sample d  = pmu::read() - s0;
+    uint64_t    dt = read_cntpct_el0() - t0;
+    pmu::set_collecting(false);
+
+    uint64_t freq = read_cntfrq_el0();
+    uint64_t ipc  = d.cycles ? d.instructions * 100u / d.cycles : 0;
+
+    out("\nperfstat '"); out(args); out("' on cpu0 (includes anything else it ran):\n");
+    perfstat_row("  cycles           ", d.cycles);
+    perfstat_row("  instructions     ", d.instructions);
+    out("  ipc              ");
+    char frac[4] = { '.', (char)('0' + ipc % 100u / 10u), (char)('0' + ipc % 10u), '\0' };
+    out(rjust(nbuf, ipc / 100u, 13)); out(frac); out("\n");
+    perfstat_row("  l1d refills      ", d.l1d_refill);
+    perfstat_row("  l2d refills      ", d.l2d_refill);
+    perfstat_row("  branch mispreds  ", d.br_mispred);
+    perfstat_row("  elapsed us       ", freq ? dt * 1000000u / freq : 0);
+
+    bool header = false;
+    for (pmu::Counter* c = pmu::counters(); c; c = c->next) {
+        if (!c->calls) continue;
+        if (!header) {
+            out("  scope (all cpus)      calls      cycles       insts   l1d ref   l2d ref   br miss\n");
+            header = true;
+        }
+        out("  "); out(c->name);
+        int pad = 16 - (int)strlen(c->name);
+        while (pad-- > 0) out(" ");
+        out(rjust(nbuf, c->calls, 11));
+        out(rjust(nbuf, c->total.cycles, 12));
+        out(rjust(nbuf, c->total.instructions, 12));
+        out(rjust(nbuf, c->total.l1d_refill, 10));
+        out(rjust(nbuf, c->total.l2d_refill, 10));
+        out(rjust(nbuf, c->total.br_mispred, 10));
+        out("\n");
+    }
+}
+
+static void cmd_input(const char* args) {
+    char nbuf[12];
+    const char* rest = args;
+    while (*rest && *rest != ' ') ++rest;
+    size_t      wl   = (size_t)(rest - args);
+    rest = skip_ws(rest);
+
+    if (wl == 6 && strncmp(args, "record", 6) == 0) {
+        if (inputrec::replaying()) { out("input: replay in progress\n"); return; }
+        if (!inputrec::start_record()) { out("input: out of memory\n"); return; }
+        out("input: recording, 'input stop [file]' to save\n");
+        return;
+    }
+    if (wl == 4 && strncmp(args, "stop", 4) == 0) {
+        if (inputrec::replaying()) { inputrec::stop_replay(); out("input: replay stopped\n"); return; }
+        if (!inputrec::recording()) { out("input: not recording\n"); return; }
+        const char* path = resolve(rest[0] ? rest : "input.rec");
+        int n = inputrec::stop_record(path);
+        if (n < 0) { out("input: save failed\n"); return; }
+        out("input: saved "); out(to_dec(nbuf, (unsigned)n)); out(" events to /"); out(path); out("\n");
+        return;
+    }
+    if (wl == 6 && strncmp(args, "replay", 6) == 0) {
+        if (inputrec::recording()) { out("input: recording in progress\n"); return; }
+        bool fast = false;
+        char file[64] = "input.rec";
+        while (*rest) {
+            const char* e = rest;
+            while (*e && *e != ' ') ++e;
+            size_t n = (size_t)(e - rest);
+            if (n == 4 && strncmp(rest, "fast", 4) == 0) {
+                fast = true;
+            } else if (n < sizeof(file)) {
+                memcpy(file, rest, n);
+                file[n] = '\0';
+            }
+            rest = skip_ws(e);
+        }
+        int n = inputrec::start_replay(resolve(file), fast);
+        if (n < 0) { out("input: cannot replay '"); out(file); out("'\n"); return; }
+        out("input: replaying "); out(to_dec(nbuf, (unsigned)n));
+        out(fast ? " events, fast\n" : " events at recorded speed\n");
+        return;
+    }
+    if (args[0]) { out("usage: input [record | stop [file] | replay [file] [fast]]\n"); return; }
+
+    if (inputrec::recording()) {
+        out("input: recording, "); out(to_dec(nbuf, inputrec::count())); out(" events\n");
+    } else if (inputrec::replaying()) {
+        out("input: replaying, "); out(to_dec(nbuf, inputrec::position()));
+        out(" / "); out(to_dec(nbuf, inputrec::count())); out(" events\n");
+    } else {
+        out("input: idle\n");
+    }
+}
+
+static void cmd_boottime() {
+    char nbuf[21];
+    out("    start us     took us  phase\n");
+    for (uint32_t i = 0; i < bootlog::count(); ++i) {
+        bootlog::Phase ph;
+        bootlog::phase(i, ph);
+        out(rjust(nbuf, ph.start_us, 12));
+        out(rjust(nbuf, ph.us, 12));
+        out("  ");
+        out(ph.name);
+        out("\n");
+    }
+    uint64_t d = bootlog::desktop_us();
+    if (d) {
+        out("time to desktop: ");
+        out(rjust(nbuf, d, 0));
+        out(" us\n");
+    }
+}
+
+static void cmd_frames(const char* args) {
+    if (strcmp(args, "reset") == 0) { framestat::reset(); out("frames: reset\n"); return; }
+    if (strcmp(args, "overlay on") == 0)  { wm::set_overlay(true);  return; }
+    if (strcmp(args, "overlay off") == 0) { wm::set_overlay(false); return; }
+    if (args[0]) { out("usage: frames [overlay on|off | reset]\n"); return; }
+
+    framestat::Summary st;
+    framestat::summary(st);
+
+    char nbuf[21];
+    out("phase           p50 us     p95 us     p99 us\n");
+    for (uint32_t p = 0; p < framestat::PHASES; ++p) {
+        const char* nm = framestat::name((framestat::Phase)p);
+        out(nm);
+        for (size_t n = strlen(nm); n < 10; ++n) out(" ");
+        out(rjust(nbuf, st.p50_us[p], 11));
+        out(rjust(nbuf, st.p95_us[p], 11));
+        out(rjust(nbuf, st.p99_us[p], 11));
+        out("\n");
+    }
+    out("last ");  out(rjust(nbuf, st.frames, 0));
+    out(" of ");   out(rjust(nbuf, st.total_frames, 0));
+    out(" frames, "); out(rjust(nbuf, st.pixels, 0));
+    out(" px and ");  out(rjust(nbuf, st.bytes / 1024u, 0));
+    out(" KiB per frame\n");
+}
+
 static void win_fill(wm::Window* w,
                      uint32_t rx, uint32_t ry, uint32_t rw, uint32_t rh,
                      uint32_t col) {
@@ -410,7 +830,7 @@ static void cmd_cd(const char* args) {
     }
 
     const char* path = resolve(args);
-    if (!ramfs::exists_dir(path))
+    if (!vfs::is_dir(path))
         { out("cd: '"); out(args); out("': no such directory\n"); return; }
     size_t pl = strlen(path);
     if (pl >= sizeof(g_cwd))
@@ -463,6 +883,26 @@ void execute(const char* line) {
         cmd_clear();
     } else if (strcmp(cmd, "sync") == 0) {
         cmd_sync();
+    } else if (strcmp(cmd, "vqbench") == 0) {
+        cmd_vqbench(args);
+    } else if (strcmp(cmd, "workstat") == 0) {
+        cmd_workstat();
+    } else if (strcmp(cmd, "irqstat") == 0) {
+        cmd_irqstat(args);
+    } else if (strcmp(cmd, "trace") == 0) {
+        cmd_trace(args);
+    } else if (strcmp(cmd, "prof") == 0) {
+        cmd_prof(args);
+    } else if (strcmp(cmd, "perfstat") == 0) {
+        cmd_perfstat(args);
+    } else if (strcmp(cmd, "boottime") == 0) {
+        cmd_boottime();
+    } else if (strcmp(cmd, "input") == 0) {
+        cmd_input(args);
+    } else if (strcmp(cmd, "frames") == 0) {
+        cmd_frames(args);
+    } else if (strcmp(cmd, "iostat") == 0) {
+        cmd_iostat(args);
     } else if (strcmp(cmd, "edit") == 0) {
         cmd_edit(args);
     } else if (strcmp(cmd, "wintest") == 0) {
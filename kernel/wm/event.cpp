@@ -0,0 +1,101 @@
+/*
+  event.cpp - per-window event queues and keyboard focus
+  win_post appends to a window's ring, folding a move into a queued move;
+  windows that never set wants_events get nothing, and when a ring is full
+  the event is dropped and counted
+  set_focus posts focusout/focusin pairs to the old and new windows.
+  win_create focuses a window before its app can turn events on, so
+  win_listen replays the focusin a window already holding focus missed
+*/
+#include "kernel/wm/event.hpp"
+#include "kernel/wm/wm.hpp"
+#include "arch/aarch64/regs.hpp"
+#include <stdint.h>
+
+namespace {
+
+static wm::Window* g_focus   = nullptr;
+static uint32_t    g_dropped = 0;
+
+}
+
+namespace wm {
+
+bool win_post(Window* win, const Event& ev) {
+    if (!win || !win->visible || !win->wants_events) return false;
+
+    EventQueue& q = win->events;
+    if (ev.type == EvType::PointerMove && q.head != q.tail) {
+        Event& last = q.ev[(q.head - 1u) & (WIN_EVQ_SIZE - 1u)];
+        if (last.type == EvType::PointerMove) {
+            last = ev;
+            return true;
+        }
+    }
+    if (q.head - q.tail == WIN_EVQ_SIZE) {
+        ++g_dropped;
+        return false;
+    }
+    q.ev[q.head & (WIN_EVQ_SIZE - 1u)] = ev;
+    ++q.head;
+    return true;
+}
+
+void win_listen(Window* win) {
+    if (!win || win->wants_events) return;
+    win->wants_events = true;
+    if (win == g_focus) {
+        Event ev{};
+        ev.ts   = read_cntpct_el0();
+        ev.type = EvType::FocusIn;
+        win_post(win, ev);
+    }
+}
+
+bool win_next_event(Window* win, Event& ev) {
+    if (!win) return false;
+    EventQueue& q = win->events;
+    if (q.head == q.tail) return false;
+    ev = q.ev[q.tail & (WIN_EVQ_SIZE - 1u)];
+    ++q.tail;
+    return true;
+}
+
+bool win_has_events(const Window* win) {
+    return win && win->events.head != win->events.tail;
+}
+
+void set_focus(Window* win) {
+    if (win && !win->visible) win = nullptr;
+    if (win == g_focus) return;
+
+    Event ev{};
+    ev.ts = read_cntpct_el0();
+
+    if (g_focus) {
+        ev.type = EvType::FocusOut;
+        win_post(g_focus, ev);
+    }
+    g_focus = win;
+    if (g_focus) {
+        ev.type = EvType::FocusIn;
+        win_post(g_focus, ev);
+    }
+}
+
+Window* focused() { return g_focus; }
+
+bool key_event(char c, uint64_t ts) {
+    if (!g_focus || !g_focus->wants_events) return false;
+
+    Event ev{};
+    ev.ts   = ts ? ts : read_cntpct_el0();
+    ev.type = EvType::Key;
+    ev.key  = c;
+    win_post(g_focus, ev);
+    return true;
+}
+
+uint32_t events_dropped() { return g_dropped; }
+
+}
@@ -0,0 +1,61 @@
+/*
+  event.hpp - window manager input events
+  typed pointer/key/focus/close events stamped with cntpct ticks, queued per
+  window in a small ring for windows that set wants_events. pointer events
+  go to the window under the cursor (or the one holding a button grab),
+  keys go to the focused window
+  consecutive pointer moves overwrite each other so a slow app sees only
+  the latest position
+*/
+#pragma once
+#include <stdint.h>
+
+namespace wm {
+
+struct Window;
+
+enum class EvType : uint8_t {
+    PointerMove,
+    PointerDown,
+    PointerUp,
+    Key,
+    FocusIn,
+    FocusOut,
+    Close,
+};
+
+static constexpr uint8_t BTN_LEFT  = 1u;
+static constexpr uint8_t BTN_RIGHT = 2u;
+
+struct Event {
+    uint64_t ts;
+    EvType   type;
+    uint8_t  button;
+    char     key;
+    int32_t  x, y;
+};
+
+static constexpr uint32_t WIN_EVQ_SIZE = 32u;
+
+struct EventQueue {
+    Event    ev[WIN_EVQ_SIZE];
+    uint32_t head;
+    uint32_t tail;
+};
+
+bool win_post(Window* win, const Event& ev);
+
+void win_listen(Window* win);
+
+bool win_next_event(Window* win, Event& ev);
+
+bool win_has_events(const Window* win);
+
+void    set_focus(Window* win);
+Window* focused();
+
+bool key_event(char c, uint64_t ts);
+
+uint32_t events_dropped();
+
+}
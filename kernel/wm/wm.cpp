@@ -4,7 +4,12 @@
   has a taskbar, start menu (with scrollable/searchable all-programs panel),
   and a desktop icon layer underneath everything
   rendering is double-dirty: full render when windows change, cursor-only fast
-  path when only the mouse moved
+  path when only the mouse moved. a full render composites horizontal screen
+  bands in parallel on the job pool, each band clipped to its own rows
+  mouse_update also posts pointer/close events to window queues (event.cpp);
+  a window that takes a button press holds the pointer grab until release
+  each path charges its composite and cursor time and the pixels it drew to
+  framestat; set_overlay() adds a frame-cost box in the top-right corner
 */
 #include "kernel/wm/wm.hpp"
 #include "kernel/gfx/draw.hpp"
@@ -13,6 +18,12 @@
 #include "kernel/drivers/virtio/gpu.hpp"
 #include "kernel/mm/heap.hpp"
 #include "kernel/core/print.hpp"
+#include "kernel/core/dispatch.hpp"
+#include "kernel/core/trace.hpp"
+#include "kernel/core/framestat.hpp"
+#include "kernel/sched/smp.hpp"
+#include "kernel/sched/pool.hpp"
+#include "arch/aarch64/regs.hpp"
 #include "kernel/gfx/assets/icon_shell.hpp"
 #include "kernel/gfx/assets/icon_calc.hpp"
 #include "kernel/gfx/assets/icon_files.hpp"
@@ -73,12 +84,21 @@ static uint32_t g_wallpaper_color = 0x00008080u;
 
 static bool g_term_visible = false;
 
+static bool g_overlay = false;
+
+static constexpr uint32_t OV_COLS  = 30u;
+static constexpr uint32_t OV_LINES = 9u;
+static constexpr uint32_t OV_BG    = 0x00101010u;
+static constexpr uint32_t OV_FG    = 0x0000FF00u;
+static constexpr uint32_t OV_HEAD  = 0x00FFFF00u;
+
 static bool    g_dbclick        = false;
 static int32_t g_dbclick_x      = 0;
 static int32_t g_dbclick_y      = 0;
 
 static bool    g_prev_btn       = false;
 static bool    g_prev_btn_right = false;
+static int     g_ptr_grab       = -1;
 static bool    g_dragging    = false;
 static int     g_drag_win    = -1;
 static int32_t g_drag_off_x  = 0;
@@ -173,9 +193,7 @@ static void scroll_up() {
     g_cur_row = g_rows - 1;
 }
 
-static void draw_title() {
-    if (!g_all_dirty && !g_title_dirty) return;
-
+static void paint_title() {
     gfx::fill_rect(0, 0, g_sw, wm::WM_TITLEBAR_H, COL_TITLEBAR_BG);
     gfx::draw_hline(0, wm::WM_TITLEBAR_H - 2, g_sw, COL_ACCENT);
     gfx::draw_hline(0, wm::WM_TITLEBAR_H - 1, g_sw, COL_ACCENT);
@@ -191,6 +209,11 @@ static void draw_title() {
         uint32_t sx = g_sw - slen * gfx::FONT_W - 8;
         gfx::draw_text(sx, ty, g_status, COL_ACCENT, COL_TITLEBAR_BG);
     }
+}
+
+static void draw_title() {
+    if (!g_all_dirty && !g_title_dirty) return;
+    paint_title();
     g_title_dirty = false;
 }
 
@@ -259,13 +282,28 @@ static void zorder_bring_front(int wi) {
     for (int i = 0; i < g_nwindows; ++i) {
         if (g_zorder[i] == (uint8_t)wi) { pos = i; break; }
     }
-    if (pos < 0 || pos == g_nwindows - 1) return;
+    if (pos < 0) return;
+    wm::set_focus(&g_windows[wi]);
+    if (pos == g_nwindows - 1) return;
 
     for (int i = pos; i < g_nwindows - 1; ++i)
         g_zorder[i] = g_zorder[i + 1];
     g_zorder[g_nwindows - 1] = (uint8_t)wi;
 }
 
+static void post_pointer(int wi, wm::EvType type, uint8_t button,
+                         int32_t px, int32_t py, uint64_t ts) {
+    if (wi < 0) return;
+    wm::Window& w = g_windows[wi];
+    wm::Event ev{};
+    ev.ts     = ts;
+    ev.type   = type;
+    ev.button = button;
+    ev.x      = px - w.x;
+    ev.y      = py - (w.y + (int32_t)wm::WIN_TITLEBAR_H);
+    wm::win_post(&w, ev);
+}
+
 static int hit_test_titlebar(int32_t px, int32_t py) {
     for (int i = g_nwindows - 1; i >= 0; --i) {
         int wi = g_zorder[i];
@@ -638,6 +676,86 @@ static void draw_taskbar() {
     }
 }
 
+static void ov_num(char* line, uint32_t col, uint32_t width, uint64_t v) {
+    char tmp[21]; uint32_t n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v && n < sizeof(tmp));
+    for (uint32_t i = 0; i < n && i < width; ++i)
+        line[col + width - 1u - i] = tmp[i];
+}
+
+static void ov_line(uint32_t x, uint32_t& y, char* line, uint32_t fg) {
+    line[OV_COLS] = '\0';
+    gfx::draw_text(x, y, line, fg, OV_BG);
+    memset(line, ' ', OV_COLS);
+    y += gfx::FONT_H;
+}
+
+static void draw_overlay() {
+    if (!g_overlay) return;
+    uint32_t w = OV_COLS * gfx::FONT_W + 8u;
+    uint32_t h = OV_LINES * gfx::FONT_H + 8u;
+    if (g_sw < w + 8u || g_sh < h + wm::WM_TITLEBAR_H + 8u) return;
+
+    framestat::Summary st;
+    framestat::summary(st);
+
+    uint32_t x = g_sw - w - 8u;
+    uint32_t y = wm::WM_TITLEBAR_H + 8u;
+    gfx::fill_rect(x, y, w, h, OV_BG);
+    x += 4u;
+    y += 4u;
+
+    char line[OV_COLS + 1];
+    memset(line, ' ', OV_COLS);
+    memcpy(line, "us          p50   p95   p99", 27);
+    ov_line(x, y, line, OV_HEAD);
+    for (uint32_t p = 0; p < framestat::PHASES; ++p) {
+        const char* n = framestat::name((framestat::Phase)p);
+        for (uint32_t i = 0; n[i] && i < 10u; ++i) line[i] = n[i];
+        ov_num(line, 10u, 6u, st.p50_us[p]);
+        ov_num(line, 16u, 6u, st.p95_us[p]);
+        ov_num(line, 22u, 6u, st.p99_us[p]);
+        ov_line(x, y, line, p == framestat::TOTAL ? OV_HEAD : OV_FG);
+    }
+    memcpy(line, "px/frame", 8);
+    ov_num(line, 10u, 18u, st.pixels);
+    ov_line(x, y, line, OV_FG);
+    memcpy(line, "KB/frame", 8);
+    ov_num(line, 10u, 18u, st.bytes / 1024u);
+    ov_line(x, y, line, OV_FG);
+}
+
+static constexpr uint32_t MAX_RENDER_BANDS = 16;
+
+static bool     g_band_title = false;
+static uint32_t g_band_count = 1;
+
+static void render_band(void*, uint32_t band) {
+    uint32_t y0 = g_sh * band / g_band_count;
+    uint32_t y1 = g_sh * (band + 1u) / g_band_count;
+    if (y0 == y1) return;
+    gfx::set_clip_rows(y0, y1);
+
+    gfx::fill_rect(g_term_x, g_term_y, g_sw, g_sh - wm::WM_TITLEBAR_H - wm::TASKBAR_H, g_wallpaper_color);
+    if (g_band_title) paint_title();
+
+    desktop::render();
+
+    if (g_term_visible) {
+        for (uint32_t r = 0; r < g_rows; ++r) {
+            uint32_t py = g_term_y + r * gfx::FONT_H;
+            if (py + gfx::FONT_H <= y0 || py >= y1) continue;
+            for (uint32_t c = 0; c < g_cols; ++c)
+                draw_cell(r, c, r == g_cur_row && c == g_cur_col);
+        }
+    }
+
+    composite_all_windows();
+    draw_taskbar();
+
+    gfx::set_clip_rows(0, 0);
+}
+
 }
 
 namespace wm {
@@ -666,7 +784,9 @@ void set_status(const char* s) {
 
 void term_putc(char c) {
 
+    if (!g_rows) return;
     g_dirty[g_cur_row][g_cur_col] = true;
+    dispatch::notify(dispatch::SIG_TERM);
 
     if (c == '\n') {
         g_cur_col = 0;
@@ -708,51 +828,71 @@ void term_clear() {
     memset(g_dirty, 1,   sizeof(g_dirty));
     g_cur_col = g_cur_row = 0;
     g_all_dirty = true;
+    dispatch::notify(dispatch::SIG_TERM);
 }
 
 void render() {
     if (!vgpu::ready()) return;
 
-    gfx::fill_rect(g_term_x, g_term_y, g_sw, g_sh - wm::WM_TITLEBAR_H - wm::TASKBAR_H, g_wallpaper_color);
-    draw_title();
+    uint32_t bands = smp::online() > 1 ? smp::online() * 2u : 1u;
+    if (bands > MAX_RENDER_BANDS) bands = MAX_RENDER_BANDS;
+    TRACE_SCOPE(trace::WM_RENDER, bands);
 
-    desktop::render();
+    {
+        framestat::Scope fs(framestat::COMPOSITE);
+        g_band_title = g_all_dirty || g_title_dirty;
+        g_band_count = bands;
+        pool::parallel_for(bands, render_band, nullptr);
+        draw_overlay();
+    }
 
+    uint64_t px = (uint64_t)g_sw * g_sh;
+    for (int i = 0; i < g_nwindows; ++i) {
+        const wm::Window& w = g_windows[g_zorder[i]];
+        if (w.visible) px += (uint64_t)w.w * w.h;
+    }
+    framestat::add_pixels(px);
+
+    g_title_dirty = false;
     if (g_term_visible) {
-        for (uint32_t r = 0; r < g_rows; ++r) {
-            for (uint32_t c = 0; c < g_cols; ++c) {
-                bool cur = (r == g_cur_row && c == g_cur_col);
-                draw_cell(r, c, cur);
+        for (uint32_t r = 0; r < g_rows; ++r)
+            for (uint32_t c = 0; c < g_cols; ++c)
                 g_dirty[r][c] = false;
-            }
-        }
     }
     g_all_dirty    = false;
     g_desktop_dirty = false;
 
-    composite_all_windows();
     for (int i = 0; i < g_nwindows; ++i)
         g_windows[i].dirty = false;
 
-    draw_taskbar();
-
-    cursor::save_bg();
-    cursor::draw();
+    {
+        framestat::Scope fs(framestat::CURSOR);
+        cursor::save_bg();
+        cursor::draw();
+    }
 
     vgpu::flush_full();
 }
 
 void render_dirty() {
     if (!vgpu::ready()) return;
+    TRACE_SCOPE(trace::WM_RENDER_DIRTY);
 
     if (g_cursor_dirty && !g_desktop_dirty && g_nwindows == 0) {
         g_cursor_dirty = false;
-        cursor::restore_bg();
-        cursor::save_bg();
-        cursor::draw();
         int32_t  rx; int32_t  ry; uint32_t rw; uint32_t rh;
-        if (cursor::dirty_rect(rx, ry, rw, rh))
+        bool moved;
+        {
+            framestat::Scope fs(framestat::CURSOR);
+            cursor::restore_bg();
+            cursor::save_bg();
+            cursor::draw();
+            moved = cursor::dirty_rect(rx, ry, rw, rh);
+        }
+        if (moved) {
+            framestat::add_pixels((uint64_t)rw * rh);
             vgpu::flush_rect((uint32_t)rx, (uint32_t)ry, rw, rh);
+        }
         return;
     }
     g_cursor_dirty = false;
@@ -762,34 +902,56 @@ void render_dirty() {
         return;
     }
 
-    if (g_title_dirty || g_all_dirty) {
-        draw_title();
-    }
-    if (g_term_visible) {
-        for (uint32_t r = 0; r < g_rows; ++r) {
-            for (uint32_t c = 0; c < g_cols; ++c) {
-                bool was_cur = (r == g_prev_cur_row && c == g_prev_cur_col);
-                bool is_cur  = (r == g_cur_row      && c == g_cur_col);
-                if (g_dirty[r][c] || was_cur || is_cur || g_all_dirty) {
-                    draw_cell(r, c, is_cur);
-                    g_dirty[r][c] = false;
+    uint64_t px = (uint64_t)g_sw * wm::TASKBAR_H;
+    {
+        framestat::Scope fs(framestat::COMPOSITE);
+        if (g_title_dirty || g_all_dirty) {
+            draw_title();
+            px += (uint64_t)g_sw * wm::WM_TITLEBAR_H;
+        }
+        if (g_term_visible) {
+            uint32_t cells = 0;
+            for (uint32_t r = 0; r < g_rows; ++r) {
+                for (uint32_t c = 0; c < g_cols; ++c) {
+                    bool was_cur = (r == g_prev_cur_row && c == g_prev_cur_col);
+                    bool is_cur  = (r == g_cur_row      && c == g_cur_col);
+                    if (g_dirty[r][c] || was_cur || is_cur || g_all_dirty) {
+                        draw_cell(r, c, is_cur);
+                        g_dirty[r][c] = false;
+                        ++cells;
+                    }
                 }
             }
+            g_prev_cur_col = g_cur_col;
+            g_prev_cur_row = g_cur_row;
+            px += (uint64_t)cells * gfx::FONT_W * gfx::FONT_H;
         }
-        g_prev_cur_col = g_cur_col;
-        g_prev_cur_row = g_cur_row;
-    }
-    g_all_dirty    = false;
+        g_all_dirty    = false;
 
-    draw_taskbar();
+        draw_taskbar();
+        draw_overlay();
+    }
+    framestat::add_pixels(px);
 
-    cursor::restore_bg();
-    cursor::save_bg();
-    cursor::draw();
+    {
+        framestat::Scope fs(framestat::CURSOR);
+        cursor::restore_bg();
+        cursor::save_bg();
+        cursor::draw();
+    }
 
     vgpu::flush_full();
 }
 
+void set_overlay(bool on) {
+    if (g_overlay == on) return;
+    g_overlay       = on;
+    g_desktop_dirty = true;
+    dispatch::redraw();
+}
+
+bool overlay() { return g_overlay; }
+
 uint32_t term_cols() { return g_cols; }
 uint32_t term_rows() { return g_rows; }
 
@@ -812,6 +974,7 @@ Window* win_create(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* tit
     win.fb_client_h  = win.client_h;
     win.dirty    = true;
     win.visible  = true;
+    win.redraws  = 0;
 
     uint32_t ti = 0;
     while (title[ti] && ti < 31) { win.title[ti] = title[ti]; ++ti; }
@@ -827,8 +990,12 @@ Window* win_create(int32_t x, int32_t y, uint32_t w, uint32_t h, const char* tit
         }
     }
 
+    win.wants_events = false;
+    win.events     = EventQueue{};
+
     g_zorder[g_nwindows] = (uint8_t)slot;
     ++g_nwindows;
+    set_focus(&win);
 
     g_desktop_dirty = true;
     printk("wm: created window '%s' at (%d,%d) %ux%u\n",
@@ -842,6 +1009,8 @@ void win_destroy(Window* win) {
     if (slot < 0 || slot >= (int)MAX_WINDOWS) return;
 
     if (win->client_fb) kheap::free(win->client_fb);
+    if (focused() == win) set_focus(nullptr);
+    if (g_ptr_grab == slot) g_ptr_grab = -1;
 
     int pos = -1;
     for (int i = 0; i < g_nwindows; ++i) {
@@ -854,21 +1023,37 @@ void win_destroy(Window* win) {
     }
 
     *win = Window{};
+    if (!focused() && g_nwindows > 0)
+        set_focus(&g_windows[g_zorder[g_nwindows - 1]]);
     g_desktop_dirty = true;
 }
 
 void win_mark_dirty(Window* win) {
-    if (win) win->dirty = true;
+    if (!win) return;
+    win->dirty = true;
+    ++win->redraws;
+    dispatch::redraw();
+}
+
+bool win_has_input(const Window* win) {
+    if (!win || !win->visible) return false;
+    return win->close_requested || win->client_clicked ||
+           win->right_clicked   || win->client_held    ||
+           win_has_events(win);
 }
 
-void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right) {
+void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right,
+                  uint64_t ts) {
 
     if (abs_x < 0)               abs_x = 0;
     if (abs_y < 0)               abs_y = 0;
     if ((uint32_t)abs_x >= g_sw) abs_x = (int32_t)(g_sw - 1);
     if ((uint32_t)abs_y >= g_sh) abs_y = (int32_t)(g_sh - 1);
 
-    if (abs_x != cursor::pos_x() || abs_y != cursor::pos_y())
+    if (!ts) ts = read_cntpct_el0();
+
+    bool moved = (abs_x != cursor::pos_x() || abs_y != cursor::pos_y());
+    if (moved)
         g_cursor_dirty = true;
 
     cursor::set_pos(abs_x, abs_y);
@@ -877,9 +1062,19 @@ void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right) {
     bool released = (!btn_left && g_prev_btn);
     g_prev_btn = btn_left;
 
+    bool right_pressed  = (btn_right && !g_prev_btn_right);
     bool right_released = (!btn_right && g_prev_btn_right);
     g_prev_btn_right = btn_right;
 
+    if (moved) {
+        int mwi = (g_ptr_grab >= 0) ? g_ptr_grab : hit_test_client(abs_x, abs_y);
+        uint8_t mask = (uint8_t)((btn_left ? BTN_LEFT : 0u) | (btn_right ? BTN_RIGHT : 0u));
+        post_pointer(mwi, EvType::PointerMove, mask, abs_x, abs_y, ts);
+    }
+    if (right_pressed)
+        post_pointer(hit_test_client(abs_x, abs_y), EvType::PointerDown,
+                     BTN_RIGHT, abs_x, abs_y, ts);
+
     for (int i = 0; i < g_nwindows; ++i)
         g_windows[i].client_held = false;
     if (btn_left && !g_dragging) {
@@ -895,6 +1090,7 @@ void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right) {
 
     if (right_released) {
         int client_wi = hit_test_client(abs_x, abs_y);
+        post_pointer(client_wi, EvType::PointerUp, BTN_RIGHT, abs_x, abs_y, ts);
         if (client_wi >= 0) {
             Window& w = g_windows[client_wi];
             w.right_clicked = true;
@@ -920,11 +1116,24 @@ void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right) {
                     g_drag_off_y = abs_y - g_windows[wi].y;
                     g_dragging   = true;
                 }
+            } else if (!g_start_open) {
+                int cwi = hit_test_client(abs_x, abs_y);
+                if (cwi >= 0) {
+                    zorder_bring_front(cwi);
+                    g_desktop_dirty = true;
+                    g_ptr_grab = cwi;
+                    post_pointer(cwi, EvType::PointerDown, BTN_LEFT, abs_x, abs_y, ts);
+                }
             }
         }
     }
 
     if (released) {
+        if (g_ptr_grab >= 0) {
+            post_pointer(g_ptr_grab, EvType::PointerUp, BTN_LEFT, abs_x, abs_y, ts);
+            g_ptr_grab = -1;
+        }
+
         bool was_dragging = g_dragging;
         g_dragging = false;
         g_drag_win = -1;
@@ -1059,6 +1268,10 @@ void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right) {
             } else if (close_wi >= 0) {
 
                 g_windows[close_wi].close_requested = true;
+                Event cev{};
+                cev.ts   = ts;
+                cev.type = EvType::Close;
+                win_post(&g_windows[close_wi], cev);
                 g_desktop_dirty = true;
             } else {
                 int client_wi = hit_test_client(abs_x, abs_y);
@@ -2,9 +2,12 @@
   wm.hpp - window manager public interface
   win_create/win_destroy, mouse_update, render, render_dirty
   also exposes the terminal text layer, start menu, wallpaper color, and desktop click events
+  the per-window event queue and focus routing live in event.hpp
+  set_overlay() toggles the framestat overlay in the top-right corner
 */
 #pragma once
 #include <stdint.h>
+#include "kernel/wm/event.hpp"
 
 namespace wm {
 
@@ -39,6 +42,11 @@ struct Window {
     uint32_t restore_w, restore_h;
     uint32_t fb_w;
     uint32_t fb_client_h;
+
+    bool       wants_events;
+    EventQueue events;
+
+    uint32_t redraws;
 };
 
 void init(uint32_t screen_w, uint32_t screen_h);
@@ -50,7 +58,10 @@ void win_destroy(Window* win);
 
 void win_mark_dirty(Window* win);
 
-void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right = false);
+bool win_has_input(const Window* win);
+
+void mouse_update(int32_t abs_x, int32_t abs_y, bool btn_left, bool btn_right = false,
+                  uint64_t ts = 0);
 
 void set_status(const char* s);
 
@@ -61,6 +72,9 @@ void term_clear();
 void render();
 void render_dirty();
 
+void set_overlay(bool on);
+bool overlay();
+
 uint32_t term_cols();
 uint32_t term_rows();
 void     term_set_cursor(uint32_t col, uint32_t row);
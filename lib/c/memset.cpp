@@ -1,9 +1,22 @@
 /*
   memset.cpp - memset implementation
+  large zero fills use dc zva once the data cache is on; before that every
+  access is device memory, where dc zva would fault
 */
 #include <string.h>
 #include <stdint.h>
 
+static constexpr size_t ZVA_MIN = 256;
+
+static size_t zva_block() {
+    uint64_t sctlr, dczid;
+    asm volatile("mrs %0, sctlr_el1" : "=r"(sctlr));
+    if (!(sctlr & (1u << 2))) return 0;
+    asm volatile("mrs %0, dczid_el0" : "=r"(dczid));
+    if (dczid & (1u << 4)) return 0;
+    return 4u << (dczid & 0xF);
+}
+
 void* memset(void* s, int c, size_t n) {
     unsigned char* p = static_cast<unsigned char*>(s);
     unsigned char  v = static_cast<unsigned char>(c);
@@ -13,6 +26,20 @@ void* memset(void* s, int c, size_t n) {
         --n;
     }
 
+    if (v == 0 && n >= ZVA_MIN) {
+        size_t bs = zva_block();
+        if (bs && n >= 2 * bs) {
+            uint64_t* q = reinterpret_cast<uint64_t*>(p);
+            while (reinterpret_cast<uintptr_t>(q) & (bs - 1)) { *q++ = 0; n -= 8; }
+            p = reinterpret_cast<unsigned char*>(q);
+            while (n >= bs) {
+                asm volatile("dc zva, %0" :: "r"(p) : "memory");
+                p += bs;
+                n -= bs;
+            }
+        }
+    }
+
     if (n >= 8) {
         uint64_t w = v;
         w |= w << 8;
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""
+ksyms.py – Embed a sorted function symbol table into the linked kernel.
+
+Usage:
+    python3 tools/ksyms.py <llvm-nm> build/kernel.elf
+
+The linker script reserves a fixed-size .ksyms section, so filling it in
+afterwards moves no addresses and needs no second link. The file is patched
+in place. Layout (little-endian), read by kernel/core/ksyms.cpp:
+
+    u32 magic 'KSYM'   u32 count   u64 text_base   u32 text_size   u32 names_off
+    u32 addr_off[count]    offsets from text_base, ascending
+    u32 name_off[count]    offsets from the start of the section
+    names                  nul-terminated
+"""
+
+import struct
+import subprocess
+import sys
+
+MAGIC = 0x4D59534B
+
+
+def sections(elf):
+    if elf[:4] != b"\x7fELF" or elf[4] != 2 or elf[5] != 1:
+        sys.exit("ksyms: not a little-endian ELF64 file")
+    shoff, = struct.unpack_from("<Q", elf, 0x28)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+
+    hdrs = []
+    for i in range(shnum):
+        name, _, _, addr, off, size = struct.unpack_from("<IIQQQQ", elf, shoff + i * shentsize)
+        hdrs.append((name, addr, off, size))
+
+    strtab_off = hdrs[shstrndx][2]
+    out = {}
+    for name, addr, off, size in hdrs:
+        end = elf.index(b"\0", strtab_off + name)
+        out[elf[strtab_off + name:end].decode()] = (addr, off, size)
+    return out
+
+
+def short_name(name):
+    name = name.replace("(anonymous namespace)::", "")
+    if "operator" not in name:
+        paren = name.find("(")
+        if paren > 0:
+            name = name[:paren]
+    return name
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    nm, path = sys.argv[1], sys.argv[2]
+
+    with open(path, "rb") as f:
+        elf = bytearray(f.read())
+    secs = sections(elf)
+    if ".ksyms" not in secs:
+        sys.exit("ksyms: no .ksyms section, check linker.ld")
+    text_addr, _, text_size = secs[".text"]
+    _, ks_off, ks_size = secs[".ksyms"]
+
+    listing = subprocess.run([nm, "-n", "-C", "--defined-only", path],
+                             capture_output=True, text=True, check=True).stdout
+    syms = []
+    for line in listing.splitlines():
+        parts = line.split(" ", 2)
+        if len(parts) != 3 or parts[1] not in "tTwW":
+            continue
+        addr = int(parts[0], 16)
+        if not text_addr <= addr < text_addr + text_size:
+            continue
+        if syms and syms[-1][0] == addr:
+            continue
+        syms.append((addr, short_name(parts[2])))
+
+    count = len(syms)
+    names_off = 24 + 8 * count
+    names = bytearray()
+    name_offs = []
+    for _, name in syms:
+        name_offs.append(names_off + len(names))
+        names += name.encode("ascii", "replace") + b"\0"
+
+    blob = struct.pack("<IIQII", MAGIC, count, text_addr, text_size, names_off)
+    blob += struct.pack("<%dI" % count, *(a - text_addr for a, _ in syms))
+    blob += struct.pack("<%dI" % count, *name_offs)
+    blob += names
+    if len(blob) > ks_size:
+        sys.exit("ksyms: table needs %d bytes but .ksyms is %d, grow it in linker.ld"
+                 % (len(blob), ks_size))
+
+    elf[ks_off:ks_off + ks_size] = blob + bytes(ks_size - len(blob))
+    with open(path, "wb") as f:
+        f.write(elf)
+    print("ksyms: %d functions, %d of %d bytes" % (count, len(blob), ks_size))
+
+
+if __name__ == "__main__":
+    main()